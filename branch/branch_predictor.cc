@@ -1,9 +1,11 @@
 #include "ooo_cpu.h"
+#include "checkpoint.h"
 
 #define BIMODAL_TABLE_SIZE 16384
 #define BIMODAL_PRIME 16381
 #define MAX_COUNTER 3
 int bimodal_table[NUM_CPUS][BIMODAL_TABLE_SIZE];
+CHECKPOINT_GLOBAL(bimodal_table);
 
 void O3_CPU::initialize_branch_predictor()
 {
@@ -128,6 +128,8 @@ elif [ "${COMPRESSION_ALGO}" = "fpc" ]; then
     COMPILE_OPTIONS="${COMPILE_OPTIONS} -DCOMPRESSION_FPC"
 elif [ "${COMPRESSION_ALGO}" = "cpack" ]; then
     COMPILE_OPTIONS="${COMPILE_OPTIONS} -DCOMPRESSION_CPACK"
+elif [ "${COMPRESSION_ALGO}" = "hybrid" ]; then
+    COMPILE_OPTIONS="${COMPILE_OPTIONS} -DCOMPRESSION_HYBRID"
 elif [ "${COMPRESSION_ALGO}" = "none" ]; then
     COMPILE_OPTIONS="${COMPILE_OPTIONS} -DCOMPRESSION_NONE"
 else
@@ -5,6 +5,16 @@
 #include "instruction.h"
 #include "set.h"
 
+// compressed sizes are memoized next to the line data they describe, and copied with it
+#define COMPRESSED_SIZE_UNKNOWN UINT32_MAX
+
+// the compressor that produced a compressed size, hybrid builds keep the smallest of each line
+#define COMPRESSOR_NONE  0
+#define COMPRESSOR_BDI   1
+#define COMPRESSOR_CPACK 2
+#define COMPRESSOR_FPC   3
+#define NUM_COMPRESSORS  4
+
 // CACHE BLOCK
 class BLOCK {
   public:
@@ -25,7 +35,9 @@ class BLOCK {
              cpu,
              instr_id;
 
-    char program_data[CACHE_LINE_BYTES];
+    // the line data is in CACHE::block_data
+    uint32_t compressed_size; // of the line data, COMPRESSED_SIZE_UNKNOWN until it is compressed
+    uint8_t compressor;
 
     // replacement state
     uint32_t lru;
@@ -47,6 +59,8 @@ class BLOCK {
         data = 0;
         cpu = 0;
         instr_id = 0;
+        compressed_size = COMPRESSED_SIZE_UNKNOWN;
+        compressor = COMPRESSOR_NONE;
 
         lru = 0;
     };
@@ -76,6 +90,7 @@ class COMPRESSED_CACHE_BLOCK {
 
     uint32_t blkId[4];
     uint32_t compressed_size[4];
+    uint8_t compressor[4];
     uint64_t compressionFactor;
     uint64_t sbTag;
 
@@ -105,6 +120,7 @@ class COMPRESSED_CACHE_BLOCK {
 
             blkId[i] = 4;
             compressed_size[i] = 0;
+            compressor[i] = COMPRESSOR_NONE;
         }
 
         delta = 0;
@@ -150,22 +166,16 @@ class PACKET {
         confidence;
 
     uint8_t  is_producer, 
-             //rob_index_depend_on_me[ROB_SIZE], 
-             //lq_index_depend_on_me[ROB_SIZE], 
-             //sq_index_depend_on_me[ROB_SIZE], 
              instr_merged,
              load_merged, 
              store_merged,
              returned,
              asid[2],
-             type;
+             type,
+             compressor; // that produced compressed_size
 
-    fastset
-             rob_index_depend_on_me, 
-             lq_index_depend_on_me, 
-             sq_index_depend_on_me;
-
-    uint32_t cpu, data_index, lq_index, sq_index;
+    uint32_t cpu, data_index, lq_index, sq_index,
+             compressed_size; // of program_data, see CACHE::get_compressed_size(PACKET*)
 
     uint64_t address, // The cache line address (i.e., full_addr shifted right lg2(CACHE_LINE_SIZE) bytes.)
              full_addr,  // The full address of the access.
@@ -221,6 +231,8 @@ class PACKET {
         data_index = 0;
         lq_index = 0;
         sq_index = 0;
+        compressed_size = COMPRESSED_SIZE_UNKNOWN;
+        compressor = COMPRESSOR_NONE;
 
         address = 0;
         full_addr = 0;
@@ -232,9 +244,23 @@ class PACKET {
         latency = 0;
         last_update_cycle = 0;
         effective_latency = 0;
+
+        // packets that carry no line (instruction fetches, translations) must not feed stack garbage to the compressor
+        memset(program_data, 0, CACHE_LINE_BYTES);
     };
 };
 
+// the ROB, LQ and SQ entries merged into a request
+// they are kept by queue slot next to the packets (PACKET_QUEUE::deps) rather than inside
+// them, so moving a packet between queues and levels does not copy three sets every time
+class PACKET_DEPS {
+  public:
+    fastset
+             rob_index_depend_on_me, 
+             lq_index_depend_on_me, 
+             sq_index_depend_on_me;
+};
+
 // packet queue
 class PACKET_QUEUE {
   public:
@@ -267,12 +293,21 @@ class PACKET_QUEUE {
              FULL;
 
     PACKET *entry, processed_packet[2*MAX_READ_PER_CYCLE];
+    PACKET_DEPS *deps; // one per entry, NULL for the DRAM queues
+
+    // the L1D write queue matches whole addresses, the other queues cache lines
+    uint8_t match_full_addr;
+
+    // entries by address: (number of entries with the address << 32) | entry, where the
+    // entry is only known while the address is in a single one
+    FLAT_MAP address_index;
 
     // constructor
-    PACKET_QUEUE(string v1, uint32_t v2) : NAME(v1), SIZE(v2) {
+    PACKET_QUEUE(string v1, uint32_t v2) : NAME(v1), SIZE(v2), address_index(4*v2) {
         is_RQ = 0;
         is_WQ = 0;
         write_mode = 0;
+        match_full_addr = (NAME == "L1D_WQ");
 
         cpu = 0; 
         head = 0;
@@ -297,11 +332,13 @@ class PACKET_QUEUE {
         FULL = 0;
 
         entry = new PACKET[SIZE]; 
+        deps = new PACKET_DEPS[SIZE];
     };
 
     PACKET_QUEUE() {
         is_RQ = 0;
         is_WQ = 0;
+        match_full_addr = 0;
 
         cpu = 0; 
         head = 0;
@@ -325,17 +362,24 @@ class PACKET_QUEUE {
         FULL = 0;
 
         //entry = new PACKET[SIZE]; 
+        deps = NULL;
     };
 
     // destructor
     ~PACKET_QUEUE() {
         delete[] entry;
+        delete[] deps;
     };
 
     // functions
-    int check_queue(PACKET* packet);
-    void add_queue(PACKET* packet),
-         remove_queue(PACKET* packet);
+    int check_queue(PACKET* packet),
+        find_entry(PACKET* packet);
+    void add_queue(PACKET* packet, PACKET_DEPS* packet_deps),
+         remove_queue(PACKET* packet),
+         index_entry(uint32_t index),
+         unindex_entry(uint32_t index);
+
+    uint64_t index_key(PACKET* packet) { return match_full_addr ? packet->full_addr : packet->address; };
 };
 
 // reorder buffer
@@ -3,6 +3,10 @@
 
 #include "memory_class.h"
 
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
 // PAGE
 extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 
@@ -90,16 +94,75 @@ extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 // COMPRESSION
 #define MAX_COMPRESSIBILITY 4
 
+// TAG MATCH
+// marks an invalid way in CACHE::block_tag and CACHE::cc_sb_tag, tags are line or superblock
+// addresses and never reach it
+#define INVALID_TAG UINT64_MAX
+#define MAX_TAG_MATCH_WAY 64
+
+// bit i is set when tags[i] == tag. AVX2 compares four ways at a time and SSE4.1 two, build
+// with ExternalCFlags=-mavx2 (or -msse4.1) to use them.
+inline uint64_t match_tags(const uint64_t *tags, uint32_t num_way, uint64_t tag)
+{
+    uint64_t mask = 0;
+    uint32_t way = 0;
+
+#if defined(__AVX2__)
+    __m256i key = _mm256_set1_epi64x((long long) tag);
+    for (; way+4 <= num_way; way += 4) {
+        __m256i match = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*) (tags + way)), key);
+        mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(match)) << way;
+    }
+#elif defined(__SSE4_1__)
+    __m128i key = _mm_set1_epi64x((long long) tag);
+    for (; way+2 <= num_way; way += 2) {
+        __m128i match = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*) (tags + way)), key);
+        mask |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(match)) << way;
+    }
+#endif
+    for (; way<num_way; way++)
+        mask |= (uint64_t) (tags[way] == tag) << way;
+
+    return mask;
+}
+
+constexpr uint32_t const_lg2(uint64_t n) { return (n > 1) ? 1 + const_lg2(n >> 1) : 0; }
+
+// Geometry of a cache level fixed by its *_SET and *_WAY macros. Instantiating it checks the
+// macros when the simulator is compiled, and match() has a constant way count, so the compiler
+// unrolls it. CACHE::find_way uses it for the configured levels and falls back to the runtime
+// NUM_WAY for any other geometry.
+template <uint32_t SETS, uint32_t WAYS>
+class CACHE_GEOMETRY {
+  public:
+    static_assert(SETS > 0, "a cache needs at least one set");
+    static_assert((WAYS > 0) && (WAYS <= MAX_TAG_MATCH_WAY), "unsupported number of ways");
+
+    // like lg2(), a set count that is not a power of two uses its largest power of two
+    static constexpr uint32_t LOG2_SET = const_lg2(SETS);
+    static constexpr uint32_t SET_MASK = (1U << LOG2_SET) - 1;
+
+    static uint64_t match(const uint64_t *tags, uint64_t tag) { return match_tags(tags, WAYS, tag); };
+};
+
 class CACHE : public MEMORY {
   public:
     uint32_t cpu;
     const string NAME;
-    const uint32_t NUM_SET, NUM_WAY, NUM_LINE, WQ_SIZE, RQ_SIZE, PQ_SIZE, MSHR_SIZE;
+    const uint32_t NUM_SET, NUM_WAY, NUM_LINE, WQ_SIZE, RQ_SIZE, PQ_SIZE, MSHR_SIZE,
+                   LOG2_SET, SET_MASK; // set index bits, so get_set() does not call lg2()
     uint32_t LATENCY;
     BLOCK **block;
 #ifdef COMPRESSED_CACHE
     COMPRESSED_CACHE_BLOCK **compressed_cache_block;
 #endif
+
+    // NUM_WAY entries per set, kept apart from BLOCK so that a lookup only reads the tags
+    uint64_t *block_tag; // tag of each valid way, INVALID_TAG otherwise
+    char *block_data;    // CACHE_LINE_BYTES per way
+#ifdef COMPRESSED_CACHE
+    uint64_t *cc_sb_tag; // superblock tag of each compressed way holding a line, INVALID_TAG otherwise
+#endif
     int fill_level;
     uint32_t MAX_READ, MAX_FILL;
     uint8_t cache_type;
@@ -112,6 +175,11 @@ class CACHE : public MEMORY {
              pf_useless,
              pf_fill;
 
+#ifdef COMPRESSED_CACHE
+    // lines filled into the compressed LLC by the compressor that sized them
+    uint64_t compressor_fill[NUM_COMPRESSORS];
+#endif
+
     // queues
     PACKET_QUEUE WQ{NAME + "_WQ", WQ_SIZE}, // write queue
                  RQ{NAME + "_RQ", RQ_SIZE}, // read queue
@@ -128,10 +196,16 @@ class CACHE : public MEMORY {
     
     // constructor
     CACHE(string v1, uint32_t v2, int v3, uint32_t v4, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8) 
-        : NAME(v1), NUM_SET(v2), NUM_WAY(v3), NUM_LINE(v4), WQ_SIZE(v5), RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8) {
+        : NAME(v1), NUM_SET(v2), NUM_WAY(v3), NUM_LINE(v4), WQ_SIZE(v5), RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8),
+          LOG2_SET(const_lg2(v2)), SET_MASK((1U << const_lg2(v2)) - 1) {
 
         LATENCY = 0;
 
+        if (NUM_WAY > MAX_TAG_MATCH_WAY) {
+            cerr << "[" << NAME << "_ERROR] " << NUM_WAY << " ways, at most " << MAX_TAG_MATCH_WAY << " are supported" << endl;
+            assert(0);
+        }
+
         // cache block
         block = new BLOCK* [NUM_SET];
         for (uint32_t i=0; i<NUM_SET; i++) {
@@ -142,6 +216,11 @@ class CACHE : public MEMORY {
             }
         }
 
+        block_tag = new uint64_t[(uint64_t) NUM_SET*NUM_WAY];
+        for (uint64_t i=0; i<(uint64_t) NUM_SET*NUM_WAY; i++)
+            block_tag[i] = INVALID_TAG;
+        block_data = new char[(uint64_t) NUM_SET*NUM_WAY*CACHE_LINE_BYTES]();
+
         // instrumentation / performance counters.
         for (uint32_t i=0; i<NUM_CPUS; i++) {
             upper_level_icache[i] = NULL;
@@ -171,6 +250,11 @@ class CACHE : public MEMORY {
         pf_useless = 0;
         pf_fill = 0;
 
+#ifdef COMPRESSED_CACHE
+        for (uint32_t i=0; i<NUM_COMPRESSORS; i++)
+            compressor_fill[i] = 0;
+#endif
+
         is_compressed = false;
     }
 
@@ -182,11 +266,14 @@ class CACHE : public MEMORY {
             for (uint32_t i=0; i<NUM_SET; i++)
                 delete[] compressed_cache_block[i];
             delete[] compressed_cache_block;
+            delete[] cc_sb_tag;
         }
 #endif
         for (uint32_t i=0; i<NUM_SET; i++)
             delete[] block[i];
         delete[] block;
+        delete[] block_tag;
+        delete[] block_data;
     };
 
     // functions
@@ -195,6 +282,7 @@ class CACHE : public MEMORY {
          add_pq(PACKET *packet);
 
     void return_data(PACKET *packet),
+         functional_access(PACKET *packet),
          operate(),
          increment_WQ_FULL(uint64_t address);
 
@@ -211,9 +299,10 @@ class CACHE : public MEMORY {
     void handle_fill(),
          handle_writeback(),
          handle_read(),
-         handle_prefetch();
+         handle_prefetch(),
+         functional_fill(PACKET *packet, uint8_t dirty);
 
-    void add_mshr(PACKET *packet),
+    void add_mshr(PACKET *packet, PACKET_DEPS *packet_deps),
          update_fill_cycle(),
          llc_initialize_replacement(),
          update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit),
@@ -235,6 +324,28 @@ class CACHE : public MEMORY {
          l1d_prefetcher_final_stats(),
          l2c_prefetcher_final_stats();
 
+    // NUM_WAY if no valid way holds tag, find_way(set, INVALID_TAG) returns the first invalid way
+    uint32_t find_way(uint32_t set, uint64_t tag) {
+        const uint64_t *tags = &block_tag[(uint64_t) set*NUM_WAY];
+        uint64_t match;
+
+        // ITLB/DTLB, STLB, L1I/L1D/L2C and LLC
+        if (NUM_WAY == DTLB_WAY)
+            match = CACHE_GEOMETRY<DTLB_SET, DTLB_WAY>::match(tags, tag);
+        else if (NUM_WAY == STLB_WAY)
+            match = CACHE_GEOMETRY<STLB_SET, STLB_WAY>::match(tags, tag);
+        else if (NUM_WAY == L1D_WAY)
+            match = CACHE_GEOMETRY<L1D_SET, L1D_WAY>::match(tags, tag);
+        else if (NUM_WAY == LLC_WAY)
+            match = CACHE_GEOMETRY<LLC_SET, LLC_WAY>::match(tags, tag);
+        else
+            match = match_tags(tags, NUM_WAY, tag);
+
+        return match ? __builtin_ctzll(match) : NUM_WAY;
+    };
+
+    char *line_data(uint32_t set, uint32_t way) { return &block_data[((uint64_t) set*NUM_WAY + way)*CACHE_LINE_BYTES]; };
+
     uint32_t get_set(uint64_t address),
              get_way(uint64_t address, uint32_t set),
              find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
@@ -252,11 +363,19 @@ class CACHE : public MEMORY {
     uint32_t get_blkid_cc(uint64_t line_address);
     uint64_t get_sb_tag(uint64_t line_address);
 
-    uint32_t get_compressed_size(const char* data);
+    uint32_t get_compressed_size(const char* data, uint8_t &compressor);
+
+    // compresses the packet's line only the first time, lines keep their size through the hierarchy
+    uint32_t get_compressed_size(PACKET *packet) {
+        if (packet->compressed_size == COMPRESSED_SIZE_UNKNOWN)
+            packet->compressed_size = get_compressed_size(packet->program_data, packet->compressor);
+        return packet->compressed_size;
+    };
     uint64_t get_compression_factor(uint32_t compressed_size);
+    void print_compressor_stats();
 
     void fill_cache_cc(uint32_t set, uint32_t way, uint32_t cf, PACKET *packet);
-    uint8_t evict_compressed_line(uint32_t set, uint32_t way, PACKET pkt, uint32_t& evicted_cf);
+    uint8_t evict_compressed_line(uint32_t set, uint32_t way, PACKET *packet, uint32_t& evicted_cf);
 
     // Implemented by external replacement policies.
     void llc_update_replacement_state_cc(uint32_t cpu, uint32_t set, uint32_t way, uint32_t compression_index, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint32_t cf, uint32_t compressed_size, uint8_t hit, uint64_t latency, uint64_t effective_latency);
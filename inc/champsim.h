@@ -19,6 +19,8 @@
 #include <string>
 #include <iomanip>
 
+#include "page_table.h"
+
 // USEFUL MACROS
 //#define DEBUG_PRINT
 #define SANITY_CHECK
@@ -86,7 +88,9 @@ extern uint8_t warmup_complete[NUM_CPUS],
                all_simulation_complete,
                MAX_INSTR_DESTINATIONS,
                knob_cloudsuite,
-               knob_low_bandwidth;
+               knob_low_bandwidth,
+               knob_cycle_skip,
+               knob_functional_warmup;
 
 extern uint64_t current_core_cycle[NUM_CPUS], 
                 stall_cycle[NUM_CPUS], 
@@ -94,8 +98,11 @@ extern uint64_t current_core_cycle[NUM_CPUS],
                 last_drc_write_mode,
                 drc_blocks;
 
-extern queue <uint64_t> page_queue;
-extern map <uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
+extern FLAT_MAP page_table, // vpage => frame of page_clock
+                inverse_table, // ppage => vpage
+                cl_footprint[NUM_CPUS]; // bitmap of the cache lines touched in each page
+extern PAGE_CLOCK page_clock;
+extern vector <uint64_t> tlb_shootdown[NUM_CPUS], cache_shootdown[NUM_CPUS];
 extern uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
 void print_stats();
@@ -121,5 +128,6 @@ class RANDOM {
         return dist(engine);
     };
 };
-extern uint64_t champsim_seed;
+extern uint64_t champsim_seed, skip_instructions;
+extern RANDOM champsim_rand;
 #endif
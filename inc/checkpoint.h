@@ -0,0 +1,47 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "champsim.h"
+
+#include <type_traits>
+
+using namespace std;
+
+// Post-warmup checkpoints (-save_checkpoint / -load_checkpoint).
+// A checkpoint holds the state warmup builds up: the tags and data of every TLB and
+// cache (including the compressed LLC superblocks), the page table and its page
+// allocator, the open DRAM rows, and how far each core is in its trace. Branch
+// predictors, prefetchers and replacement policies keep their state in globals,
+// which they register with CHECKPOINT_GLOBAL. A run that loads a checkpoint opens
+// the traces at the first unretired instruction and starts measuring right away;
+// in-flight instructions and requests are not saved, so its pipeline starts empty.
+
+#define CHECKPOINT_MAGIC 0x36544B4348434D43ULL // "CMCHCKT6"
+
+// a plain global of a branch predictor, prefetcher or replacement policy
+class CHECKPOINT_GLOBAL_STATE {
+  public:
+    const char *name;
+    void *data;
+    size_t size;
+    CHECKPOINT_GLOBAL_STATE *next;
+
+    CHECKPOINT_GLOBAL_STATE(const char *var_name, void *var_data, size_t var_size);
+};
+
+// registers a global by name, e.g. CHECKPOINT_GLOBAL(rrpv);
+// a global the loaded checkpoint does not have keeps the value its initializer gave it
+#define CHECKPOINT_GLOBAL(var) \
+    static_assert(std::is_trivially_copyable<decltype(var)>::value, #var " cannot be checkpointed byte by byte"); \
+    static CHECKPOINT_GLOBAL_STATE checkpoint_global_##var(#var, &var, sizeof(var))
+
+// called right after finish_warmup()
+void save_checkpoint(const char *path);
+
+// the trace position of a core, read before the traces are opened
+uint64_t checkpoint_trace_position(const char *path, uint32_t cpu);
+
+// called once the caches and replacement policy are initialized, before simulation starts
+void load_checkpoint(const char *path);
+
+#endif
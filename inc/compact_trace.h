@@ -0,0 +1,87 @@
+#ifndef COMPACT_TRACE_H
+#define COMPACT_TRACE_H
+
+#include "champsim.h"
+#include "instruction.h"
+
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Compact encoding for data-augmented (DATA_TRACE) traces.
+//
+// The packed input_instr carries six 64B cache-line values for every instruction,
+// even when it has no memory operands. The compact stream instead stores
+//   - one flag byte (is_branch, branch_taken and which memory operands are populated)
+//   - the ip as a zigzag varint delta from the previous ip
+//   - the six register bytes as-is
+//   - for each populated memory operand: the address as a zigzag varint delta from the
+//     previous memory address, followed by the line value
+// Line values are either a literal, a byte-delta against the last value seen for the
+// same cache line, or a reference into a dictionary of recently seen line contents.
+// Both sides keep identical (bounded) dictionary and line tables, so the decoder
+// rebuilds the original input_instr byte for byte.
+//
+// The stream starts with COMPACT_TRACE_MAGIC, which is not a canonical x86-64 user
+// address, so the trace reader can tell compact traces from old ones by peeking the
+// first 8 bytes.
+
+#define COMPACT_TRACE_MAGIC 0x3130544443534843ULL // "CHSCDT01"
+
+#ifndef COMPACT_TRACE_LOG2_DICTIONARY
+    #define COMPACT_TRACE_LOG2_DICTIONARY 16
+#endif
+#ifndef COMPACT_TRACE_LOG2_LINES
+    #define COMPACT_TRACE_LOG2_LINES 16
+#endif
+
+#define COMPACT_TRACE_OPERANDS (NUM_INSTR_DESTINATIONS + NUM_INSTR_SOURCES)
+
+// upper bound on the size of one encoded instruction
+#define COMPACT_TRACE_MAX_RECORD (1 + 10 + COMPACT_TRACE_OPERANDS + COMPACT_TRACE_OPERANDS*(10 + 10 + CACHE_LINE_BYTES))
+
+// line value encodings, anything >= COMPACT_VALUE_DICTIONARY is a dictionary reference
+#define COMPACT_VALUE_LITERAL    0
+#define COMPACT_VALUE_DELTA      1
+#define COMPACT_VALUE_DICTIONARY 2
+
+class COMPACT_TRACE {
+  public:
+    uint64_t last_ip, last_address;
+
+    // ring of recently seen line contents
+    uint8_t (*dictionary)[CACHE_LINE_BYTES];
+    uint32_t dictionary_next;
+
+    // direct-mapped table of the last value seen for each cache line
+    uint64_t *line_tag;
+    uint8_t (*line_value)[CACHE_LINE_BYTES];
+
+    // content hash -> dictionary slot, only used while encoding
+    std::unordered_map<uint64_t, uint32_t> dictionary_index;
+
+    uint64_t num_instr, num_literal, num_delta, num_dictionary;
+
+    COMPACT_TRACE();
+    ~COMPACT_TRACE();
+
+    void reset();
+
+#ifdef DATA_TRACE
+    // appends the encoding of instr to out
+    void encode(const input_instr *instr, std::vector<uint8_t> &out);
+
+    // decodes one instruction from [in, end) and returns a pointer past it, or
+    // NULL if the buffer ends in the middle of the record
+    const uint8_t *decode(const uint8_t *in, const uint8_t *end, input_instr *instr);
+#endif
+
+  private:
+    uint32_t line_index(uint64_t line);
+    void insert_dictionary(const uint8_t *value);
+    void encode_value(uint64_t address, const uint8_t *value, std::vector<uint8_t> &out);
+    const uint8_t *decode_value(uint64_t address, const uint8_t *in, const uint8_t *end, uint8_t *value);
+};
+
+#endif
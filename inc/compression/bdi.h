@@ -3,6 +3,17 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// blocks of other sizes than BDI_LINE_SIZE take the generic path, which is limited to
+// BDI_MAX_BLOCK_SIZE bytes so that it can convert them on the stack
+#define BDI_LINE_SIZE 64
+#define BDI_MAX_BLOCK_SIZE 256
 
 namespace bdi {
 
@@ -16,9 +27,8 @@ inline unsigned my_abs(int x) {
     return (x ^ t) - t;
 }
 
-inline long long unsigned *convertBuffer2Array(char *buffer, unsigned size, unsigned step) {
-    long long unsigned *values = (long long unsigned *)malloc(sizeof(long long unsigned) * size / step);
-
+// values must hold size / step words
+inline void convertBuffer2Array(const char *buffer, unsigned size, unsigned step, long long unsigned *values) {
     //init
     unsigned int i, j;
     for (i = 0; i < size / step; i++)
@@ -27,8 +37,6 @@ inline long long unsigned *convertBuffer2Array(char *buffer, unsigned size, unsi
     for (i = 0; i < size; i += step)
         for (j = 0; j < step; j++)
             values[i / step] += (long long unsigned)((unsigned char)buffer[i + j]) << (8 * j);
-
-    return values;
 }
 
 ///
@@ -151,8 +159,179 @@ inline unsigned multBaseCompression(long long unsigned *values, unsigned size, u
     return mCompSize;
 }
 
-inline unsigned BDICompress(char *buffer, unsigned _blockSize) {
-    long long unsigned *values = convertBuffer2Array(buffer, _blockSize, 8);
+///
+/// BDI on one BDI_LINE_SIZE line, without converting it. Gives the same sizes as the generic
+/// BDICompress below: a zero line is 1 byte, a repeated 4 or 8-byte value 4 or 8 bytes, and
+/// base + delta encodings with an implicit zero base and one explicit base (the first word
+/// that is not within the delta of zero) are
+///   8-byte words with 1, 2 or 4-byte deltas: 16, 24 or 40 bytes
+///   4-byte words with 1 or 2-byte deltas:    20 or 36 bytes
+///   2-byte words with 1-byte deltas:         34 bytes
+/// Words are little endian and compared as unsigned values, so a 4 or 2-byte word is not
+/// within a delta of one whose difference only fits when wrapped around.
+///
+
+#define BDI_ZERO_SIZE    1
+#define BDI_REP4_SIZE    4
+#define BDI_REP8_SIZE    8
+#define BDI_B8D1_SIZE   16
+#define BDI_B4D1_SIZE   20
+#define BDI_B8D2_SIZE   24
+#define BDI_B2D1_SIZE   34
+#define BDI_B4D2_SIZE   36
+#define BDI_B8D4_SIZE   40
+
+#if defined(__AVX2__)
+
+// lanes of a that are within limit of b: a - b + limit <= 2*limit, unsigned and wrapping like
+// the 64-bit my_llabs() difference
+inline __m256i bdiNear64(__m256i a, __m256i b, uint64_t limit) {
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    __m256i t = _mm256_add_epi64(_mm256_sub_epi64(a, b), _mm256_set1_epi64x(limit));
+    __m256i far = _mm256_cmpgt_epi64(_mm256_xor_si256(t, sign), _mm256_set1_epi64x((long long) ((2*limit) ^ (1ULL << 63))));
+    return _mm256_xor_si256(far, _mm256_set1_epi8(-1));
+}
+
+// narrower words do not wrap, their distance is max - min
+inline __m256i bdiNear32(__m256i a, __m256i b, uint32_t limit) {
+    __m256i diff = _mm256_sub_epi32(_mm256_max_epu32(a, b), _mm256_min_epu32(a, b));
+    return _mm256_cmpeq_epi32(_mm256_min_epu32(diff, _mm256_set1_epi32(limit)), diff);
+}
+
+inline __m256i bdiNear16(__m256i a, __m256i b, uint32_t limit) {
+    __m256i diff = _mm256_sub_epi16(_mm256_max_epu16(a, b), _mm256_min_epu16(a, b));
+    return _mm256_cmpeq_epi16(_mm256_min_epu16(diff, _mm256_set1_epi16(limit)), diff);
+}
+
+// one bit per byte of the line
+inline uint64_t bdiByteMask(__m256i lo, __m256i hi) {
+    return (uint32_t) _mm256_movemask_epi8(lo) | ((uint64_t) (uint32_t) _mm256_movemask_epi8(hi) << 32);
+}
+
+// whether every word is within limit of zero or of the first word that is not
+#define BDI_TWO_BASES(NEAR, WORD, SET1)                                                     \
+    __m256i zero = _mm256_setzero_si256();                                                  \
+    uint64_t far = ~bdiByteMask(NEAR(lo, zero, limit), NEAR(hi, zero, limit));              \
+    if (far == 0)                                                                           \
+        return true;                                                                        \
+    WORD base;                                                                              \
+    memcpy(&base, line + (__builtin_ctzll(far) & ~(sizeof(WORD) - 1)), sizeof(WORD));      \
+    __m256i b = SET1(base);                                                                 \
+    return (far & ~bdiByteMask(NEAR(lo, b, limit), NEAR(hi, b, limit))) == 0;
+
+inline bool bdiTwoBases64(const char *line, __m256i lo, __m256i hi, uint64_t limit) { BDI_TWO_BASES(bdiNear64, uint64_t, _mm256_set1_epi64x) }
+inline bool bdiTwoBases32(const char *line, __m256i lo, __m256i hi, uint32_t limit) { BDI_TWO_BASES(bdiNear32, uint32_t, _mm256_set1_epi32) }
+inline bool bdiTwoBases16(const char *line, __m256i lo, __m256i hi, uint32_t limit) { BDI_TWO_BASES(bdiNear16, uint16_t, _mm256_set1_epi16) }
+
+#undef BDI_TWO_BASES
+
+inline unsigned BDICompressLine(const char *line) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *) line),
+            hi = _mm256_loadu_si256((const __m256i *) (line + 32));
+
+    if (_mm256_testz_si256(_mm256_or_si256(lo, hi), _mm256_or_si256(lo, hi)))
+        return BDI_ZERO_SIZE;
+
+    // all encodings are checked together, the smallest one that fits wins
+    __m256i first4 = _mm256_broadcastd_epi32(_mm256_castsi256_si128(lo)),
+            first8 = _mm256_broadcastq_epi64(_mm256_castsi256_si128(lo));
+    if (bdiByteMask(_mm256_cmpeq_epi32(lo, first4), _mm256_cmpeq_epi32(hi, first4)) == UINT64_MAX)
+        return BDI_REP4_SIZE;
+    if (bdiByteMask(_mm256_cmpeq_epi64(lo, first8), _mm256_cmpeq_epi64(hi, first8)) == UINT64_MAX)
+        return BDI_REP8_SIZE;
+    if (bdiTwoBases64(line, lo, hi, 0xFF))
+        return BDI_B8D1_SIZE;
+    if (bdiTwoBases32(line, lo, hi, 0xFF))
+        return BDI_B4D1_SIZE;
+    if (bdiTwoBases64(line, lo, hi, 0xFFFF))
+        return BDI_B8D2_SIZE;
+    if (bdiTwoBases16(line, lo, hi, 0xFF))
+        return BDI_B2D1_SIZE;
+    if (bdiTwoBases32(line, lo, hi, 0xFFFF))
+        return BDI_B4D2_SIZE;
+    if (bdiTwoBases64(line, lo, hi, 0xFFFFFFFF))
+        return BDI_B8D4_SIZE;
+
+    return BDI_LINE_SIZE;
+}
+
+#else
+
+// a is within limit of b: a - b + limit <= 2*limit in 64 bits, which wraps like the
+// my_llabs() difference for 8-byte words and is exact for zero-extended narrower ones
+inline bool bdiNear(uint64_t a, uint64_t b, uint64_t limit) {
+    return a - b + limit <= 2*limit;
+}
+
+template <typename WORD>
+inline bool bdiTwoBases(const char *line, uint64_t limit) {
+    WORD words[BDI_LINE_SIZE / sizeof(WORD)];
+    memcpy(words, line, BDI_LINE_SIZE);
+
+    unsigned i = 0;
+    while ((i < BDI_LINE_SIZE / sizeof(WORD)) && bdiNear(words[i], 0, limit))
+        i++;
+    if (i == BDI_LINE_SIZE / sizeof(WORD))
+        return true;
+
+    uint64_t base = words[i];
+    for (; i < BDI_LINE_SIZE / sizeof(WORD); i++)
+        if (!bdiNear(words[i], 0, limit) && !bdiNear(words[i], base, limit))
+            return false;
+    return true;
+}
+
+template <typename WORD>
+inline bool bdiRepeated(const char *line) {
+    WORD words[BDI_LINE_SIZE / sizeof(WORD)];
+    memcpy(words, line, BDI_LINE_SIZE);
+
+    WORD differ = 0;
+    for (unsigned i = 1; i < BDI_LINE_SIZE / sizeof(WORD); i++)
+        differ |= words[i] ^ words[0];
+    return differ == 0;
+}
+
+inline unsigned BDICompressLine(const char *line) {
+    uint64_t words[BDI_LINE_SIZE / 8], any = 0;
+    memcpy(words, line, BDI_LINE_SIZE);
+    for (unsigned i = 0; i < BDI_LINE_SIZE / 8; i++)
+        any |= words[i];
+
+    if (any == 0)
+        return BDI_ZERO_SIZE;
+    if (bdiRepeated<uint32_t>(line))
+        return BDI_REP4_SIZE;
+    if (bdiRepeated<uint64_t>(line))
+        return BDI_REP8_SIZE;
+    if (bdiTwoBases<uint64_t>(line, 0xFF))
+        return BDI_B8D1_SIZE;
+    if (bdiTwoBases<uint32_t>(line, 0xFF))
+        return BDI_B4D1_SIZE;
+    if (bdiTwoBases<uint64_t>(line, 0xFFFF))
+        return BDI_B8D2_SIZE;
+    if (bdiTwoBases<uint16_t>(line, 0xFF))
+        return BDI_B2D1_SIZE;
+    if (bdiTwoBases<uint32_t>(line, 0xFFFF))
+        return BDI_B4D2_SIZE;
+    if (bdiTwoBases<uint64_t>(line, 0xFFFFFFFF))
+        return BDI_B8D4_SIZE;
+
+    return BDI_LINE_SIZE;
+}
+
+#endif
+
+inline unsigned BDICompress(const char *buffer, unsigned _blockSize) {
+    if (_blockSize == BDI_LINE_SIZE)
+        return BDICompressLine(buffer);
+    if (_blockSize > BDI_MAX_BLOCK_SIZE) {
+        // std::cout << "Block too large = " << _blockSize << std::endl;
+        exit(1);
+    }
+
+    long long unsigned values[BDI_MAX_BLOCK_SIZE / 2];
+    convertBuffer2Array(buffer, _blockSize, 8, values);
     unsigned bestCSize = _blockSize;
     unsigned currCSize = _blockSize;
     if (isZeroPackable(values, _blockSize / 8))
@@ -166,8 +345,7 @@ inline unsigned BDICompress(char *buffer, unsigned _blockSize) {
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
     currCSize = multBaseCompression(values, _blockSize / 8, 4, 8);
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
-    free(values);
-    values = convertBuffer2Array(buffer, _blockSize, 4);
+    convertBuffer2Array(buffer, _blockSize, 4, values);
     if (isSameValuePackable(values, _blockSize / 4))
         currCSize = 4;
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
@@ -175,19 +353,21 @@ inline unsigned BDICompress(char *buffer, unsigned _blockSize) {
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
     currCSize = multBaseCompression(values, _blockSize / 4, 2, 4);
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
-    free(values);
-    values = convertBuffer2Array(buffer, _blockSize, 2);
+    convertBuffer2Array(buffer, _blockSize, 2, values);
     currCSize = multBaseCompression(values, _blockSize / 2, 1, 2);
     bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
-    free(values);
 
-    buffer = NULL;
-    values = NULL;
     return bestCSize;
 }
 
-inline unsigned FPCCompress(char *buffer, unsigned size) {
-    long long unsigned *values = convertBuffer2Array(buffer, size * 4, 4);
+inline unsigned FPCCompress(const char *buffer, unsigned size) {
+    if (size * 4 > BDI_MAX_BLOCK_SIZE) {
+        // std::cout << "Block too large = " << size * 4 << std::endl;
+        exit(1);
+    }
+
+    long long unsigned values[BDI_MAX_BLOCK_SIZE / 4];
+    convertBuffer2Array(buffer, size * 4, 4, values);
     unsigned compressable = 0;
     unsigned int i;
     for (i = 0; i < size; i++) {
@@ -230,14 +410,13 @@ inline unsigned FPCCompress(char *buffer, unsigned size) {
         compressable += 4;
         //SIM_printf("111\n ");
     }
-    free(values);
     //6 bytes for 3 bit per every 4-byte word in a 64 byte cache line
     unsigned compSize = compressable + size * 3 / 8;
     if (compSize < size * 4) return compSize;
     else return size * 4;
 }
 
-inline unsigned GeneralCompress(char *buffer, unsigned _blockSize, unsigned compress)
+inline unsigned GeneralCompress(const char *buffer, unsigned _blockSize, unsigned compress)
 {
     switch (compress) {
     case 0:
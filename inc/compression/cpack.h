@@ -4,14 +4,9 @@
 #include <cstdint>
 
 namespace cpack {
+    // both return the size of the compressed line in bytes, compress() also encodes it
     int compress(const uint8_t* input, uint8_t* output);
-
-    void set_bit(uint8_t*, int&, bool);
-    void set_bit(uint8_t*, int&, bool, bool);
-    void set_bit(uint8_t*, int&, bool, bool, bool, bool);
-
-    void set_byte(uint8_t*, int&, uint8_t);
-    void set_idx(uint8_t*, int&, int);
+    int compressed_size(const uint8_t* input);
 
     int decompress(const uint8_t input[68], uint8_t output[64], int in_size);
 
@@ -0,0 +1,267 @@
+#ifndef __FPC_COMPRESSION_H__
+#define __FPC_COMPRESSION_H__
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+///
+/// Frequent Pattern Compression (Alameldeen and Wood, 2004) of a 64-byte line. Each 32-bit
+/// word gets a 3-bit prefix and the data of its pattern:
+///   000  run of 1 to 8 zero words    3 bits (run length - 1)
+///   001  4-bit sign-extended         4 bits
+///   010  8-bit sign-extended         8 bits
+///   011  16-bit sign-extended        16 bits
+///   100  halfword padded with zeros  16 bits (the upper halfword)
+///   101  two sign-extended bytes     16 bits (one byte per halfword)
+///   110  one byte repeated           8 bits
+///   111  uncompressed                32 bits
+/// A word takes the shortest pattern that fits, the first one listed on ties. Codes are
+/// written from bit 0 of the output up, with their data after the prefix, so a whole line
+/// takes at most FPC_MAX_BYTES.
+///
+
+#define FPC_LINE_SIZE 64
+#define FPC_WORDS 16
+#define FPC_MAX_BYTES 70 // 16 uncompressed words
+
+#define FPC_ZERO_RUN   0
+#define FPC_SIGN4      1
+#define FPC_SIGN8      2
+#define FPC_SIGN16     3
+#define FPC_PADDED     4
+#define FPC_TWO_BYTES  5
+#define FPC_REPEATED   6
+#define FPC_UNCOMPRESSED 7
+
+#define FPC_PREFIX_BITS 3
+#define FPC_MAX_ZERO_RUN 8
+
+namespace fpc {
+
+// one bit per word for each pattern that fits it
+class FPC_MATCH {
+  public:
+    uint32_t zero, sign4, sign8, sign16, padded, two_bytes, repeated;
+};
+
+inline void match(const uint8_t *line, FPC_MATCH &m) {
+#if defined(__AVX2__)
+    __m256i half[2] = { _mm256_loadu_si256((const __m256i *) line), _mm256_loadu_si256((const __m256i *) (line + 32)) };
+    uint32_t *bits[7] = { &m.zero, &m.sign4, &m.sign8, &m.sign16, &m.padded, &m.two_bytes, &m.repeated };
+    for (int i = 0; i < 7; i++)
+        *bits[i] = 0;
+
+    // a value v fits in n signed bits when v + 2^(n-1) < 2^n as unsigned
+    const __m256i zero = _mm256_setzero_si256(),
+                  sign = _mm256_set1_epi32(INT32_MIN);
+    for (int h = 0; h < 2; h++) {
+        __m256i w = half[h];
+        __m256i fits4 = _mm256_cmpgt_epi32(_mm256_set1_epi32(INT32_MIN + 16), _mm256_xor_si256(_mm256_add_epi32(w, _mm256_set1_epi32(8)), sign)),
+                fits8 = _mm256_cmpgt_epi32(_mm256_set1_epi32(INT32_MIN + 256), _mm256_xor_si256(_mm256_add_epi32(w, _mm256_set1_epi32(128)), sign)),
+                fits16 = _mm256_cmpgt_epi32(_mm256_set1_epi32(INT32_MIN + 65536), _mm256_xor_si256(_mm256_add_epi32(w, _mm256_set1_epi32(32768)), sign)),
+                padded = _mm256_cmpeq_epi32(_mm256_slli_epi32(w, 16), zero),
+                // both halfwords are sign-extended bytes when adding 0x80 to each leaves only their low bytes
+                two_bytes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_add_epi16(w, _mm256_set1_epi16(0x80)), _mm256_set1_epi16((short) 0xFF00)), zero),
+                // the shuffle broadcasts the low byte of each word
+                repeated = _mm256_cmpeq_epi32(w, _mm256_shuffle_epi8(w, _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12,
+                                                                                         0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12))),
+                is_zero = _mm256_cmpeq_epi32(w, zero);
+
+        __m256i masks[7] = { is_zero, fits4, fits8, fits16, padded, two_bytes, repeated };
+        for (int i = 0; i < 7; i++)
+            *bits[i] |= (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(masks[i])) << (8*h);
+    }
+#else
+    uint32_t word[FPC_WORDS];
+    memcpy(word, line, FPC_LINE_SIZE);
+
+    m.zero = m.sign4 = m.sign8 = m.sign16 = m.padded = m.two_bytes = m.repeated = 0;
+    for (int i = 0; i < FPC_WORDS; i++) {
+        uint32_t w = word[i];
+        m.zero |= (w == 0) << i;
+        m.sign4 |= (w + 8 < 16) << i;
+        m.sign8 |= (w + 128 < 256) << i;
+        m.sign16 |= (w + 32768 < 65536) << i;
+        m.padded |= ((w & 0xFFFF) == 0) << i;
+        m.two_bytes |= ((((w & 0xFFFF) + 0x80) & 0xFF00) == 0 && ((((w >> 16) + 0x80) & 0xFF00) == 0)) << i;
+        m.repeated |= (w == (w & 0xFF) * 0x01010101) << i;
+    }
+#endif
+}
+
+// the pattern of each nonzero word, as one bit per word
+class FPC_CLASSES {
+  public:
+    uint32_t zero, data4, data8, data16, data32;
+
+    FPC_CLASSES(const FPC_MATCH &m) {
+        zero = m.zero;
+        data4 = m.sign4 & ~zero;
+        data8 = (m.sign8 | m.repeated) & ~(zero | data4);
+        data16 = (m.sign16 | m.padded | m.two_bytes) & ~(zero | data4 | data8);
+        data32 = ((1 << FPC_WORDS) - 1) & ~(zero | data4 | data8 | data16);
+    };
+};
+
+inline unsigned compressed_bits(const uint8_t *line) {
+    FPC_MATCH m;
+    match(line, m);
+    FPC_CLASSES c(m);
+
+    // a zero run takes one code, and a second one from its ninth word on
+    uint32_t run_starts = c.zero & ~(c.zero << 1),
+             ninth = c.zero;
+    for (int i = 1; i <= FPC_MAX_ZERO_RUN; i++)
+        ninth &= c.zero << i;
+    uint32_t zero_codes = __builtin_popcount(run_starts) + __builtin_popcount(ninth & ~(ninth << 1));
+
+    return zero_codes * (FPC_PREFIX_BITS + 3)
+         + __builtin_popcount(c.data4) * (FPC_PREFIX_BITS + 4)
+         + __builtin_popcount(c.data8) * (FPC_PREFIX_BITS + 8)
+         + __builtin_popcount(c.data16) * (FPC_PREFIX_BITS + 16)
+         + __builtin_popcount(c.data32) * (FPC_PREFIX_BITS + 32);
+}
+
+// returns size of compressed line in bytes, without encoding it
+inline unsigned compressed_size(const uint8_t *line) {
+    return (compressed_bits(line) + 7) / 8;
+}
+
+class FPC_BIT_WRITER {
+  public:
+    uint8_t *output;
+    uint64_t buffer;
+    unsigned buffered, written;
+
+    FPC_BIT_WRITER(uint8_t *out) : output(out), buffer(0), buffered(0), written(0) {}
+
+    void put(uint32_t value, unsigned bits) {
+        buffer |= (uint64_t) value << buffered;
+        buffered += bits;
+        if (buffered >= 32) {
+            for (int i = 0; i < 4; i++)
+                output[written++] = buffer >> (8*i);
+            buffer >>= 32;
+            buffered -= 32;
+        }
+    };
+
+    // returns the number of bits
+    unsigned flush() {
+        unsigned bits = 8*written + buffered;
+        for (; buffered > 0; buffered -= (buffered < 8) ? buffered : 8) {
+            output[written++] = buffer;
+            buffer >>= 8;
+        }
+        return bits;
+    };
+};
+
+// returns size of compressed line in bytes, output needs FPC_MAX_BYTES
+inline unsigned compress(const uint8_t *line, uint8_t *output) {
+    uint32_t word[FPC_WORDS];
+    memcpy(word, line, FPC_LINE_SIZE);
+
+    FPC_MATCH m;
+    match(line, m);
+    FPC_CLASSES c(m);
+
+    FPC_BIT_WRITER writer(output);
+    for (int i = 0; i < FPC_WORDS; i++) {
+        uint32_t w = word[i], bit = 1 << i;
+
+        if (c.zero & bit) {
+            int run = 1;
+            while ((run < FPC_MAX_ZERO_RUN) && (i + 1 < FPC_WORDS) && (c.zero & (bit << run))) {
+                run++;
+                i++;
+            }
+            writer.put(FPC_ZERO_RUN, FPC_PREFIX_BITS);
+            writer.put(run - 1, 3);
+        } else if (c.data4 & bit) {
+            writer.put(FPC_SIGN4, FPC_PREFIX_BITS);
+            writer.put(w & 0xF, 4);
+        } else if (m.sign8 & bit) {
+            writer.put(FPC_SIGN8, FPC_PREFIX_BITS);
+            writer.put(w & 0xFF, 8);
+        } else if (c.data8 & bit) {
+            writer.put(FPC_REPEATED, FPC_PREFIX_BITS);
+            writer.put(w & 0xFF, 8);
+        } else if (m.sign16 & bit) {
+            writer.put(FPC_SIGN16, FPC_PREFIX_BITS);
+            writer.put(w & 0xFFFF, 16);
+        } else if (m.padded & bit) {
+            writer.put(FPC_PADDED, FPC_PREFIX_BITS);
+            writer.put(w >> 16, 16);
+        } else if (c.data16 & bit) {
+            writer.put(FPC_TWO_BYTES, FPC_PREFIX_BITS);
+            writer.put((w & 0xFF) | ((w >> 8) & 0xFF00), 16);
+        } else {
+            writer.put(FPC_UNCOMPRESSED, FPC_PREFIX_BITS);
+            writer.put(w, 32);
+        }
+    }
+
+    return (writer.flush() + 7) / 8;
+}
+
+inline uint32_t read_bits(const uint8_t *input, unsigned &pos, unsigned bits) {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bits; i++, pos++)
+        value |= (uint32_t) ((input[pos / 8] >> (pos % 8)) & 1) << i;
+    return value;
+}
+
+inline uint32_t sign_extend(uint32_t value, unsigned bits) {
+    uint32_t sign = 1U << (bits - 1);
+    return (value ^ sign) - sign;
+}
+
+// decodes the 16 words of a line compressed by compress()
+inline void decompress(const uint8_t *input, uint8_t *line) {
+    uint32_t word[FPC_WORDS];
+    unsigned pos = 0;
+
+    for (int i = 0; i < FPC_WORDS; i++) {
+        switch (read_bits(input, pos, FPC_PREFIX_BITS)) {
+            case FPC_ZERO_RUN:
+                for (int run = read_bits(input, pos, 3); run > 0; run--)
+                    word[i++] = 0;
+                word[i] = 0;
+                break;
+            case FPC_SIGN4:
+                word[i] = sign_extend(read_bits(input, pos, 4), 4);
+                break;
+            case FPC_SIGN8:
+                word[i] = sign_extend(read_bits(input, pos, 8), 8);
+                break;
+            case FPC_SIGN16:
+                word[i] = sign_extend(read_bits(input, pos, 16), 16);
+                break;
+            case FPC_PADDED:
+                word[i] = read_bits(input, pos, 16) << 16;
+                break;
+            case FPC_TWO_BYTES: {
+                uint32_t bytes = read_bits(input, pos, 16);
+                word[i] = (sign_extend(bytes & 0xFF, 8) & 0xFFFF) | (sign_extend(bytes >> 8, 8) << 16);
+                break;
+            }
+            case FPC_REPEATED:
+                word[i] = read_bits(input, pos, 8) * 0x01010101;
+                break;
+            default:
+                word[i] = read_bits(input, pos, 32);
+                break;
+        }
+    }
+
+    memcpy(line, word, FPC_LINE_SIZE);
+}
+
+};
+
+#endif
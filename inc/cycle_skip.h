@@ -0,0 +1,56 @@
+#ifndef CYCLE_SKIP_H
+#define CYCLE_SKIP_H
+
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+// Event-driven cycle skipping (-cycle_skip).
+// Every stage of the main loop only acts when some stored cycle (an event_cycle,
+// next_fill_cycle, bank cycle_available, stall_cycle, ...) comes due, or when the
+// state left behind by another stage lets it. So once a whole loop iteration has
+// gone by without changing anything, nothing will change until the next stored
+// cycle comes due, and the clocks can jump straight to it.
+//
+// "Nothing changed" is checked with a hash of the state the stages touch: a cheap
+// one over a few progress counters and queue occupancies every cycle, and a full
+// one over every queue pointer, counter and ROB, LSQ, cache queue and DRAM bank
+// entry once the cheap one has stopped moving. The full pass also finds the next
+// stored cycle.
+
+class CYCLE_SKIP {
+  public:
+    uint64_t skipped_cycles;
+
+    CYCLE_SKIP();
+
+    // call at the end of every loop iteration, after the uncore has operated
+    void operate();
+
+  private:
+    uint64_t cheap_state, full_state;
+    uint8_t full_valid;
+
+    // state of the current pass
+    uint8_t full;
+    uint64_t hash, weight, cycle, next_event;
+
+    void add(uint64_t value) {
+        // independent multiplies, so the pass is not one long dependency chain
+        hash += value * weight;
+        weight += 0x9E3779B97F4A7C16ULL; // stays odd, so any single change shows
+    };
+
+    void add_event(uint64_t event_cycle) {
+        if ((event_cycle > cycle) && (event_cycle < next_event))
+            next_event = event_cycle;
+    };
+
+    uint64_t scan(uint8_t full_scan);
+    void scan_queue(PACKET_QUEUE *queue, uint8_t in_order),
+         scan_cache(CACHE *cache),
+         scan_core(O3_CPU *core),
+         scan_core_entries(O3_CPU *core),
+         scan_dram(MEMORY_CONTROLLER *dram);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef INTERVAL_LOG_H
+#define INTERVAL_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+using namespace std;
+
+// One file of the usage intervals replacement/interval_dumper.llc_repl records for every LLC set,
+// instead of a CSV per set. Each set buffers up to INTERVAL_LOG_BLOCK intervals and writes them
+// out as a block when full, so the simulator holds at most that many per set:
+//   block   set, intervals, raw bytes, deflated bytes (uint32 each), then the deflated columns
+//   columns varints, one column after another
+//             end - end of the interval before it (a set's intervals end in access order)
+//             end - start
+//             superblock - superblock of the interval before it, zigzag
+//           then log2(cf), four to a byte
+// Blocks start from zero, so each decodes on its own. After the last block comes the index, with
+// each set's interval count and block offsets, and a trailer with the index offset, so a reader
+// seeks straight to the sets it wants:
+//   header  magic, sets
+//   index   per set: intervals (uint64), blocks (uint32), block offsets (uint64 each)
+//   trailer index offset (uint64), magic
+
+#define INTERVAL_LOG_MAGIC 0x31474F4C56544E49ULL // "INTVLOG1"
+#define INTERVAL_LOG_BLOCK 1024
+
+class LOG_INTERVAL {
+  public:
+    uint32_t start, end;
+    uint8_t cf;
+    uint64_t superblock;
+};
+
+class INTERVAL_LOG_WRITER {
+  public:
+    INTERVAL_LOG_WRITER();
+    ~INTERVAL_LOG_WRITER();
+
+    // returns 0 if the file cannot be created
+    int open(const char *path, uint32_t num_sets);
+
+    void add(uint32_t set, const LOG_INTERVAL &interval);
+
+    // writes what the sets still buffer and the index; returns 0 on a write error
+    int close();
+
+  private:
+    FILE *file;
+    uint64_t offset;
+    vector<vector<LOG_INTERVAL>> pending;
+    vector<vector<uint64_t>> blocks;
+    vector<uint64_t> count;
+
+    void flush(uint32_t set);
+};
+
+class INTERVAL_LOG_READER {
+  public:
+    uint32_t num_sets;
+    vector<uint64_t> count; // intervals of each set
+
+    INTERVAL_LOG_READER();
+    ~INTERVAL_LOG_READER();
+
+    // returns 0 if the file is not a complete interval log
+    int open(const char *path);
+
+    // a set's intervals in the order they were logged; returns 0 on a read error
+    int read_set(uint32_t set, vector<LOG_INTERVAL> &interval);
+
+    void close();
+
+  private:
+    FILE *file;
+    vector<vector<uint64_t>> blocks;
+};
+
+#endif
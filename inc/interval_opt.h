@@ -0,0 +1,602 @@
+#ifndef INTERVAL_OPT_H
+#define INTERVAL_OPT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Offline OPT hit counts of a compressed LLC set, from the usage intervals that
+// replacement/interval_dumper.llc_repl writes per set (start,end,cf[,sb]). A kept interval is
+// a hit; it holds space from its start up to, not including, its end. At every moment:
+//   homogenous    lines of the same cf share ways, cf to a way
+//   superblock    lines of the same superblock and cf share ways (YACC), cf to a way
+//   heterogenous  a line takes 1/cf of a way wherever it fits
+// and at most `ways` ways are used. Lines may move between ways at any time, as in the ILPs of
+// scripts/interval2ilp.py.
+//
+// Intervals that fit even when everything is kept are always kept. The rest split into runs of
+// overlapping intervals, each solved by branch and bound over a min-cost flow: dropping the
+// rounding up to whole ways leaves an interval packing LP whose matrix is an interval matrix, so
+// it is a flow along the time axis. Every LP solution is rounded into a solution that fits, and
+// integral ones that still overflow a set branch on the intervals open at the first overflow.
+
+#define OPT_HOMOGENOUS   0
+#define OPT_HETEROGENOUS 1
+#define OPT_SUPERBLOCK   2
+
+#define OPT_NODE_LIMIT 500 // per run of overlapping intervals
+
+// the state of a free interval in a branch and bound node
+#define OPT_FREE    0
+#define OPT_KEPT    1
+#define OPT_DROPPED 2
+
+class OPT_INTERVAL {
+  public:
+    uint64_t start, end, superblock;
+    uint32_t cf;
+};
+
+class OPT_RESULT {
+  public:
+    uint64_t hits,  // of the best solution found
+             bound, // no solution has more hits
+             nodes; // branch and bound nodes solved
+    bool exact;
+
+    OPT_RESULT() : hits(0), bound(0), nodes(0), exact(true) {}
+};
+
+// min-cost flow along a time axis: successive shortest paths with Dijkstra on reduced costs
+class OPT_FLOW {
+  public:
+    class EDGE {
+      public:
+        uint32_t to;
+        int64_t cap, cost;
+    };
+
+    vector<EDGE> edge; // edge i^1 is the residual of edge i
+    vector<vector<uint32_t>> out;
+
+    OPT_FLOW(uint32_t nodes) : out(nodes) {}
+
+    uint32_t add_edge(uint32_t from, uint32_t to, int64_t cap, int64_t cost) {
+        out[from].push_back(edge.size());
+        edge.push_back({to, cap, cost});
+        out[to].push_back(edge.size());
+        edge.push_back({from, 0, -cost});
+        return edge.size() - 2;
+    }
+
+    // sends amount from node 0 to the last node; every edge must go forward (from < to)
+    int64_t min_cost(int64_t amount) {
+        uint32_t n = out.size();
+        const int64_t INF = INT64_MAX / 4;
+
+        // the graph is a DAG in node order, so the first potentials take one pass
+        vector<int64_t> potential(n, INF), dist(n);
+        potential[0] = 0;
+        for (uint32_t u = 0; u < n; u++)
+            if (potential[u] < INF)
+                for (uint32_t e : out[u])
+                    if ((e % 2 == 0) && (edge[e].cap > 0))
+                        potential[edge[e].to] = min(potential[edge[e].to], potential[u] + edge[e].cost);
+
+        vector<uint32_t> via(n);
+        int64_t cost = 0;
+        while (amount > 0) {
+            fill(dist.begin(), dist.end(), INF);
+            dist[0] = 0;
+            priority_queue<pair<int64_t, uint32_t>, vector<pair<int64_t, uint32_t>>, greater<pair<int64_t, uint32_t>>> queue;
+            queue.push({0, 0});
+            while (!queue.empty()) {
+                pair<int64_t, uint32_t> top = queue.top();
+                queue.pop();
+                uint32_t u = top.second;
+                if (top.first > dist[u])
+                    continue;
+                for (uint32_t e : out[u]) {
+                    if (edge[e].cap <= 0)
+                        continue;
+                    uint32_t v = edge[e].to;
+                    int64_t d = dist[u] + edge[e].cost + potential[u] - potential[v];
+                    if (d < dist[v]) {
+                        dist[v] = d;
+                        via[v] = e;
+                        queue.push({d, v});
+                    }
+                }
+            }
+            if (dist[n - 1] >= INF)
+                break;
+            for (uint32_t u = 0; u < n; u++)
+                if (dist[u] < INF)
+                    potential[u] += dist[u];
+
+            int64_t push = amount;
+            for (uint32_t v = n - 1; v != 0; v = edge[via[v] ^ 1].to)
+                push = min(push, edge[via[v]].cap);
+            for (uint32_t v = n - 1; v != 0; v = edge[via[v] ^ 1].to) {
+                edge[via[v]].cap -= push;
+                edge[via[v] ^ 1].cap += push;
+                cost += push * edge[via[v]].cost;
+            }
+            amount -= push;
+        }
+        return cost;
+    }
+};
+
+class INTERVAL_OPT {
+  public:
+    uint32_t model, ways;
+    uint64_t node_limit;
+    double gap; // stop once the best solution is within this fraction of the bound
+
+    INTERVAL_OPT(uint32_t m, uint32_t w, uint64_t limit = OPT_NODE_LIMIT, double g = 0)
+        : model(m), ways(w), node_limit(limit), gap(g) {}
+
+    OPT_RESULT solve(const vector<OPT_INTERVAL> &interval) {
+        OPT_RESULT result;
+        if (interval.empty())
+            return result;
+
+        // space is counted in 1/unit ways, so that every line takes a whole number of them
+        unit = 1;
+        for (const OPT_INTERVAL &i : interval)
+            unit = max(unit, i.cf);
+
+        map<pair<uint64_t, uint32_t>, uint32_t> group_id;
+        group.assign(interval.size(), 0);
+        slots.clear();
+        size.clear();
+        for (uint32_t i = 0; i < interval.size(); i++) {
+            pair<uint64_t, uint32_t> key(0, interval[i].cf);
+            if (model == OPT_HETEROGENOUS)
+                key.first = i;
+            else if (model == OPT_SUPERBLOCK)
+                key.first = interval[i].superblock;
+
+            auto found = group_id.find(key);
+            if (found == group_id.end()) {
+                found = group_id.insert({key, slots.size()}).first;
+                slots.push_back((model == OPT_HETEROGENOUS) ? 1 : interval[i].cf);
+                size.push_back((model == OPT_HETEROGENOUS) ? unit / interval[i].cf : unit);
+            }
+            group[i] = found->second;
+        }
+        capacity = (int64_t) ways * unit;
+
+        // the LP charges a line unit/share of the space, where share is no more than the lines of
+        // its group ever open with it: a superblock with a single line open still takes a way
+        share.assign(interval.size(), 0);
+        for (uint32_t i = 0; i < interval.size(); i++)
+            share[i] = (slots[group[i]] == 1) ? interval[i].cf : 1;
+        vector<vector<uint32_t>> members(slots.size());
+        for (uint32_t i = 0; i < interval.size(); i++)
+            if (slots[group[i]] > 1)
+                members[group[i]].push_back(i);
+        for (vector<uint32_t> &m : members) {
+            if (m.empty())
+                continue;
+            sort(m.begin(), m.end(), [&](uint32_t a, uint32_t b) { return interval[a].start < interval[b].start; });
+
+            // lines of the group open at each start, the most lines open during a line is at one of them
+            vector<uint32_t> open(m.size());
+            priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t>> ends;
+            for (uint32_t k = 0; k < m.size(); k++) {
+                for (; !ends.empty() && (ends.top() <= interval[m[k]].start); ends.pop());
+                ends.push(interval[m[k]].end);
+                open[k] = ends.size();
+            }
+            for (uint32_t k = 0; k < m.size(); k++) {
+                uint32_t most = open[k], limit = slots[group[m[k]]];
+                for (uint32_t j = k + 1; (j < m.size()) && (interval[m[j]].start < interval[m[k]].end) && (most < limit); j++)
+                    most = max(most, open[j]);
+                while ((share[m[k]] < most) && (share[m[k]] < limit))
+                    share[m[k]] *= 2;
+            }
+        }
+
+        // keep every interval that never sees the set overflow with everything kept, empty ones hold no space
+        vector<uint32_t> all;
+        for (uint32_t i = 0; i < interval.size(); i++)
+            if (interval[i].end > interval[i].start)
+                all.push_back(i);
+        vector<uint64_t> overflow = overflow_times(interval, all);
+
+        vector<uint32_t> safe, free;
+        result.hits = result.bound = interval.size() - all.size();
+        for (uint32_t i : all) {
+            auto first = lower_bound(overflow.begin(), overflow.end(), interval[i].start);
+            if ((first == overflow.end()) || (*first >= interval[i].end))
+                safe.push_back(i);
+            else
+                free.push_back(i);
+        }
+        result.hits += safe.size();
+        result.bound += safe.size();
+
+        // the rest splits into runs that overlap in time, the safe intervals there are kept in every solution
+        sort(free.begin(), free.end(), [&](uint32_t a, uint32_t b) { return interval[a].start < interval[b].start; });
+        sort(safe.begin(), safe.end(), [&](uint32_t a, uint32_t b) { return interval[a].start < interval[b].start; });
+        uint32_t next_safe = 0;
+        vector<uint32_t> spanning;
+        for (uint32_t first = 0; first < free.size();) {
+            uint64_t low = interval[free[first]].start, high = interval[free[first]].end;
+            uint32_t last = first + 1;
+            for (; (last < free.size()) && (interval[free[last]].start < high); last++)
+                high = max(high, interval[free[last]].end);
+
+            // safe intervals are sorted by start, the ones that ended before this run can go
+            for (; (next_safe < safe.size()) && (interval[safe[next_safe]].start < high); next_safe++)
+                spanning.push_back(safe[next_safe]);
+            vector<uint32_t> forced;
+            vector<uint32_t> still_open;
+            for (uint32_t i : spanning) {
+                if (interval[i].end > low)
+                    still_open.push_back(i);
+                if ((interval[i].end > low) && (interval[i].start < high))
+                    forced.push_back(i);
+            }
+            spanning.swap(still_open);
+
+            OPT_RESULT run = solve_run(interval, vector<uint32_t>(free.begin() + first, free.begin() + last), forced, low, high);
+            result.hits += run.hits;
+            result.bound += run.bound;
+            result.nodes += run.nodes;
+            result.exact = result.exact && run.exact;
+            first = last;
+        }
+        return result;
+    }
+
+  private:
+    uint32_t unit;
+    int64_t capacity;
+    vector<uint32_t> group, slots, size, share;
+
+    // usage in 1/unit ways of the lines kept in each group
+    class USAGE {
+      public:
+        const INTERVAL_OPT *opt;
+        vector<uint32_t> count;
+        int64_t used;
+
+        USAGE(const INTERVAL_OPT *o) : opt(o), count(o->slots.size(), 0), used(0) {}
+
+        void add(uint32_t i) {
+            uint32_t g = opt->group[i];
+            if (count[g]++ % opt->slots[g] == 0)
+                used += opt->size[g];
+        }
+
+        void remove(uint32_t i) {
+            uint32_t g = opt->group[i];
+            if (--count[g] % opt->slots[g] == 0)
+                used -= opt->size[g];
+        }
+    };
+
+    // the starts at which keeping every interval in `which` overflows the set; usage only grows at
+    // starts, so it overflows from such a start up to the next one
+    vector<uint64_t> overflow_times(const vector<OPT_INTERVAL> &interval, const vector<uint32_t> &which) {
+        vector<uint32_t> order(which);
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return interval[a].start < interval[b].start; });
+
+        vector<uint64_t> overflow;
+        USAGE usage(this);
+        priority_queue<pair<uint64_t, uint32_t>, vector<pair<uint64_t, uint32_t>>, greater<pair<uint64_t, uint32_t>>> open;
+        for (uint32_t i : order) {
+            for (; !open.empty() && (open.top().first <= interval[i].start); open.pop())
+                usage.remove(open.top().second);
+            usage.add(i);
+            open.push({interval[i].end, i});
+            if ((usage.used > capacity) && (overflow.empty() || (overflow.back() != interval[i].start)))
+                overflow.push_back(interval[i].start);
+        }
+        return overflow;
+    }
+
+    // Belady: keep everything, and at an overflow drop the open candidate that ends last
+    vector<uint32_t> greedy(const vector<OPT_INTERVAL> &interval, const vector<uint32_t> &candidate, const vector<uint32_t> &forced) {
+        vector<pair<uint32_t, bool>> order;
+        for (uint32_t i : candidate)
+            order.push_back({i, false});
+        for (uint32_t i : forced)
+            order.push_back({i, true});
+        sort(order.begin(), order.end(), [&](const pair<uint32_t, bool> &a, const pair<uint32_t, bool> &b) {
+            return interval[a.first].start < interval[b.first].start;
+        });
+
+        USAGE usage(this);
+        vector<uint8_t> dropped(interval.size(), 0);
+        set<pair<uint64_t, uint32_t>> droppable;
+        priority_queue<pair<uint64_t, uint32_t>, vector<pair<uint64_t, uint32_t>>, greater<pair<uint64_t, uint32_t>>> open;
+        vector<uint32_t> kept;
+        for (const pair<uint32_t, bool> &o : order) {
+            uint32_t i = o.first;
+            for (; !open.empty() && (open.top().first <= interval[i].start); open.pop()) {
+                uint32_t j = open.top().second;
+                if (!dropped[j]) {
+                    usage.remove(j);
+                    droppable.erase({interval[j].end, j});
+                }
+            }
+
+            usage.add(i);
+            open.push({interval[i].end, i});
+            if (!o.second)
+                droppable.insert({interval[i].end, i});
+            while ((usage.used > capacity) && !droppable.empty()) {
+                uint32_t j = prev(droppable.end())->second;
+                droppable.erase(prev(droppable.end()));
+                usage.remove(j);
+                dropped[j] = 1;
+            }
+        }
+
+        for (uint32_t i : candidate)
+            if (!dropped[i])
+                kept.push_back(i);
+        return kept;
+    }
+
+    class NODE {
+      public:
+        vector<uint8_t> state;
+        uint64_t bound;
+    };
+
+    OPT_RESULT solve_run(const vector<OPT_INTERVAL> &interval, const vector<uint32_t> &free, const vector<uint32_t> &forced, uint64_t low, uint64_t high) {
+        OPT_RESULT result;
+
+        // the run's own time axis: every start and end, clipped to the run
+        vector<uint64_t> time;
+        for (uint32_t i : free) {
+            time.push_back(interval[i].start);
+            time.push_back(interval[i].end);
+        }
+        for (uint32_t i : forced) {
+            time.push_back(max(interval[i].start, low));
+            time.push_back(min(interval[i].end, high));
+        }
+        sort(time.begin(), time.end());
+        time.erase(unique(time.begin(), time.end()), time.end());
+        auto index = [&](uint64_t t) { return (uint32_t) (lower_bound(time.begin(), time.end(), t) - time.begin()); };
+
+        // every line of the run on that axis, the forced ones after the free ones
+        vector<uint32_t> first, last, line_group;
+        for (uint32_t i : free) {
+            first.push_back(index(interval[i].start));
+            last.push_back(index(interval[i].end));
+            line_group.push_back(group[i]);
+        }
+        for (uint32_t i : forced) {
+            first.push_back(index(max(interval[i].start, low)));
+            last.push_back(index(min(interval[i].end, high)));
+            line_group.push_back(group[i]);
+        }
+
+        // lines sharing ways count their group's lines at each time the group spans
+        map<uint32_t, pair<uint32_t, uint32_t>> span;
+        for (uint32_t k = 0; k < first.size(); k++) {
+            if (slots[line_group[k]] == 1)
+                continue;
+            auto found = span.find(line_group[k]);
+            if (found == span.end())
+                span[line_group[k]] = {first[k], last[k]};
+            else
+                found->second = {min(found->second.first, first[k]), max(found->second.second, last[k])};
+        }
+        map<uint32_t, uint32_t> base;
+        uint32_t counters = 0;
+        for (const auto &g : span) {
+            base[g.first] = counters - g.second.first;
+            counters += g.second.second - g.second.first;
+        }
+        vector<uint32_t> line_base(first.size(), 0);
+        for (uint32_t k = 0; k < first.size(); k++)
+            if (slots[line_group[k]] > 1)
+                line_base[k] = base[line_group[k]];
+
+        // rounds an LP solution: the forced and kept lines, then the free ones in order while they fit
+        vector<int64_t> used(time.size());
+        vector<uint32_t> count(counters);
+        auto round = [&](const NODE &node, const vector<uint32_t> &order) {
+            fill(used.begin(), used.end(), 0);
+            fill(count.begin(), count.end(), 0);
+            auto add = [&](uint32_t k, bool check) {
+                uint32_t g = line_group[k];
+                for (uint32_t t = first[k]; check && (t < last[k]); t++)
+                    if ((slots[g] == 1) || (count[line_base[k] + t] % slots[g] == 0))
+                        if (used[t] + size[g] > capacity)
+                            return false;
+                for (uint32_t t = first[k]; t < last[k]; t++) {
+                    if ((slots[g] == 1) || (count[line_base[k] + t] % slots[g] == 0))
+                        used[t] += size[g];
+                    if (slots[g] > 1)
+                        count[line_base[k] + t]++;
+                }
+                return true;
+            };
+
+            uint64_t kept = 0;
+            for (uint32_t k = free.size(); k < first.size(); k++)
+                add(k, false);
+            for (uint32_t k = 0; k < free.size(); k++)
+                if (node.state[k] == OPT_KEPT) {
+                    add(k, false);
+                    kept++;
+                }
+            for (uint32_t k : order)
+                kept += add(k, true);
+            return kept;
+        };
+
+        result.hits = greedy(interval, free, forced).size();
+
+        int64_t big = 1;
+        for (uint32_t i : free)
+            big += share[i];
+
+        vector<NODE> stack(1);
+        stack[0].state.assign(free.size(), OPT_FREE);
+        stack[0].bound = free.size();
+        uint64_t pruned_bound = 0;
+
+        while (!stack.empty() && (result.nodes < node_limit)) {
+            NODE node = stack.back();
+            stack.pop_back();
+            if (node.bound <= result.hits)
+                continue;
+            if (node.bound <= result.hits + (uint64_t) (gap * result.hits)) {
+                pruned_bound = max(pruned_bound, node.bound);
+                continue;
+            }
+            result.nodes++;
+
+            // the LP: unused space runs along the time axis, a kept line takes unit/cf of it
+            OPT_FLOW flow(time.size());
+            for (uint32_t t = 0; t + 1 < time.size(); t++)
+                flow.add_edge(t, t + 1, capacity, 0);
+            for (uint32_t j = 0; j < forced.size(); j++)
+                flow.add_edge(first[free.size() + j], last[free.size() + j], unit / share[forced[j]], -big);
+            vector<uint32_t> edge(free.size());
+            uint64_t kept_count = 0;
+            for (uint32_t k = 0; k < free.size(); k++) {
+                uint32_t i = free[k];
+                if (node.state[k] == OPT_DROPPED)
+                    continue;
+                edge[k] = flow.add_edge(first[k], last[k], unit / share[i],
+                                        (node.state[k] == OPT_KEPT) ? -big : -(int64_t) share[i]);
+                kept_count += (node.state[k] == OPT_KEPT);
+            }
+            flow.min_cost(capacity);
+
+            // every kept line fits (checked when it was kept), so the flow saturates them first
+            uint64_t profit = 0;
+            int32_t fractional = -1;
+            vector<uint32_t> chosen;
+            vector<int64_t> value(free.size(), 0);
+            for (uint32_t k = 0; k < free.size(); k++) {
+                if (node.state[k] == OPT_DROPPED)
+                    continue;
+                int64_t used = unit / share[free[k]] - flow.edge[edge[k]].cap;
+                if (node.state[k] == OPT_KEPT) {
+                    chosen.push_back(free[k]);
+                    continue;
+                }
+                profit += used * share[free[k]];
+                value[k] = used * share[free[k]];
+                if (used == unit / share[free[k]])
+                    chosen.push_back(free[k]);
+                else if ((used > 0) && (fractional < 0))
+                    fractional = k;
+            }
+            node.bound = min(node.bound, kept_count + profit / unit);
+            if (node.bound <= result.hits)
+                continue;
+
+            // the lines the LP keeps most of go first, shorter ones first on ties
+            vector<uint32_t> order;
+            for (uint32_t k = 0; k < free.size(); k++)
+                if (node.state[k] == OPT_FREE)
+                    order.push_back(k);
+            sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return (value[a] != value[b]) ? (value[a] > value[b]) : (last[a] - first[a] < last[b] - first[b]);
+            });
+            result.hits = max(result.hits, round(node, order));
+            if (node.bound <= result.hits)
+                continue;
+
+            if (fractional >= 0) {
+                NODE drop = node, keep = node;
+                drop.state[fractional] = OPT_DROPPED;
+                keep.state[fractional] = OPT_KEPT;
+                stack.push_back(drop);
+                if (fits(interval, free, keep.state, forced))
+                    stack.push_back(keep);
+                continue;
+            }
+
+            // an integral LP solution: done if it fits, else one of the lines open at the first overflow goes
+            vector<uint32_t> open = first_overflow(interval, chosen, forced);
+            if (open.empty())
+                continue;
+
+            // children drop open[c] and keep open[0..c), the line ending last is dropped first
+            vector<uint32_t> position;
+            for (uint32_t i : open)
+                for (uint32_t k = 0; k < free.size(); k++)
+                    if ((free[k] == i) && (node.state[k] == OPT_FREE))
+                        position.push_back(k);
+            sort(position.begin(), position.end(), [&](uint32_t a, uint32_t b) { return interval[free[a]].end > interval[free[b]].end; });
+
+            NODE child = node;
+            vector<NODE> children;
+            for (uint32_t k : position) {
+                NODE drop = child;
+                drop.state[k] = OPT_DROPPED;
+                children.push_back(drop);
+                child.state[k] = OPT_KEPT;
+                if (!fits(interval, free, child.state, forced))
+                    break;
+            }
+            for (auto c = children.rbegin(); c != children.rend(); c++)
+                stack.push_back(*c);
+        }
+
+        result.bound = max(result.hits, pruned_bound);
+        for (const NODE &node : stack)
+            result.bound = max(result.bound, node.bound);
+        result.exact = (result.bound == result.hits);
+        return result;
+    }
+
+    // the free lines open at the first overflow of the chosen ones, or none if they fit
+    vector<uint32_t> first_overflow(const vector<OPT_INTERVAL> &interval, const vector<uint32_t> &chosen, const vector<uint32_t> &forced) {
+        vector<uint32_t> order(chosen);
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return interval[a].start < interval[b].start; });
+        vector<uint8_t> is_forced(interval.size(), 0);
+        for (uint32_t i : forced)
+            is_forced[i] = 1;
+
+        USAGE usage(this);
+        set<pair<uint64_t, uint32_t>> open;
+        for (uint32_t i : order) {
+            while (!open.empty() && (open.begin()->first <= interval[i].start)) {
+                usage.remove(open.begin()->second);
+                open.erase(open.begin());
+            }
+            usage.add(i);
+            open.insert({interval[i].end, i});
+            if (usage.used > capacity) {
+                vector<uint32_t> culprits;
+                for (const pair<uint64_t, uint32_t> &o : open)
+                    if (!is_forced[o.second])
+                        culprits.push_back(o.second);
+                return culprits;
+            }
+        }
+        return vector<uint32_t>();
+    }
+
+    // do the kept lines of a node fit together with the forced ones
+    bool fits(const vector<OPT_INTERVAL> &interval, const vector<uint32_t> &free, const vector<uint8_t> &state, const vector<uint32_t> &forced) {
+        vector<uint32_t> kept(forced);
+        for (uint32_t k = 0; k < free.size(); k++)
+            if (state[k] == OPT_KEPT)
+                kept.push_back(free[k]);
+        return first_overflow(interval, kept, vector<uint32_t>()).empty();
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LLC_MRC_H
+#define LLC_MRC_H
+
+#include "cache.h"
+
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Miss-ratio curves of the LLC stream for many capacities in one run (-llc_mrc FILE[:RATE]).
+// Every request the LLC takes except writebacks, the accesses interval_dumper sees, goes into
+//   - an LRU stack (Mattson): the stack distance of an access is the number of distinct lines
+//     touched since the last access to its line, counted with a Fenwick tree over the times of
+//     every line's last access, so an access hits in every fully associative LRU cache of at
+//     least that many lines
+//   - the same stack weighed in bytes, for compressed LRU caches of the same data capacity:
+//       ideal  each line takes its compressed size (CACHE::get_compressed_size, or BDI in
+//              builds without a compressed cache)
+//       YACC   lines take 64 / cf byte slots, and a 64 byte way holds lines of one superblock
+//              with the same compression factor, as in the compressed LLC. The first line of
+//              a superblock and cf down the stack opens a way and weighs 64, the next cf - 1
+//              weigh nothing, so every top of the stack weighs what it takes to hold it.
+//   - OPTgen (Hawkeye) for each capacity of the curve: a reuse hits in a fully associative
+//     Belady cache if fewer lines than the capacity are live all through its interval. Intervals
+//     longer than LLC_MRC_OPT_WINDOW times the capacity count as misses.
+// With RATE below 1 only superblocks whose address hashes below RATE are profiled (SHARDS),
+// whole so that YACC still sees every line of them: stack distances and OPT capacities are
+// scaled by RATE, and the curve is corrected for the sample taking more or fewer accesses than
+// RATE of the stream. Capacities run from 1/16 to 8 times the LLC in half-octave steps; the
+// curve is printed and written to FILE as CSV at the end, with the uncompressed LRU capacity
+// each compressed cache does as well as.
+
+#define LLC_MRC_MIN_OCTAVE -4 // 1/16 of the LLC
+#define LLC_MRC_MAX_OCTAVE 3  // 8 times the LLC
+#define LLC_MRC_OPT_WINDOW 8
+
+// live lines at each time of the last window accesses: range add and range max over a ring
+class MRC_LIVENESS {
+  public:
+    uint64_t window;
+    vector<int32_t> top, add; // top includes the node's own add
+
+    MRC_LIVENESS(uint64_t w);
+
+    void clear(uint64_t time),
+         increment(uint64_t first, uint64_t last);
+    int32_t max(uint64_t first, uint64_t last);
+
+  private:
+    void update(uint64_t node, uint64_t low, uint64_t high, uint64_t first, uint64_t last, int32_t value);
+    int32_t query(uint64_t node, uint64_t low, uint64_t high, uint64_t first, uint64_t last);
+};
+
+class MRC_OPTGEN {
+  public:
+    uint64_t capacity, // sampled lines
+             hits;
+    MRC_LIVENESS liveness;
+
+    MRC_OPTGEN(uint64_t c);
+
+    // the line was last accessed at sampled time last, and again now
+    void reuse(uint64_t last, uint64_t now);
+    void advance(uint64_t now) { liveness.clear(now); }
+};
+
+// weights of the lines by their slot in the stack, slots grow towards the top
+class MRC_FENWICK {
+  public:
+    vector<uint64_t> tree;
+    uint64_t total;
+
+    void assign(uint64_t slots);
+    void build(const vector<uint64_t> &weight); // weight of each slot from 0
+    void add(uint64_t slot, int64_t value);
+
+    // the slots below slot
+    uint64_t prefix(uint64_t slot);
+    // the slot and everything above it
+    uint64_t from(uint64_t slot) { return total - prefix(slot); }
+};
+
+class MRC_LINE {
+  public:
+    uint64_t slot, // position in the stack
+             time; // sampled access count at the last access
+    uint8_t size,  // compressed bytes
+            cf,
+            yacc;  // bytes it adds to the YACC stack
+};
+
+class LLC_MRC {
+  public:
+    string path; // empty when off
+    FILE *csv;
+    double rate;
+    uint64_t threshold;
+
+    // stack of the sampled lines
+    unordered_map<uint64_t, MRC_LINE> line;
+    MRC_FENWICK marks, ideal_bytes, yacc_bytes;
+    uint64_t next_slot, now;
+
+    // stats since the end of warmup
+    uint64_t accesses, sampled, cold;
+    vector<uint64_t> lru_distance;  // sampled accesses at each stack distance, 1 is the most recent line
+    vector<uint64_t> capacity,      // lines of each point of the curve
+                     sampled_lines; // and of its sampled miniature
+    vector<uint64_t> ideal_hits,    // sampled hits first taken by each point of the curve
+                     yacc_hits;
+    vector<MRC_OPTGEN*> opt;
+
+    LLC_MRC();
+    ~LLC_MRC();
+
+    void configure(const char *spec),
+         operate(CACHE *llc, PACKET *packet),
+         reset_stats(),
+         print();
+
+  private:
+    void move_to_top(MRC_LINE &l, uint8_t size, uint8_t cf),
+         regroup(uint64_t superblock),
+         count_hit(vector<uint64_t> &hits, uint64_t bytes),
+         compact();
+    uint64_t lru_equivalent(double hits);
+};
+
+extern LLC_MRC llc_mrc;
+
+#endif
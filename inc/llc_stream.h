@@ -0,0 +1,96 @@
+#ifndef LLC_STREAM_H
+#define LLC_STREAM_H
+
+#include "cache.h"
+
+#include <zlib.h>
+
+using namespace std;
+
+// LLC access streams (-llc_capture FILE / -llc_replay FILE).
+// A capture run logs every request the LLC takes out of its RQ, WQ and PQ (and every LLC
+// access of a functional warmup), plus markers for the end of warmup and of each core's
+// region of interest. A replay run feeds the stream straight into the functional LLC path,
+// so a replacement policy is evaluated without simulating the cores, the upper caches or
+// DRAM timing. Lines are filled at once instead of when DRAM returns them, so hits to
+// lines still in flight in the capture run count as hits in the replay.
+//
+// The file is gzip compressed when its name ends in ".gz". Each record is
+//   u8 flags   access type (bits 0-1), fills the LLC (bit 2), line data mode (bits 3-4),
+//              or LLC_STREAM_MARK_* for a marker
+//   u8 cpu
+//   u8 compressed size (with the compression of the capture build)
+//   varint     cycle, zigzag delta from the previous record
+//   varint     full_addr, zigzag delta from the previous record
+//   varint     ip, zigzag delta from the previous record
+//   64 bytes   line data, only for LLC_STREAM_DATA_LINE
+// A small direct-mapped table of recent lines, kept the same way by the writer and the
+// reader, turns repeated data into LLC_STREAM_DATA_SAME.
+
+#define LLC_STREAM_MAGIC 0x314D525453434C4CULL // "LLCSTRM1"
+
+#define LLC_STREAM_DATA_LINE 0
+#define LLC_STREAM_DATA_ZERO 1
+#define LLC_STREAM_DATA_SAME 2
+
+#define LLC_STREAM_MARK_WARMUP 0xF0 // every core finished warmup
+#define LLC_STREAM_MARK_FINISH 0xF1 // cpu finished its region of interest
+
+#define LLC_STREAM_LINES 65536 // must be a power of two
+
+class LLC_STREAM_RECORD {
+  public:
+    uint8_t mark, type, fill, cpu;
+    uint32_t compressed_size;
+    uint64_t cycle, full_addr, ip;
+    char data[CACHE_LINE_BYTES];
+};
+
+class LLC_STREAM {
+  public:
+    gzFile file;
+    uint8_t writing;
+    uint64_t records;
+
+    LLC_STREAM();
+    ~LLC_STREAM();
+
+    int  open_write(const char *path),
+         open_read(const char *path);
+    void close();
+
+    // capture
+    void record_access(CACHE *llc, PACKET *packet),
+         record_mark(uint8_t mark, uint32_t cpu);
+
+    // replay, returns 0 at the end of the stream
+    int  read(LLC_STREAM_RECORD *record);
+
+  private:
+    uint64_t last_cycle, last_addr, last_ip;
+
+    // recent line data by line address
+    uint64_t *line_addr;
+    char (*line_data)[CACHE_LINE_BYTES];
+
+    void put_varint(uint8_t *&out, uint64_t value);
+    uint64_t get_varint();
+    void reset();
+};
+
+// stands in for DRAM during a replay, every request is taken and dropped
+class LLC_STREAM_SINK : public MEMORY {
+  public:
+    int  add_rq(PACKET *packet) { return -1; }
+    int  add_wq(PACKET *packet) { return -1; }
+    int  add_pq(PACKET *packet) { return -1; }
+    void return_data(PACKET *packet) {}
+    void operate() {}
+    void increment_WQ_FULL(uint64_t address) {}
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address) { return 0; }
+    uint32_t get_size(uint8_t queue_type, uint64_t address) { return 1; }
+};
+
+extern LLC_STREAM llc_capture;
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LLC_SWEEP_H
+#define LLC_SWEEP_H
+
+#include "cache.h"
+
+#include <vector>
+
+using namespace std;
+
+// Single-pass LLC sweeps (-llc_sweep SPEC).
+// Every request the real LLC takes is also looked up in a number of shadow LLCs. A shadow
+// only keeps tags and replacement state, has no timing and never talks to DRAM, so one run
+// fills in a whole table of LLC configurations. SPEC is a comma separated list of
+//   SETSxWAYS[:lru|:srrip][:u|:c][:bdi|:cpack|:fpc|:none]
+// e.g. -llc_sweep 1024x16,2048x16,4096x16,2048x16:srrip,2048x16:u
+// A compressed shadow (:c, the default in compressed builds) packs up to MAX_COMPRESSIBILITY
+// lines of a superblock with the same compression factor into a way, like the real LLC and
+// clru. Without an algorithm the shadow uses the compression of the build.
+
+#define SHADOW_LRU   0
+#define SHADOW_SRRIP 1
+
+#define SHADOW_BUILD_COMPRESSION 0
+#define SHADOW_BDI               1
+#define SHADOW_CPACK             2
+#define SHADOW_NO_COMPRESSION    3
+#define SHADOW_FPC               4
+
+#define SHADOW_MAX_RRPV 3
+
+class SHADOW_WAY {
+  public:
+    uint64_t sb_tag;
+    uint32_t lru, rrpv,
+             cf; // 0 if the way is invalid
+    uint8_t valid[MAX_COMPRESSIBILITY];
+    uint64_t blk_id[MAX_COMPRESSIBILITY];
+};
+
+class SHADOW_LLC {
+  public:
+    string name;
+    uint32_t num_set, num_way, log2_set, policy, compression;
+    uint8_t compressed;
+
+    SHADOW_WAY *way_state;
+
+    // stats since the end of warmup
+    uint64_t access[NUM_TYPES], hit[NUM_TYPES], miss[NUM_TYPES],
+             lines_stored, lines_stored_over_time, updates,
+             cf_count[MAX_COMPRESSIBILITY];
+
+    SHADOW_LLC(string spec);
+    ~SHADOW_LLC();
+
+    void operate(uint64_t address, uint32_t type, uint8_t fill, uint32_t compressed_size),
+         reset_stats();
+
+  private:
+    int  find_hit(SHADOW_WAY *set, uint64_t sb_tag, uint64_t blk_id);
+    uint32_t find_victim(SHADOW_WAY *set, uint64_t sb_tag, uint32_t cf, uint32_t &slot);
+    void update(SHADOW_WAY *set, uint32_t way, uint32_t type, uint8_t hit, uint32_t cf),
+         evict(SHADOW_WAY *way);
+};
+
+class LLC_SWEEP {
+  public:
+    vector<SHADOW_LLC*> shadow;
+
+    ~LLC_SWEEP();
+
+    void configure(const char *spec),
+         operate(CACHE *llc, PACKET *packet),
+         reset_stats(),
+         print();
+};
+
+extern LLC_SWEEP llc_sweep;
+
+#endif
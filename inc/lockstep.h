@@ -0,0 +1,104 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "cache.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Lock-step multi-threaded cores (-lockstep_quantum N).
+// Every core runs its pipeline, TLBs, L1I, L1D and L2C on its own thread (core 0 on the
+// main thread) for N cycles, then all cores meet at a barrier. Between quanta the main
+// thread alone does the per-core bookkeeping, hands the requests the L2Cs made to the LLC
+// and runs the LLC and DRAM for the same N cycles. While the cores run, each L2C talks to
+// an LLC_PORT instead of the LLC. The page table is the only state the cores share; with
+// a quantum of 1 the cores also take turns on it in core order, so runs are repeatable.
+
+// stands in for the LLC below one core's L2C while the cores run in parallel
+class LLC_PORT : public MEMORY {
+  public:
+    CACHE *llc;
+
+    // requests made during the quantum, handed to the LLC in order
+    vector<PACKET> request;
+    vector<uint8_t> request_type;
+    uint32_t pending[4]; // by queue type, as in get_occupancy()
+    uint64_t wq_full;
+
+    LLC_PORT() {
+        llc = NULL;
+        for (uint32_t i=0; i<4; i++)
+            pending[i] = 0;
+        wq_full = 0;
+    };
+
+    int  add_rq(PACKET *packet),
+         add_wq(PACKET *packet),
+         add_pq(PACKET *packet);
+    void return_data(PACKET *packet),
+         operate(),
+         increment_WQ_FULL(uint64_t address);
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
+             get_size(uint8_t queue_type, uint64_t address);
+
+    void add_request(PACKET *packet, uint8_t queue_type),
+         drain();
+};
+
+class LOCKSTEP {
+  public:
+    uint64_t quantum;
+    uint8_t active; // set while the cores run in parallel
+
+    LLC_PORT port[NUM_CPUS];
+
+    LOCKSTEP() {
+        quantum = 0;
+        active = 0;
+        operate_core = NULL;
+    };
+
+    void start(uint64_t cycles, void (*core_cycle)(uint32_t)),
+         run_cores(),
+         stop();
+
+    // va_to_pa() holds the page table for the whole translation
+    void lock_page_table(uint32_t cpu),
+         unlock_page_table();
+
+  private:
+    void (*operate_core)(uint32_t);
+
+    thread worker[NUM_CPUS];
+    atomic<uint64_t> epoch, finished_cycle[NUM_CPUS];
+    atomic<uint32_t> finished;
+    atomic<uint8_t> stopping;
+    mutex page_table_mutex;
+
+    void run_worker(uint32_t cpu),
+         run_core(uint32_t cpu);
+};
+
+extern LOCKSTEP lockstep;
+
+class LOCKSTEP_PAGE_TABLE_LOCK {
+    uint8_t locked;
+
+  public:
+    LOCKSTEP_PAGE_TABLE_LOCK(uint32_t cpu) {
+        locked = lockstep.active;
+        if (locked)
+            lockstep.lock_page_table(cpu);
+    };
+
+    ~LOCKSTEP_PAGE_TABLE_LOCK() {
+        if (locked)
+            lockstep.unlock_page_table();
+    };
+};
+
+#endif
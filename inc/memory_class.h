@@ -35,6 +35,7 @@ class MEMORY {
     virtual uint32_t get_occupancy(uint8_t queue_type, uint64_t address) = 0;
     virtual uint32_t get_size(uint8_t queue_type, uint64_t address) = 0;
     virtual void inform_tlb_eviction(uint64_t insert_page_addr, uint64_t evict_page_addr) {}
+    virtual void functional_access(PACKET *packet) {}
 
     // stats
     uint64_t ACCESS[NUM_TYPES], HIT[NUM_TYPES], MISS[NUM_TYPES], MSHR_MERGED[NUM_TYPES], STALL[NUM_TYPES];
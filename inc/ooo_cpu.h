@@ -2,6 +2,7 @@
 #define OOO_CPU_H
 
 #include "cache.h"
+#include "trace_reader.h"
 
 #ifdef CRC2_COMPILE
 #define STAT_PRINTING_PERIOD 1000000
@@ -33,9 +34,8 @@ class O3_CPU {
     uint32_t cpu;
 
     // trace
-    FILE *trace_file;
+    TRACE_READER trace_reader;
     char trace_string[1024];
-    char gunzip_command[1024];
 
     // instruction
     input_instr current_instr;
@@ -86,9 +86,6 @@ class O3_CPU {
     O3_CPU() {
         cpu = 0;
 
-        // trace
-        trace_file = NULL;
-
         // instruction
         instr_unique_id = 0;
         completed_executions = 0;
@@ -168,14 +165,17 @@ class O3_CPU {
          reg_RAW_dependency(uint32_t prior, uint32_t current, uint32_t source_index),
          reg_RAW_release(uint32_t rob_index),
          mem_RAW_dependency(uint32_t prior, uint32_t current, uint32_t data_index, uint32_t lq_index),
-         handle_o3_fetch(PACKET *current_packet, uint32_t cache_type),
-         handle_merged_translation(PACKET *provider),
-         handle_merged_load(PACKET *provider),
+         handle_o3_fetch(PACKET *current_packet, PACKET_DEPS *current_deps, uint32_t cache_type),
+         handle_merged_translation(PACKET *provider, PACKET_DEPS *provider_deps),
+         handle_merged_load(PACKET *provider, PACKET_DEPS *provider_deps),
          release_load_queue(uint32_t lq_index),
          complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb),
          complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb);
 
     void initialize_core();
+    void functional_instruction(),
+         functional_access(CACHE *cache, uint64_t ip, uint64_t pa, uint8_t type, uint8_t is_instruction, uint8_t asid[2], const uint8_t *program_data);
+    uint64_t functional_translate(CACHE *tlb, uint64_t ip, uint64_t va, uint8_t type, uint8_t is_instruction, uint8_t asid[2]);
     void add_load_queue(uint32_t rob_index, uint32_t data_index),
          add_store_queue(uint32_t rob_index, uint32_t data_index),
          execute_store(uint32_t rob_index, uint32_t sq_index, uint32_t data_index);
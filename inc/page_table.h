@@ -0,0 +1,85 @@
+#ifndef PAGE_TABLE_H
+#define PAGE_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+using namespace std;
+
+// Flat open-addressing hash table from a page number to a 64-bit value, used by va_to_pa
+// for the page tables and the per-page cache line footprint, and by PACKET_QUEUE to find
+// entries by address. Keys live in one array and
+// values in another, probing is linear and erase shifts the following entries back, so
+// there are no tombstones and no allocation per entry. The table doubles once it is half
+// full. Page numbers never reach FLAT_MAP_EMPTY, which marks a free slot.
+
+#define FLAT_MAP_EMPTY UINT64_MAX
+#define FLAT_MAP_MIN_CAPACITY 1024
+
+class FLAT_MAP {
+  public:
+    uint64_t *key, *value,
+             capacity, occupancy;
+
+    FLAT_MAP(uint64_t initial_capacity = FLAT_MAP_MIN_CAPACITY);
+    ~FLAT_MAP();
+
+    // NULL when the key is not in the table
+    uint64_t *find(uint64_t k) {
+        for (uint64_t slot = hash(k); ; slot = (slot + 1) & (capacity - 1)) {
+            if (key[slot] == k)
+                return &value[slot];
+            if (key[slot] == FLAT_MAP_EMPTY)
+                return NULL;
+        }
+    };
+
+    // returns the value of k, inserting v first if k is not in the table
+    uint64_t &insert(uint64_t k, uint64_t v);
+
+    void erase(uint64_t k),
+         clear();
+
+    uint64_t size() { return occupancy; };
+
+  private:
+    uint64_t hash(uint64_t k) { return (k * 0x9E3779B97F4A7C15ULL) >> (64 - log2_capacity); };
+
+    uint64_t min_capacity;
+    uint32_t log2_capacity;
+
+    void allocate(uint64_t new_capacity),
+         grow();
+};
+
+// CLOCK (second chance) replacement over the simulated DRAM page frames. Frames are handed
+// out in allocation order until DRAM is full, and page_table maps a vpage to its frame. After
+// that, a major fault takes the first frame under the hand that was not referenced (walked
+// by va_to_pa) since the hand last passed it, clearing reference bits on the way.
+
+class PAGE_CLOCK {
+  public:
+    // one entry per frame
+    vector<uint64_t> vpage, ppage;
+    vector<uint8_t> cpu, referenced;
+
+    uint64_t hand,
+             swaps, scanned, second_chances;
+
+    PAGE_CLOCK();
+
+    // returns the new frame
+    uint64_t add(uint32_t owner, uint64_t frame_vpage, uint64_t frame_ppage);
+
+    void advance() {
+        scanned++;
+        if (++hand == vpage.size())
+            hand = 0;
+    };
+
+    void clear();
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRACE_INDEX_H
+#define TRACE_INDEX_H
+
+#include "champsim.h"
+
+#include <vector>
+
+using namespace std;
+
+// trace compression formats, picked from the trace file extension
+#define TRACE_FORMAT_GZIP 0
+#define TRACE_FORMAT_XZ   1
+#define TRACE_FORMAT_ZSTD 2
+
+// Sidecar index (<trace>.idx) of places in a compressed trace where decoding can
+// start without reading everything before them.
+//   - xz: one point per xz block, decoded on its own with the stream's check type.
+//     Traces need more than one block to be useful, e.g. compress with `xz -T0`.
+//   - gzip: zran-style access points at deflate block boundaries every `span`
+//     uncompressed bytes, each carrying the 32KB window needed to resume there.
+// Points are keyed by uncompressed byte offset, which does not depend on how the
+// simulator was built; the reader turns an instruction count into an offset.
+
+#define TRACE_INDEX_MAGIC 0x3158444952545343ULL // "CSTRIDX1"
+#define TRACE_INDEX_WINDOW 32768
+#define TRACE_INDEX_DEFAULT_SPAN (256ULL << 20)
+
+struct TRACE_INDEX_POINT {
+    uint64_t uncompressed_offset, compressed_offset;
+
+    // gzip: number of bits of the byte before compressed_offset that still belong to the stream
+    // xz: lzma_check of the stream the block belongs to
+    uint32_t bits;
+
+    // gzip only, the last 32KB of output before this point
+    uint32_t window_size;
+    uint8_t *window;
+};
+
+class TRACE_INDEX {
+  public:
+    int format;
+    uint64_t trace_size;
+    vector<TRACE_INDEX_POINT> point;
+
+    TRACE_INDEX();
+    ~TRACE_INDEX();
+
+    void clear();
+
+    // scans the whole trace; returns 0 on failure
+    int build(const char *trace_path, int trace_format, uint64_t span);
+
+    int save(const char *index_path);
+
+    // returns 0 if there is no index, or it belongs to another version of the trace
+    int load(const char *index_path, const char *trace_path, int trace_format);
+
+    // last point at or before the given offset, -1 if there is none
+    int find(uint64_t uncompressed_offset);
+
+  private:
+    int build_gzip(FILE *trace, uint64_t span);
+    int build_xz(FILE *trace);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include "champsim.h"
+#include "compact_trace.h"
+#include "trace_index.h"
+
+#include <atomic>
+#include <thread>
+
+#include <zlib.h>
+#include <lzma.h>
+
+using namespace std;
+
+// number of decoded records buffered ahead of the core (must be a power of two)
+#ifndef TRACE_READER_RING_SIZE
+    #define TRACE_READER_RING_SIZE 8192
+#endif
+
+#define TRACE_READER_CHUNK (1 << 16)
+#define TRACE_READER_STAGE_SIZE (1 << 16)
+
+// Decodes a trace on a dedicated thread and hands fixed-size records to the
+// simulation thread through a single-producer/single-consumer ring.
+// gzip and xz are decoded in-process; zstd is piped through the zstd binary.
+// Compact DATA_TRACE streams (see compact_trace.h) are recognized by their magic
+// number and expanded back into input_instr records on the reader thread.
+// When the trace runs out the reader thread re-opens it and queues a wrap
+// marker, so the core sees the same "end of trace" event as before.
+// A number of leading instructions can be skipped without simulating them; if
+// the trace has a sidecar index (see trace_index.h) the reader seeks to the
+// closest indexed point first and only decodes the remainder.
+class TRACE_READER {
+  public:
+    char path[1024];
+    int format;
+    size_t record_size;
+
+    // instructions skipped before the first record, and whether an index is used for that
+    uint64_t skip_instructions;
+    int skip_with_index;
+
+    TRACE_READER();
+    ~TRACE_READER();
+
+    // picks the format from the extension; returns -1 if it is not supported
+    static int detect_format(const char *trace_path);
+
+    // opens the trace on the calling thread (so a missing file is reported
+    // right away) and starts the read-ahead thread; returns 0 on failure
+    int open(const char *trace_path, int trace_format, size_t size, uint64_t skip = 0);
+
+    // copies the next record into dest and returns 1, or returns 0 when the
+    // trace wrapped around
+    int read(void *dest);
+
+    void close();
+
+  private:
+    // ring storage, slot i holds a record or a wrap marker
+    uint8_t *records;
+    uint8_t *wrap;
+
+    // producer and consumer indices live on separate cache lines; each side
+    // keeps a cached copy of the other's index and only reloads it when the
+    // ring looks full/empty, so records are drained in bulk
+    alignas(64) std::atomic<uint64_t> tail;
+    uint64_t cached_head;
+    alignas(64) std::atomic<uint64_t> head;
+    uint64_t cached_tail;
+    alignas(64) std::atomic<uint8_t> stop;
+
+    std::thread worker;
+
+    // decoder state
+    FILE *raw_file;
+    uint8_t *source_in;
+    z_stream gz_stream;
+    lzma_stream xz_stream;
+    int source_open;
+
+    // gzip: decoding raw deflate after a seek, and trailer bytes left to skip before the next member
+    int gz_raw;
+    uint32_t gz_trailer;
+
+    // xz: block being decoded after a seek, -1 when decoding whole streams
+    int xz_block;
+
+    TRACE_INDEX index;
+
+    // bytes decoded from the source but not consumed yet
+    uint8_t *stage;
+    size_t stage_begin, stage_end;
+
+    // set when the trace is in the compact DATA_TRACE format
+    int compact;
+    COMPACT_TRACE *compact_state;
+
+    int open_source();
+    int open_source_at(int index_point);
+    int open_xz_block(int index_point);
+    size_t read_source(uint8_t *dest, size_t size);
+    void close_source();
+    void skip_records(uint64_t count);
+
+    size_t fill_stage(size_t wanted);
+    size_t read_record(uint8_t *dest);
+
+    uint8_t *reserve_slot();
+    void run();
+};
+
+#endif
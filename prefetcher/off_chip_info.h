@@ -1,6 +1,7 @@
 #ifndef __OFF_CHIP_INFO_H
 #define __OFF_CHIP_INFO_H
 
+#include <cstdint>
 #include <map>
 
 #define STREAM_MAX_LENGTH 1024
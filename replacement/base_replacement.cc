@@ -21,16 +21,13 @@ uint32_t CACHE::lru_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const
     uint32_t way = 0;
 
     // fill invalid line first
-    for (way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid == false) {
+    way = find_way(set, INVALID_TAG);
+    if (way < NUM_WAY) {
 
-            DP ( if (warmup_complete[cpu]) {
-            cout << "[" << NAME << "] " << __func__ << " instr_id: " << instr_id << " invalid set: " << set << " way: " << way;
-            cout << hex << " address: " << (full_addr>>LOG2_BLOCK_SIZE) << " victim address: " << block[set][way].address << " data: " << block[set][way].data;
-            cout << dec << " lru: " << block[set][way].lru << endl; });
-
-            break;
-        }
+        DP ( if (warmup_complete[cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " instr_id: " << instr_id << " invalid set: " << set << " way: " << way;
+        cout << hex << " address: " << (full_addr>>LOG2_BLOCK_SIZE) << " victim address: " << block[set][way].address << " data: " << block[set][way].data;
+        cout << dec << " lru: " << block[set][way].lru << endl; });
     }
 
     // LRU victim
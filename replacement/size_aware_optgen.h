@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include <array>
 #include <map>
+#include <cassert>
 
 /**
  * A generic interface for a cache model which we can query to check if a given usage interval could/could not be
@@ -106,14 +107,193 @@ public:
     uint64_t head_quanta() const { return _head_quanta; }
     uint64_t end_quanta() const { return (_head_quanta + _size == 0) ? 0 : _head_quanta + _size - 1; }
 
+    // Push zeros until the given quanta is in the buffer.
+    void extend(size_t quanta) {
+        while(after_end(quanta)) push(0);
+    }
+
+    // Add value to every element from quanta first to last (inclusive), which must be in the buffer.
+    void add(size_t first, size_t last, T value) {
+        for(size_t quanta = first; quanta <= last; quanta++) (*this)[quanta] += value;
+    }
+
+    // The largest element from quanta first to last (inclusive), which must be in the buffer.
+    T max(size_t first, size_t last) const {
+        T result = 0;
+        for(size_t quanta = first; quanta <= last; quanta++) result = std::max(result, (*this)[quanta]);
+        return result;
+    }
+
     // Operator [] overrides.
     const T& operator[](size_t quanta) const { return buffer[quanta_index(quanta)]; }
     T& operator[](size_t quanta) { return buffer[quanta_index(quanta)]; }
 };
 
-template<size_t capacity> struct OPTgen : public CacheGen {
+/**
+ * A drop-in replacement for OptgenRingBuffer which keeps the elements in a lazy segment tree, so that add() and max()
+ * over a range take O(log capacity) instead of O(range); select it with e.g. OPTgen<16384, OptgenSegmentTree>. Quanta q
+ * always lives in leaf (q % capacity), so a range in the buffer covers at most two leaf ranges. Takes about four times
+ * the memory of the ring buffer, and elements can only be read by value.
+ */
+template<typename T, uint32_t _capacity> class OptgenSegmentTree {
+    // The number of leaves, a power of two no smaller than the capacity.
+    size_t leaves = 1;
+
+    // The maximum of every node's subtree (root at 1, leaves at [leaves, 2*leaves)), including its own pending add.
+    std::vector<T> maximum;
+
+    // Pending add and clear for the children of every inner node; a clear comes before the add.
+    std::vector<T> pending_add;
+    std::vector<uint8_t> pending_clear;
+
+    // The current size of the buffer.
+    size_t _size = 0;
+
+    // The quanta of the head of the buffer.
+    size_t _head_quanta = 0;
+
+    void apply_clear(size_t node) {
+        maximum[node] = 0;
+        if(node < leaves) {
+            pending_add[node] = 0;
+            pending_clear[node] = 1;
+        }
+    }
+
+    void apply_add(size_t node, T value) {
+        maximum[node] += value;
+        if(node < leaves) pending_add[node] += value;
+    }
+
+    void push_down(size_t node) {
+        if(pending_clear[node]) {
+            apply_clear(2*node);
+            apply_clear(2*node + 1);
+            pending_clear[node] = 0;
+        }
+        if(pending_add[node]) {
+            apply_add(2*node, pending_add[node]);
+            apply_add(2*node + 1, pending_add[node]);
+            pending_add[node] = 0;
+        }
+    }
+
+    // Clear (clear set) or add value to the leaves [first, last] under node, which covers [low, high].
+    void update(size_t node, size_t low, size_t high, size_t first, size_t last, bool clear, T value) {
+        if(last < low || high < first) return;
+        if(first <= low && high <= last) {
+            if(clear) apply_clear(node);
+            else apply_add(node, value);
+            return;
+        }
+
+        push_down(node);
+        size_t mid = (low + high) / 2;
+        update(2*node, low, mid, first, last, clear, value);
+        update(2*node + 1, mid + 1, high, first, last, clear, value);
+        maximum[node] = std::max(maximum[2*node], maximum[2*node + 1]);
+    }
+
+    // The largest of the leaves [first, last] under node, which covers [low, high], leaving pending updates in place.
+    T query(size_t node, size_t low, size_t high, size_t first, size_t last) const {
+        if(first <= low && high <= last) return maximum[node];
+
+        size_t mid = (low + high) / 2;
+        T result = 0;
+        if(first <= mid) result = std::max(result, query(2*node, low, mid, first, last));
+        if(mid < last) result = std::max(result, query(2*node + 1, mid + 1, high, first, last));
+
+        // Every element below node is pending_add higher, or just pending_add if a clear is pending for all of them.
+        return pending_clear[node] ? pending_add[node] : result + pending_add[node];
+    }
+
+    // Apply an update to the quanta [first, last], at most one capacity apart, splitting it where it wraps.
+    void update_quanta(size_t first, size_t last, bool clear, T value) {
+        if(first > last) return;
+
+        size_t low = first % _capacity, high = last % _capacity;
+        if(low <= high) {
+            update(1, 0, leaves - 1, low, high, clear, value);
+        } else {
+            update(1, 0, leaves - 1, low, _capacity - 1, clear, value);
+            update(1, 0, leaves - 1, 0, high, clear, value);
+        }
+    }
+
+public:
+    OptgenSegmentTree() {
+        while(leaves < _capacity) leaves *= 2;
+        maximum.assign(2*leaves, 0);
+        pending_add.assign(leaves, 0);
+        pending_clear.assign(leaves, 0);
+    }
+
+    // Push a new element onto the buffer.
+    void push(T&& element) {
+        size_t quanta = _head_quanta + _size;
+        extend(quanta);
+        if(element) update_quanta(quanta, quanta, false, element);
+    }
+
+    // Push zeros until the given quanta is in the buffer.
+    void extend(size_t quanta) {
+        if(!after_end(quanta)) return;
+
+        size_t first = _head_quanta + _size;
+        if(quanta - first + 1 >= _capacity) update(1, 0, leaves - 1, 0, leaves - 1, true, 0);
+        else update_quanta(first, quanta, true, 0);
+
+        _size += quanta - first + 1;
+        if(_size > _capacity) {
+            _head_quanta += _size - _capacity;
+            _size = _capacity;
+        }
+    }
+
+    // Add value to every element from quanta first to last (inclusive), which must be in the buffer.
+    void add(size_t first, size_t last, T value) { update_quanta(first, last, false, value); }
+
+    // The largest element from quanta first to last (inclusive), which must be in the buffer.
+    T max(size_t first, size_t last) const {
+        if(first > last) return 0;
+
+        size_t low = first % _capacity, high = last % _capacity;
+        if(low <= high) return query(1, 0, leaves - 1, low, high);
+        return std::max(query(1, 0, leaves - 1, low, _capacity - 1), query(1, 0, leaves - 1, 0, high));
+    }
+
+    // Return true if the given quanta is in the bounds of the buffer.
+    bool in_bounds(size_t quanta) const {
+        return quanta >= _head_quanta && quanta < _head_quanta + _size;
+    }
+
+    // Return true if the given quanta is before the start of the buffer.
+    bool before_start(size_t quanta) const {
+        return quanta < _head_quanta;
+    }
+
+    // Return true if the given quanta is after the end of the buffer.
+    bool after_end(size_t quanta) const {
+        return quanta >= _head_quanta + _size;
+    }
+
+    // Clamp the quanta to be in the bounds of the buffer.
+    size_t clamp(size_t quanta) const {
+        // If there's nothing in the buffer, there's no way to clamp, so just return 0.
+        if(_head_quanta + _size == 0) return 0;
+
+        return std::max(std::min(quanta, _head_quanta + _size - 1), _head_quanta);
+    }
+
+    uint64_t head_quanta() const { return _head_quanta; }
+    uint64_t end_quanta() const { return (_head_quanta + _size == 0) ? 0 : _head_quanta + _size - 1; }
+
+    T operator[](size_t quanta) const { return max(quanta, quanta); }
+};
+
+template<size_t capacity, template<typename, uint32_t> class Liveness = OptgenRingBuffer> struct OPTgen : public CacheGen {
     // Liveness vector; capacity limited.
-    OptgenRingBuffer<uint32_t, capacity> liveness;
+    Liveness<uint32_t, capacity> liveness;
 
     // The number of total cached lines in the past.
     uint64_t num_cached = 0;
@@ -139,10 +319,10 @@ template<size_t capacity> struct OPTgen : public CacheGen {
 
         // start_quanta is in or after the buffer (via can_cache), and end_quanta is after start_quanta, so shift up
         // until it's in the buffer.
-        while(liveness.after_end(end_quanta)) liveness.push(0);
+        liveness.extend(end_quanta);
 
         // Increment all entries in the buffer from clamp(start_quanta) to end_quanta.
-        for(uint64_t quanta = liveness.clamp(start_quanta); quanta <= end_quanta; quanta++) liveness[quanta]++;
+        liveness.add(liveness.clamp(start_quanta), end_quanta, 1);
 
         num_cached++;
         return true;
@@ -156,10 +336,8 @@ template<size_t capacity> struct OPTgen : public CacheGen {
         if(liveness.after_end(start_quanta)) return true;
 
         // Start quanta is in bounds, check if all entries are < max cache size.
-        for(uint64_t quanta = start_quanta; quanta <= liveness.clamp(end_quanta); quanta++)
-            if(liveness[quanta] >= cache_size) return false;
-
-        return true;
+        uint64_t last = liveness.clamp(end_quanta);
+        return last < start_quanta || liveness.max(start_quanta, last) < cache_size;
     }
 
     /**
@@ -173,7 +351,7 @@ template<size_t capacity> struct OPTgen : public CacheGen {
     virtual uint64_t num_hits() const override { return num_cached; }
 };
 
-template<uint32_t capacity> struct YACCSuperblock {
+template<uint32_t capacity, template<typename, uint32_t> class Liveness = OptgenRingBuffer> struct YACCSuperblock {
     // The time that this superblock started.
     uint64_t start_quanta;
 
@@ -184,7 +362,7 @@ template<uint32_t capacity> struct YACCSuperblock {
     uint32_t cf;
 
     // The liveness within this superblock/way.
-    OptgenRingBuffer<uint8_t, capacity> liveness;
+    Liveness<uint8_t, capacity> liveness;
 
     YACCSuperblock(uint64_t start, uint64_t superblock, uint32_t cf)
         : start_quanta(start), superblock(superblock), cf(cf), liveness() {}
@@ -204,10 +382,8 @@ template<uint32_t capacity> struct YACCSuperblock {
         if(liveness.after_end(rel_start)) return true;
 
         // Start quanta is in bounds, check if all entries are < max cache size.
-        for(uint64_t quanta = rel_start; quanta <= liveness.clamp(rel_end); quanta++)
-            if(liveness[quanta] >= cf) return false;
-
-        return true;
+        uint64_t last = liveness.clamp(rel_end);
+        return last < rel_start || liveness.max(rel_start, last) < cf;
     }
 
     /** Cache the given usage interval. */
@@ -217,22 +393,22 @@ template<uint32_t capacity> struct YACCSuperblock {
 
         // start_quanta is in or after the buffer (via can_cache), and end_quanta is after start_quanta, so shift up
         // until it's in the buffer.
-        while(liveness.after_end(rel_end)) liveness.push(0);
+        liveness.extend(rel_end);
 
         // Increment all entries in the buffer from clamp(start_quanta) to end_quanta.
-        for(uint64_t quanta = liveness.clamp(rel_start); quanta <= rel_end; quanta++) liveness[quanta]++;
+        liveness.add(liveness.clamp(rel_start), rel_end, 1);
     }
 };
 
 /**
  * A cache model which checks if YACC would be able to cache given cache accesses. This is a homogenous cache model.
  */
-template<uint32_t capacity> struct YACCgen : public CacheGen {
+template<uint32_t capacity, template<typename, uint32_t> class Liveness = OptgenRingBuffer> struct YACCgen : public CacheGen {
     // The size of the cache, in cache lines.
     uint64_t cache_size;
 
     // A per-way tracker for which superblock is currently active.
-    std::vector<YACCSuperblock<capacity>> superblocks;
+    std::vector<YACCSuperblock<capacity, Liveness>> superblocks;
 
     // The number of total cached lines in the past.
     uint64_t num_cached = 0;
@@ -308,7 +484,7 @@ template<uint32_t capacity> struct YACCgen : public CacheGen {
         if(superblocks[target_way].cf == cf && superblocks[target_way].superblock == superblock) {
             superblocks[target_way].cache(start_quanta, end_quanta);
         } else {
-            superblocks[target_way] = YACCSuperblock<capacity>(start_quanta, superblock, cf);
+            superblocks[target_way] = YACCSuperblock<capacity, Liveness>(start_quanta, superblock, cf);
             superblocks[target_way].cache(start_quanta, end_quanta);
         }
 
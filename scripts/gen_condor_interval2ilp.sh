@@ -65,7 +65,8 @@ OUTPUT_DIR="${RUN_DIR}"
 
 for TRACE_NAME in $(ls ${DUMP_DIR}); do
     CSV_FILES=( $(ls ${DUMP_DIR}/${TRACE_NAME}) )
-    NUM_CHUNKS=$((${#CSV_FILES[@]} / CHUNK_SIZE))
+    # newer dumps are a single intervals.log, which only interval_opt reads
+    NUM_CHUNKS=$(((${#CSV_FILES[@]} + CHUNK_SIZE - 1) / CHUNK_SIZE))
     FILE_DIR="${OUTPUT_DIR}/${TRACE_NAME}"
     mkdir -p ${FILE_DIR}
     mkdir -p ${FILE_DIR}/condor_metadata
@@ -169,9 +169,10 @@ def process_file(job):
         
         start_time = time.time()
         headers = next(interval_reader, None)
-        assert(headers[0] == 'start' and headers[1] == 'end' and headers[2] == 'cf' and len(headers) == 3)
+        # newer dumps add the superblock of each line (sb), which these models do not use
+        assert(headers[0] == 'start' and headers[1] == 'end' and headers[2] == 'cf' and len(headers) in (3, 4))
 
-        intervals = [[int(y) for y in x] for x in interval_reader]
+        intervals = [[int(y) for y in x[:3]] for x in interval_reader]
         if len(intervals) < job.set_size:
             return (job.path, job.set_size, len(intervals), time.time() - start_time)
 
@@ -0,0 +1,218 @@
+/*
+ * Computes the compressed-cache OPT of the per-set usage intervals dumped by
+ * replacement/interval_dumper.llc_repl, in place of interval2ilp.py and its ILP solver.
+ * See inc/interval_opt.h for the models and the solver.
+ *
+ *   ./interval_opt [--model homogenous|heterogenous|superblock] [--size ways] [-j threads]
+ *                  [--gap fraction] [--nodes limit] intervals.log|csv...
+ *
+ * Takes the interval logs the dumper writes (every set in them is solved) or the CSVs of older
+ * dumps. Prints "<csv>: <hits>/<intervals> (<seconds>s)" per set as it finishes, like
+ * interval2ilp.py, with "<log>:<set>" for a set of a log,
+ * followed by "[bound <hits>]" when the node limit or gap stopped the search before it proved
+ * the count optimal. The gap defaults to the 1% interval2ilp.py gave CBC, --gap 0 and a large
+ * --nodes search for exact counts. The superblock model needs the sb column of newer CSVs.
+ */
+
+#include "interval_log.h"
+#include "interval_opt.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// returns false with a message if the file is not a usage interval CSV
+static bool read_intervals(const char *path, bool need_superblock, vector<OPT_INTERVAL> &interval, string &error) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        error = "cannot open";
+        return false;
+    }
+
+    char line[256];
+    bool has_superblock = false;
+    if ((fgets(line, sizeof(line), file) == NULL) || (strncmp(line, "start,end,cf", 12) != 0)) {
+        fclose(file);
+        error = "not a usage interval file";
+        return false;
+    }
+    has_superblock = (strncmp(line, "start,end,cf,sb", 15) == 0);
+    if (need_superblock && !has_superblock) {
+        fclose(file);
+        error = "no sb column for the superblock model, dump the intervals again";
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        OPT_INTERVAL i;
+        unsigned long long start, end, superblock = 0;
+        int fields = sscanf(line, "%llu,%llu,%u,%llu", &start, &end, &i.cf, &superblock);
+        if (fields < (has_superblock ? 4 : 3) || (i.cf == 0) || (i.cf & (i.cf - 1))) {
+            fclose(file);
+            error = "bad interval " + string(line);
+            return false;
+        }
+        i.start = start;
+        i.end = end;
+        i.superblock = superblock;
+        interval.push_back(i);
+    }
+    fclose(file);
+    return true;
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [--model homogenous|heterogenous|superblock] [--size ways] [-j threads]"
+         << " [--gap fraction] [--nodes limit] intervals.log|csv..." << endl;
+}
+
+// a set to solve: a CSV, or one set of a log
+class JOB {
+  public:
+    const char *path;
+    int64_t set;
+};
+
+static bool is_log(const char *path) {
+    FILE *file = fopen(path, "rb");
+    uint64_t magic = 0;
+    bool log = (file != NULL) && (fread(&magic, sizeof(magic), 1, file) == 1) && (magic == INTERVAL_LOG_MAGIC);
+    if (file != NULL)
+        fclose(file);
+    return log;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t model = OPT_HOMOGENOUS, ways = 16, threads = max(1U, thread::hardware_concurrency() / 2);
+    uint64_t node_limit = OPT_NODE_LIMIT;
+    double gap = 0.01;
+
+    static struct option long_options[] = {
+        {"model", required_argument, 0, 'm'},
+        {"size", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 'j'},
+        {"gap", required_argument, 0, 'g'},
+        {"nodes", required_argument, 0, 'n'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:s:j:g:n:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                if (strcmp(optarg, "homogenous") == 0)
+                    model = OPT_HOMOGENOUS;
+                else if (strcmp(optarg, "heterogenous") == 0)
+                    model = OPT_HETEROGENOUS;
+                else if (strcmp(optarg, "superblock") == 0)
+                    model = OPT_SUPERBLOCK;
+                else {
+                    cerr << "interval_opt: unrecognized model " << optarg << endl;
+                    return 1;
+                }
+                break;
+            case 's':
+                ways = atoi(optarg);
+                break;
+            case 'j':
+                threads = max(1, atoi(optarg));
+                break;
+            case 'g':
+                gap = atof(optarg);
+                break;
+            case 'n':
+                node_limit = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto overall_start = chrono::steady_clock::now();
+    atomic<bool> failed(false);
+    vector<JOB> jobs;
+    for (int file = optind; file < argc; file++) {
+        if (!is_log(argv[file])) {
+            jobs.push_back({argv[file], -1});
+            continue;
+        }
+        INTERVAL_LOG_READER log;
+        if (!log.open(argv[file])) {
+            cerr << "interval_opt: " << argv[file] << ": incomplete interval log" << endl;
+            failed = true;
+            continue;
+        }
+        for (uint32_t set = 0; set < log.num_sets; set++)
+            jobs.push_back({argv[file], set});
+    }
+
+    // sets are independent, every worker takes the next one until none are left
+    atomic<uint64_t> next(0);
+    mutex output;
+    vector<thread> workers;
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            map<const char *, unique_ptr<INTERVAL_LOG_READER>> logs;
+            for (uint64_t job = next++; job < jobs.size(); job = next++) {
+                auto start = chrono::steady_clock::now();
+                vector<OPT_INTERVAL> interval;
+                string name = jobs[job].path, error;
+                if (jobs[job].set < 0) {
+                    if (!read_intervals(jobs[job].path, model == OPT_SUPERBLOCK, interval, error)) {
+                        lock_guard<mutex> lock(output);
+                        cerr << "interval_opt: " << name << ": " << error << endl;
+                        failed = true;
+                        continue;
+                    }
+                } else {
+                    name += ":" + to_string(jobs[job].set);
+                    unique_ptr<INTERVAL_LOG_READER> &log = logs[jobs[job].path];
+                    if (!log) {
+                        log.reset(new INTERVAL_LOG_READER());
+                        log->open(jobs[job].path);
+                    }
+                    vector<LOG_INTERVAL> logged;
+                    if (!log->read_set(jobs[job].set, logged)) {
+                        lock_guard<mutex> lock(output);
+                        cerr << "interval_opt: " << name << ": cannot read the set" << endl;
+                        failed = true;
+                        continue;
+                    }
+                    for (const LOG_INTERVAL &i : logged)
+                        interval.push_back({i.start, i.end, i.superblock, i.cf});
+                }
+
+                INTERVAL_OPT solver(model, ways, node_limit, gap);
+                OPT_RESULT result = solver.solve(interval);
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+                lock_guard<mutex> lock(output);
+                printf("%s: %lu/%zu (%.2fs)", name.c_str(), result.hits, interval.size(), seconds);
+                if (!result.exact)
+                    printf(" [bound %lu]", result.bound);
+                printf("\n");
+                fflush(stdout);
+            }
+        });
+    }
+    for (thread &worker : workers)
+        worker.join();
+
+    printf("\nTotal Execution Time: %.2fs\n", chrono::duration<double>(chrono::steady_clock::now() - overall_start).count());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1 @@
+g++ -std=c++14 -O2 -I../inc/ -o interval_opt interval_opt.cpp ../src/interval_log.cc -lz -pthread
@@ -5,75 +5,89 @@ int PACKET_QUEUE::check_queue(PACKET *packet)
     if ((head == tail) && occupancy == 0)
         return -1;
 
-    if (head < tail) {
-        for (uint32_t i=head; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
+    int index = find_entry(packet);
+    if (index != -2)
+        return index;
+
+    // several entries have the address, the oldest one wins
+    for (uint32_t i=head, n=0; n<occupancy; n++) {
+        if (index_key(&entry[i]) == index_key(packet)) {
+            DP (if (warmup_complete[packet->cpu]) {
+            cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
+            cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
+            cout << " cycle " << packet->event_cycle << endl; });
+            return i;
         }
+
+        i++;
+        if (i >= SIZE)
+            i = 0;
     }
-    else {
-        for (uint32_t i=head; i<SIZE; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-        }
-        for (uint32_t i=0; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
+
+    return -1;
+}
+
+// the entry with the address of packet, -1 if there is none, or -2 when the caller has to
+// scan because several entries have it (or the address is 0, like the free entries)
+int PACKET_QUEUE::find_entry(PACKET *packet)
+{
+    uint64_t key = index_key(packet);
+    if (key == 0)
+        return -2;
+
+    uint64_t *found = address_index.find(key);
+    if (found == NULL)
+        return -1;
+    if ((*found >> 32) > 1)
+        return -2;
+
+    return (uint32_t) *found;
+}
+
+void PACKET_QUEUE::index_entry(uint32_t index)
+{
+    uint64_t key = index_key(&entry[index]);
+    if (key == 0)
+        return;
+
+    uint64_t &count_and_index = address_index.insert(key, 0);
+    if (count_and_index == 0)
+        count_and_index = (1ULL << 32) | index;
+    else
+        count_and_index = (((count_and_index >> 32) + 1) << 32) | UINT32_MAX;
+}
+
+void PACKET_QUEUE::unindex_entry(uint32_t index)
+{
+    uint64_t key = index_key(&entry[index]);
+    if (key == 0)
+        return;
+
+    uint64_t *count_and_index = address_index.find(key);
+#ifdef SANITY_CHECK
+    if (count_and_index == NULL)
+        assert(0);
+#endif
+    uint64_t count = *count_and_index >> 32;
+    if (count == 1) {
+        address_index.erase(key);
+        return;
+    }
+
+    // find the one that is left
+    uint32_t remaining = UINT32_MAX;
+    if (count == 2) {
+        for (uint32_t i=0; i<SIZE; i++) {
+            if ((i != index) && (index_key(&entry[i]) == key)) {
+                remaining = i;
+                break;
             }
         }
     }
-
-    return -1;
+    *count_and_index = ((count - 1) << 32) | remaining;
 }
 
-void PACKET_QUEUE::add_queue(PACKET *packet)
+void PACKET_QUEUE::add_queue(PACKET *packet, PACKET_DEPS *packet_deps)
 {
 #ifdef SANITY_CHECK
     if (occupancy && (head == tail))
@@ -82,6 +96,9 @@ void PACKET_QUEUE::add_queue(PACKET *packet)
 
     // add entry
     entry[tail] = *packet;
+    if (deps && packet_deps)
+        deps[tail] = *packet_deps;
+    index_entry(tail);
 
     DP ( if (warmup_complete[packet->cpu]) {
     cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id;
@@ -106,9 +123,13 @@ void PACKET_QUEUE::remove_queue(PACKET *packet)
     cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec << " fill_level: " << packet->fill_level;
     cout << " head: " << head << " tail: " << tail << " occupancy: " << occupancy << " event_cycle: " << packet->event_cycle << endl; });
 
+    unindex_entry(packet - entry);
+
     // reset entry
-    PACKET empty_packet;
+    static const PACKET empty_packet;
     *packet = empty_packet;
+    if (deps)
+        deps[packet - entry] = PACKET_DEPS();
 
     occupancy--;
     head++;
@@ -1,9 +1,24 @@
 #include "cache.h"
+#include "llc_stream.h"
+#include "llc_mrc.h"
+#include "llc_sweep.h"
 #include "set.h"
 #include "compression/bdi.h"
 #include "compression/cpack.h"
+#include "compression/fpc.h"
 
 uint64_t l2pf_access = 0;
+
+// every request the LLC takes is seen by the access stream capture, the shadow LLCs and the miss-ratio curve profiler
+static void observe_llc_access(CACHE *llc, PACKET *packet)
+{
+    if (llc_capture.file)
+        llc_capture.record_access(llc, packet);
+    if (llc_sweep.shadow.size())
+        llc_sweep.operate(llc, packet);
+    if (llc_mrc.path.size())
+        llc_mrc.operate(llc, packet);
+}
 #ifdef COMPRESSED_CACHE
 void CACHE::configure_compressed_cache()
 {
@@ -17,6 +32,10 @@ void CACHE::configure_compressed_cache()
             compressed_cache_block[i][j].compressionFactor = 0;
         }
     }
+
+    cc_sb_tag = new uint64_t[(uint64_t) NUM_SET*NUM_WAY];
+    for (uint64_t i=0; i<(uint64_t) NUM_SET*NUM_WAY; i++)
+        cc_sb_tag[i] = INVALID_TAG;
 }
 #endif
 
@@ -41,7 +60,7 @@ void CACHE::handle_fill()
 
 #ifdef COMPRESSED_CACHE
         uint32_t evicted_cf = 0;
-        uint32_t compressed_size = get_compressed_size(MSHR.entry[mshr_index].program_data);
+        uint32_t compressed_size = get_compressed_size(&MSHR.entry[mshr_index]);
         uint32_t compression_factor = get_compression_factor(compressed_size);
 #endif
 
@@ -99,7 +118,7 @@ void CACHE::handle_fill()
 
         uint8_t  do_fill = 1;
 #ifdef COMPRESSED_CACHE
-        if(is_compressed) do_fill = evict_compressed_line(set, way, MSHR.entry[mshr_index], evicted_cf);
+        if(is_compressed) do_fill = evict_compressed_line(set, way, &MSHR.entry[mshr_index], evicted_cf);
         else {
             // TODO: OH GOD KILL ME
 #endif
@@ -132,7 +151,9 @@ void CACHE::handle_fill()
                     writeback_packet.address = block[set][way].address;
                     writeback_packet.full_addr = block[set][way].full_addr;
                     writeback_packet.data = block[set][way].data;
-                    memcpy( writeback_packet.program_data, block[set][way].program_data, CACHE_LINE_BYTES);
+                    memcpy( writeback_packet.program_data, line_data(set, way), CACHE_LINE_BYTES);
+                    writeback_packet.compressed_size = block[set][way].compressed_size;
+                    writeback_packet.compressor = block[set][way].compressor;
                     writeback_packet.instr_id = MSHR.entry[mshr_index].instr_id;
                     writeback_packet.ip = 0; // writeback does not have ip
                     writeback_packet.type = WRITEBACK;
@@ -210,20 +231,20 @@ void CACHE::handle_fill()
             if (cache_type == IS_ITLB) {
                 MSHR.entry[mshr_index].instruction_pa = block[set][way].data;
                 if (PROCESSED.occupancy < PROCESSED.SIZE)
-                    PROCESSED.add_queue(&MSHR.entry[mshr_index]);
+                    PROCESSED.add_queue(&MSHR.entry[mshr_index], &MSHR.deps[mshr_index]);
             }
             else if (cache_type == IS_DTLB) {
                 MSHR.entry[mshr_index].data_pa = block[set][way].data;
                 if (PROCESSED.occupancy < PROCESSED.SIZE)
-                    PROCESSED.add_queue(&MSHR.entry[mshr_index]);
+                    PROCESSED.add_queue(&MSHR.entry[mshr_index], &MSHR.deps[mshr_index]);
             }
             else if (cache_type == IS_L1I) {
                 if (PROCESSED.occupancy < PROCESSED.SIZE)
-                    PROCESSED.add_queue(&MSHR.entry[mshr_index]);
+                    PROCESSED.add_queue(&MSHR.entry[mshr_index], &MSHR.deps[mshr_index]);
             }
             else if ((cache_type == IS_L1D) && (MSHR.entry[mshr_index].type != PREFETCH)) {
                 if (PROCESSED.occupancy < PROCESSED.SIZE)
-                    PROCESSED.add_queue(&MSHR.entry[mshr_index]);
+                    PROCESSED.add_queue(&MSHR.entry[mshr_index], &MSHR.deps[mshr_index]);
             }
 
             if(MSHR.entry[mshr_index].type == LOAD)
@@ -252,7 +273,7 @@ void CACHE::handle_writeback()
         int way = check_hit(&WQ.entry[index]);
         bool force_victim = false;
 #ifdef COMPRESSED_CACHE
-        uint32_t compressed_size = get_compressed_size(WQ.entry[index].program_data);
+        uint32_t compressed_size = get_compressed_size(&WQ.entry[index]);
         uint32_t compression_factor = get_compression_factor(compressed_size);
         uint32_t myCF = 0;
 
@@ -335,6 +356,9 @@ void CACHE::handle_writeback()
             HIT[WQ.entry[index].type]++;
             ACCESS[WQ.entry[index].type]++;
 
+            if (cache_type == IS_LLC)
+                observe_llc_access(this, &WQ.entry[index]);
+
             // remove this entry from WQ
             WQ.remove_queue(&WQ.entry[index]);
         }
@@ -355,7 +379,7 @@ void CACHE::handle_writeback()
                 if ((mshr_index == -1) && (MSHR.occupancy < MSHR_SIZE)) { // this is a new miss
 
                     // add it to mshr (RFO miss)
-                    add_mshr(&WQ.entry[index]);
+                    add_mshr(&WQ.entry[index], &WQ.deps[index]);
 
                     // add it to the next level's read queue
                     //if (lower_level) // L1D always has a lower level cache
@@ -379,6 +403,7 @@ void CACHE::handle_writeback()
                             uint8_t  prior_returned = MSHR.entry[mshr_index].returned;
                             uint64_t prior_event_cycle = MSHR.entry[mshr_index].event_cycle;
 			    MSHR.entry[mshr_index] = WQ.entry[index];
+			    MSHR.deps[mshr_index] = WQ.deps[index];
 
                             // in case request is already returned, we should keep event_cycle and retunred variables
                             MSHR.entry[mshr_index].returned = prior_returned;
@@ -405,6 +430,9 @@ void CACHE::handle_writeback()
                     MISS[WQ.entry[index].type]++;
                     ACCESS[WQ.entry[index].type]++;
 
+                    if (cache_type == IS_LLC)
+                        observe_llc_access(this, &WQ.entry[index]);
+
                     // remove this entry from WQ
                     WQ.remove_queue(&WQ.entry[index]);
                 }
@@ -437,7 +465,7 @@ void CACHE::handle_writeback()
 
                 uint8_t  do_fill = 1;
 #ifdef COMPRESSED_CACHE
-                if(is_compressed) do_fill = evict_compressed_line(set, way, WQ.entry[index], evicted_cf);
+                if(is_compressed) do_fill = evict_compressed_line(set, way, &WQ.entry[index], evicted_cf);
                 else {
                     // TODO: OH GOD KILL ME
 #endif
@@ -469,7 +497,9 @@ void CACHE::handle_writeback()
                             writeback_packet.address = block[set][way].address;
                             writeback_packet.full_addr = block[set][way].full_addr;
                             writeback_packet.data = block[set][way].data;
-                            memcpy( writeback_packet.program_data, block[set][way].program_data, CACHE_LINE_BYTES);
+                            memcpy( writeback_packet.program_data, line_data(set, way), CACHE_LINE_BYTES);
+                            writeback_packet.compressed_size = block[set][way].compressed_size;
+                            writeback_packet.compressor = block[set][way].compressor;
                             writeback_packet.instr_id = WQ.entry[index].instr_id;
                             writeback_packet.ip = 0;
                             writeback_packet.type = WRITEBACK;
@@ -541,6 +571,9 @@ void CACHE::handle_writeback()
                     MISS[WQ.entry[index].type]++;
                     ACCESS[WQ.entry[index].type]++;
 
+                    if (cache_type == IS_LLC)
+                        observe_llc_access(this, &WQ.entry[index]);
+
                     // remove this entry from WQ
                     WQ.remove_queue(&WQ.entry[index]);
                 }
@@ -579,23 +612,23 @@ void CACHE::handle_read()
                 if (cache_type == IS_ITLB) {
                     RQ.entry[index].instruction_pa = block[set][way].data;
                     if (PROCESSED.occupancy < PROCESSED.SIZE)
-                        PROCESSED.add_queue(&RQ.entry[index]);
+                        PROCESSED.add_queue(&RQ.entry[index], &RQ.deps[index]);
                 }
                 else if (cache_type == IS_DTLB) {
                     RQ.entry[index].data_pa = block[set][way].data;
                     if (PROCESSED.occupancy < PROCESSED.SIZE)
-                        PROCESSED.add_queue(&RQ.entry[index]);
+                        PROCESSED.add_queue(&RQ.entry[index], &RQ.deps[index]);
                 }
                 else if (cache_type == IS_STLB)
                     RQ.entry[index].data = block[set][way].data;
                 else if (cache_type == IS_L1I) {
                     if (PROCESSED.occupancy < PROCESSED.SIZE)
-                        PROCESSED.add_queue(&RQ.entry[index]);
+                        PROCESSED.add_queue(&RQ.entry[index], &RQ.deps[index]);
                 }
                 //else if (cache_type == IS_L1D) {
                 else if ((cache_type == IS_L1D) && (RQ.entry[index].type != PREFETCH)) {
                     if (PROCESSED.occupancy < PROCESSED.SIZE)
-                        PROCESSED.add_queue(&RQ.entry[index]);
+                        PROCESSED.add_queue(&RQ.entry[index], &RQ.deps[index]);
                 }
 
                 // update prefetcher on load instruction
@@ -654,6 +687,9 @@ void CACHE::handle_read()
                 HIT[RQ.entry[index].type]++;
                 ACCESS[RQ.entry[index].type]++;
 
+                if (cache_type == IS_LLC)
+                    observe_llc_access(this, &RQ.entry[index]);
+
                 // remove this entry from RQ
                 RQ.remove_queue(&RQ.entry[index]);
             }
@@ -672,7 +708,7 @@ void CACHE::handle_read()
                 if ((mshr_index == -1) && (MSHR.occupancy < MSHR_SIZE)) { // this is a new miss
 
                     // add it to mshr (read miss)
-                    add_mshr(&RQ.entry[index]);
+                    add_mshr(&RQ.entry[index], &RQ.deps[index]);
 
                     // add it to the next level's read queue
                     if (lower_level)
@@ -706,29 +742,29 @@ void CACHE::handle_read()
                             if (RQ.entry[index].tlb_access) {
                                 uint32_t sq_index = RQ.entry[index].sq_index;
                                 MSHR.entry[mshr_index].store_merged = 1;
-                                MSHR.entry[mshr_index].sq_index_depend_on_me.insert (sq_index);
-				MSHR.entry[mshr_index].sq_index_depend_on_me.join (RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                                MSHR.deps[mshr_index].sq_index_depend_on_me.insert (sq_index);
+				MSHR.deps[mshr_index].sq_index_depend_on_me.join (RQ.deps[index].sq_index_depend_on_me, SQ_SIZE);
                             }
 
                             if (RQ.entry[index].load_merged) {
                                 //uint32_t lq_index = RQ.entry[index].lq_index;
                                 MSHR.entry[mshr_index].load_merged = 1;
                                 //MSHR.entry[mshr_index].lq_index_depend_on_me[lq_index] = 1;
-				MSHR.entry[mshr_index].lq_index_depend_on_me.join (RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+				MSHR.deps[mshr_index].lq_index_depend_on_me.join (RQ.deps[index].lq_index_depend_on_me, LQ_SIZE);
                             }
                         }
                         else {
                             if (RQ.entry[index].instruction) {
                                 uint32_t rob_index = RQ.entry[index].rob_index;
                                 MSHR.entry[mshr_index].instr_merged = 1;
-                                MSHR.entry[mshr_index].rob_index_depend_on_me.insert (rob_index);
+                                MSHR.deps[mshr_index].rob_index_depend_on_me.insert (rob_index);
 
                                 DP (if (warmup_complete[MSHR.entry[mshr_index].cpu]) {
                                 cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
                                 cout << " merged rob_index: " << rob_index << " instr_id: " << RQ.entry[index].instr_id << endl; });
 
                                 if (RQ.entry[index].instr_merged) {
-				    MSHR.entry[mshr_index].rob_index_depend_on_me.join (RQ.entry[index].rob_index_depend_on_me, ROB_SIZE);
+				    MSHR.deps[mshr_index].rob_index_depend_on_me.join (RQ.deps[index].rob_index_depend_on_me, ROB_SIZE);
                                     DP (if (warmup_complete[MSHR.entry[mshr_index].cpu]) {
                                     cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
                                     cout << " merged rob_index: " << i << " instr_id: N/A" << endl; });
@@ -738,15 +774,15 @@ void CACHE::handle_read()
                             {
                                 uint32_t lq_index = RQ.entry[index].lq_index;
                                 MSHR.entry[mshr_index].load_merged = 1;
-                                MSHR.entry[mshr_index].lq_index_depend_on_me.insert (lq_index);
+                                MSHR.deps[mshr_index].lq_index_depend_on_me.insert (lq_index);
 
                                 DP (if (warmup_complete[read_cpu]) {
                                 cout << "[DATA_MERGED] " << __func__ << " cpu: " << read_cpu << " instr_id: " << RQ.entry[index].instr_id;
                                 cout << " merged rob_index: " << RQ.entry[index].rob_index << " instr_id: " << RQ.entry[index].instr_id << " lq_index: " << RQ.entry[index].lq_index << endl; });
-				MSHR.entry[mshr_index].lq_index_depend_on_me.join (RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+				MSHR.deps[mshr_index].lq_index_depend_on_me.join (RQ.deps[index].lq_index_depend_on_me, LQ_SIZE);
                                 if (RQ.entry[index].store_merged) {
                                     MSHR.entry[mshr_index].store_merged = 1;
-				    MSHR.entry[mshr_index].sq_index_depend_on_me.join (RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+				    MSHR.deps[mshr_index].sq_index_depend_on_me.join (RQ.deps[index].sq_index_depend_on_me, SQ_SIZE);
                                 }
                             }
                         }
@@ -760,6 +796,7 @@ void CACHE::handle_read()
                             uint8_t  prior_returned = MSHR.entry[mshr_index].returned;
                             uint64_t prior_event_cycle = MSHR.entry[mshr_index].event_cycle;
                             MSHR.entry[mshr_index] = RQ.entry[index];
+                            MSHR.deps[mshr_index] = RQ.deps[index];
 
                             // in case request is already returned, we should keep event_cycle and retunred variables
                             MSHR.entry[mshr_index].returned = prior_returned;
@@ -793,6 +830,9 @@ void CACHE::handle_read()
                     MISS[RQ.entry[index].type]++;
                     ACCESS[RQ.entry[index].type]++;
 
+                    if (cache_type == IS_LLC)
+                        observe_llc_access(this, &RQ.entry[index]);
+
                     // remove this entry from RQ
                     RQ.remove_queue(&RQ.entry[index]);
                 }
@@ -874,6 +914,9 @@ void CACHE::handle_prefetch()
                 HIT[PQ.entry[index].type]++;
                 ACCESS[PQ.entry[index].type]++;
 
+                if (cache_type == IS_LLC)
+                    observe_llc_access(this, &PQ.entry[index]);
+
                 // remove this entry from PQ
                 PQ.remove_queue(&PQ.entry[index]);
             }
@@ -905,7 +948,7 @@ void CACHE::handle_prefetch()
                             else {
                                 // add it to MSHRs if this prefetch miss will be filled to this cache level
                                 if (PQ.entry[index].fill_level <= fill_level)
-                                    add_mshr(&PQ.entry[index]);
+                                    add_mshr(&PQ.entry[index], &PQ.deps[index]);
 
                                 lower_level->add_rq(&PQ.entry[index]); // add it to the DRAM RQ
                             }
@@ -916,7 +959,7 @@ void CACHE::handle_prefetch()
                             else {
                                 // add it to MSHRs if this prefetch miss will be filled to this cache level
                                 if (PQ.entry[index].fill_level <= fill_level)
-                                    add_mshr(&PQ.entry[index]);
+                                    add_mshr(&PQ.entry[index], &PQ.deps[index]);
 
                                 lower_level->add_pq(&PQ.entry[index]); // add it to the DRAM RQ
                             }
@@ -965,6 +1008,9 @@ void CACHE::handle_prefetch()
                     MISS[PQ.entry[index].type]++;
                     ACCESS[PQ.entry[index].type]++;
 
+                    if (cache_type == IS_LLC)
+                        observe_llc_access(this, &PQ.entry[index]);
+
                     // remove this entry from PQ
                     PQ.remove_queue(&PQ.entry[index]);
                 }
@@ -973,6 +1019,248 @@ void CACHE::handle_prefetch()
     }
 }
 
+void CACHE::functional_access(PACKET *packet)
+{
+    // functional warmup: look the line up, fetch it from the lower levels on a miss and fill it right away,
+    // updating the tags, replacement state and prefetchers the same way handle_fill/writeback/read/prefetch do
+    uint32_t access_cpu = packet->cpu;
+    uint32_t set = get_set(packet->address);
+    int way;
+    uint8_t is_write = (packet->type == WRITEBACK) || ((cache_type == IS_L1D) && (packet->type == RFO));
+    bool force_victim = false;
+
+    if (cache_type == IS_LLC)
+        observe_llc_access(this, packet);
+
+#ifdef COMPRESSED_CACHE
+    uint32_t compressed_size = 0, compression_factor = 0;
+    if (is_compressed) {
+        set = get_set_cc(packet->address);
+        way = check_hit_cc(packet);
+
+        // a writeback that changes the compression factor is refilled
+        if (is_write && (way >= 0)) {
+            compressed_size = get_compressed_size(packet);
+            compression_factor = get_compression_factor(compressed_size);
+            if (compressed_cache_block[set][way].compressionFactor != compression_factor) {
+                invalidate_entry_cc(packet->address);
+                force_victim = true;
+            }
+        }
+    }
+    else
+#endif
+    way = check_hit(packet);
+
+    if ((way >= 0) && (!force_victim)) { // hit
+
+        if (cache_type == IS_ITLB || cache_type == IS_DTLB || cache_type == IS_STLB)
+            packet->data = block[set][way].data;
+
+        // update prefetcher on load instruction
+        if (packet->type == LOAD) {
+            if (cache_type == IS_L1D)
+                l1d_prefetcher_operate(block[set][way].full_addr, packet->ip, 1, packet->type);
+            else if (cache_type == IS_L2C)
+                l2c_prefetcher_operate(block[set][way].full_addr, packet->ip, 1, packet->type);
+        }
+
+        // update replacement policy
+        if (cache_type == IS_LLC) {
+#ifdef COMPRESSED_CACHE
+            if (is_compressed) {
+                uint32_t blkid = get_blkid_cc(packet->address);
+                for (uint32_t cf = 0; cf < compressed_cache_block[set][way].compressionFactor; cf++) {
+                    if ((compressed_cache_block[set][way].valid[cf] == 1) && (compressed_cache_block[set][way].blkId[cf] == blkid)) {
+                        if (is_write) {
+                            llc_update_replacement_state_cc(access_cpu, set, way, cf, compressed_cache_block[set][way].full_addr[cf], packet->ip, 0, packet->type, compression_factor, compressed_size, 1, 0, 0);
+                            compressed_cache_block[set][way].dirty[cf] = 1;
+                        }
+                        else
+                            llc_update_replacement_state_cc(access_cpu, set, way, cf, compressed_cache_block[set][way].full_addr[cf], packet->ip, 0, packet->type, compressed_cache_block[set][way].compressionFactor, compressed_cache_block[set][way].compressed_size[cf], 1, 0, 0);
+                    }
+                }
+            }
+            else
+#endif
+            llc_update_replacement_state(access_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1, 0, 0);
+        }
+        else
+            update_replacement_state(access_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1);
+
+        // COLLECT STATS
+        sim_hit[access_cpu][packet->type]++;
+        sim_access[access_cpu][packet->type]++;
+
+        if (is_write)
+            block[set][way].dirty = 1;
+        else if (packet->type != PREFETCH) {
+            // update prefetch stats and reset prefetch bit
+            if (block[set][way].prefetch) {
+                pf_useful++;
+                block[set][way].prefetch = 0;
+            }
+            block[set][way].used = 1;
+        }
+
+        HIT[packet->type]++;
+        ACCESS[packet->type]++;
+    }
+    else { // miss
+
+        // writebacks carry the whole line, everything else (including the L1D RFO) reads it from below
+        if (packet->type != WRITEBACK) {
+            if (lower_level)
+                lower_level->functional_access(packet);
+            else if (cache_type == IS_STLB) {
+                // emulate page table walk
+                uint64_t pa = va_to_pa(access_cpu, packet->instr_id, packet->full_addr, packet->address);
+                packet->data = pa >> LOG2_PAGE_SIZE;
+            }
+        }
+
+        // update prefetcher on load instruction
+        if (packet->type == LOAD) {
+            if (cache_type == IS_L1D)
+                l1d_prefetcher_operate(packet->full_addr, packet->ip, 0, packet->type);
+            if (cache_type == IS_L2C)
+                l2c_prefetcher_operate(packet->full_addr, packet->ip, 0, packet->type);
+        }
+
+        MISS[packet->type]++;
+        ACCESS[packet->type]++;
+
+        // prefetches are only filled down to their fill level
+        if ((packet->type != PREFETCH) || (packet->fill_level <= fill_level))
+            functional_fill(packet, is_write);
+    }
+
+    // prefetches issued on the way are handled right away
+    for (uint32_t i=0; (i<PQ.SIZE) && (PQ.occupancy > 0); i++) {
+        PACKET prefetch_packet = PQ.entry[PQ.head];
+        PQ.remove_queue(&PQ.entry[PQ.head]);
+        functional_access(&prefetch_packet);
+    }
+}
+
+void CACHE::functional_fill(PACKET *packet, uint8_t dirty)
+{
+    uint32_t fill_cpu = packet->cpu;
+
+    // find victim
+    uint32_t set = get_set(packet->address), way;
+
+#ifdef COMPRESSED_CACHE
+    uint32_t evicted_cf = 0, compressed_size = 0, compression_factor = 0;
+    if (is_compressed) {
+        compressed_size = get_compressed_size(packet);
+        compression_factor = get_compression_factor(compressed_size);
+    }
+#endif
+
+    if (cache_type == IS_LLC) {
+#ifdef COMPRESSED_CACHE
+        if (is_compressed) {
+            set = get_set_cc(packet->address);
+            way = llc_find_victim_cc(fill_cpu, packet->instr_id, set, compressed_cache_block[set], packet->ip, packet->full_addr, packet->type, compression_factor, compressed_size, evicted_cf);
+        } else
+#endif
+            way = llc_find_victim(fill_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+    }
+    else
+        way = find_victim(fill_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+
+#ifdef LLC_BYPASS
+    if ((cache_type == IS_LLC) && (way == LLC_WAY)) { // this is a bypass that does not fill the LLC
+
+        if (packet->type == WRITEBACK) {
+            cerr << "LLC bypassing for writebacks is not allowed!" << endl;
+            assert(0);
+        }
+
+        // update replacement policy
+#ifdef COMPRESSED_CACHE
+        if (is_compressed)
+            llc_update_replacement_state_cc(fill_cpu, set, way, evicted_cf, packet->full_addr, packet->ip, 0, packet->type, compression_factor, compressed_size, 0, 0, 0);
+        else
+#endif
+            llc_update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, 0, packet->type, 0, 0, 0);
+
+        // COLLECT STATS
+        sim_miss[fill_cpu][packet->type]++;
+        sim_access[fill_cpu][packet->type]++;
+
+        return;
+    }
+#endif
+
+    // the lower levels have no queues to fill up, so the victim can always be written back
+#ifdef COMPRESSED_CACHE
+    if (is_compressed)
+        evict_compressed_line(set, way, packet, evicted_cf);
+    else
+#endif
+    if (block[set][way].dirty && lower_level) {
+        PACKET writeback_packet;
+
+        writeback_packet.fill_level = fill_level << 1;
+        writeback_packet.cpu = fill_cpu;
+        writeback_packet.address = block[set][way].address;
+        writeback_packet.full_addr = block[set][way].full_addr;
+        writeback_packet.data = block[set][way].data;
+        memcpy( writeback_packet.program_data, line_data(set, way), CACHE_LINE_BYTES);
+        writeback_packet.compressed_size = block[set][way].compressed_size;
+        writeback_packet.compressor = block[set][way].compressor;
+        writeback_packet.instr_id = packet->instr_id;
+        writeback_packet.ip = 0; // writeback does not have ip
+        writeback_packet.type = WRITEBACK;
+        writeback_packet.event_cycle = current_core_cycle[fill_cpu];
+
+        lower_level->functional_access(&writeback_packet);
+    }
+
+    // update prefetcher
+    if (cache_type == IS_L1D)
+        l1d_prefetcher_cache_fill(packet->full_addr, set, way, (packet->type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
+    else if (cache_type == IS_L2C)
+        l2c_prefetcher_cache_fill(packet->full_addr, set, way, (packet->type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
+
+    // update replacement policy
+    if (cache_type == IS_LLC) {
+#ifdef COMPRESSED_CACHE
+        if (is_compressed)
+            llc_update_replacement_state_cc(fill_cpu, set, way, evicted_cf, packet->full_addr, packet->ip, compressed_cache_block[set][way].full_addr[evicted_cf], packet->type, compression_factor, compressed_size, 0, 0, 0);
+        else
+#endif
+        llc_update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0, 0, 0);
+    }
+    else
+        update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+
+    if ((cache_type == IS_STLB) && (prefetcher_level_dcache != NULL))
+        prefetcher_level_dcache->inform_tlb_eviction(packet->data, block[set][way].data);
+
+    // COLLECT STATS
+    sim_miss[fill_cpu][packet->type]++;
+    sim_access[fill_cpu][packet->type]++;
+
+#ifdef COMPRESSED_CACHE
+    if (is_compressed)
+        fill_cache_cc(set, way, evicted_cf, packet);
+    else
+#endif
+    fill_cache(set, way, packet);
+
+    // RFOs and writebacks mark the line dirty
+    if (dirty) {
+        block[set][way].dirty = 1;
+#ifdef COMPRESSED_CACHE
+        if (is_compressed)
+            compressed_cache_block[set][way].dirty[evicted_cf] = 1;
+#endif
+    }
+}
+
 void CACHE::operate()
 {
     handle_fill();
@@ -983,9 +1271,18 @@ void CACHE::operate()
         handle_prefetch();
 }
 
+// every level is built from its macros, check them all at compile time
+static_assert(sizeof(CACHE_GEOMETRY<ITLB_SET, ITLB_WAY>), "ITLB");
+static_assert(sizeof(CACHE_GEOMETRY<DTLB_SET, DTLB_WAY>), "DTLB");
+static_assert(sizeof(CACHE_GEOMETRY<STLB_SET, STLB_WAY>), "STLB");
+static_assert(sizeof(CACHE_GEOMETRY<L1I_SET, L1I_WAY>), "L1I");
+static_assert(sizeof(CACHE_GEOMETRY<L1D_SET, L1D_WAY>), "L1D");
+static_assert(sizeof(CACHE_GEOMETRY<L2C_SET, L2C_WAY>), "L2C");
+static_assert(sizeof(CACHE_GEOMETRY<LLC_SET, LLC_WAY>), "LLC");
+
 uint32_t CACHE::get_set(uint64_t address)
 {
-    return (uint32_t) (address & ((1 << lg2(NUM_SET)) - 1));
+    return (uint32_t) (address & SET_MASK);
 }
 
 #ifdef COMPRESSED_CACHE
@@ -996,7 +1293,7 @@ uint32_t CACHE::get_set_cc(uint64_t address) {
     return this->get_set(address);
 #else
     // Drop last 2 bits because they are included in block ID.
-    return (uint32_t) ((address >> lg2(MAX_COMPRESSIBILITY)) & ((1 << lg2(NUM_SET)) - 1));
+    return (uint32_t) ((address >> const_lg2(MAX_COMPRESSIBILITY)) & SET_MASK);
 #endif
 }
 
@@ -1012,11 +1309,11 @@ uint64_t CACHE::get_sb_tag(uint64_t address) {
 #ifdef NO_SUPERBLOCK
     return 0;
 #else
-    return (address >> (lg2(MAX_COMPRESSIBILITY)+lg2(NUM_SET)));
+    return (address >> (const_lg2(MAX_COMPRESSIBILITY) + LOG2_SET));
 #endif
 }
 
-uint32_t CACHE::get_compressed_size(const char* data) {
+uint32_t CACHE::get_compressed_size(const char* data, uint8_t &compressor) {
     // TODO: Using ifdef is as awful as it ever was; this would optimally be a command line argument, but ChampSim is
     // unfortunately built around compiler flags instead of command line-args, so instead we get this wonderful thing.
     //
@@ -1028,19 +1325,55 @@ uint32_t CACHE::get_compressed_size(const char* data) {
 #endif
 
 
-#if defined(COMPRESSION_CPACK)
-    uint8_t dummy_buffer[68];
-    return std::min(64, cpack::compress((uint8_t*) data, dummy_buffer)) * multiplier;
+#if defined(COMPRESSION_HYBRID)
+    // BDI, FPC and CPACK all size the line while it sits in L1 and the smallest wins, ties going to the
+    // compressor with the faster decompression. Nothing beats BDI's one byte zero line.
+    const uint8_t *line = (const uint8_t*) data;
+    uint32_t size = bdi::BDICompressLine(data), fpc_size, cpack_size;
+    compressor = COMPRESSOR_BDI;
+    if (size > 1) {
+        if ((fpc_size = fpc::compressed_size(line)) < size) {
+            size = fpc_size;
+            compressor = COMPRESSOR_FPC;
+        }
+        if ((cpack_size = cpack::compressed_size(line)) < size) {
+            size = cpack_size;
+            compressor = COMPRESSOR_CPACK;
+        }
+    }
+    if (size >= 64) {
+        size = 64;
+        compressor = COMPRESSOR_NONE;
+    }
+    return size * multiplier;
+#elif defined(COMPRESSION_CPACK)
+    compressor = COMPRESSOR_CPACK;
+    return std::min(64, cpack::compressed_size((const uint8_t*) data)) * multiplier;
 #elif defined(COMPRESSION_FPC)
-    return bdi::GeneralCompress(data, 64, 2) * multiplier;
+    compressor = COMPRESSOR_FPC;
+    return std::min(64U, fpc::compressed_size((const uint8_t*) data)) * multiplier;
 #elif defined(COMPRESSION_NONE)
+    compressor = COMPRESSOR_NONE;
     return 64;
 #else
     // Default compression scheme is BDI.
+    compressor = COMPRESSOR_BDI;
     return bdi::GeneralCompress(data, 64, 1) * multiplier;
 #endif
 }
 
+void CACHE::print_compressor_stats() {
+    const char *name[NUM_COMPRESSORS] = { "None", "BDI", "CPACK", "FPC" };
+
+    uint64_t total_lines = 0;
+    for (uint32_t i=0; i<NUM_COMPRESSORS; i++)
+        total_lines += compressor_fill[i];
+
+    cout << NAME << " compressor wins (lines filled)" << endl;
+    for (uint32_t i=0; i<NUM_COMPRESSORS; i++)
+        printf("%s: %ld (%.2f%%)\n", name[i], compressor_fill[i], total_lines ? 100.0 * compressor_fill[i] / total_lines : 0.0);
+}
+
 uint64_t CACHE::get_compression_factor(uint32_t compressed_size) {
     uint64_t CF = 64 / std::max((uint32_t) 1, compressed_size);
 
@@ -1057,12 +1390,7 @@ uint64_t CACHE::get_compression_factor(uint32_t compressed_size) {
 
 uint32_t CACHE::get_way(uint64_t address, uint32_t set)
 {
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == address))
-            return way;
-    }
-
-    return NUM_WAY;
+    return find_way(set, address);
 }
 
 void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
@@ -1104,7 +1432,10 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
     block[set][way].address = packet->address;
     block[set][way].full_addr = packet->full_addr;
     block[set][way].data = packet->data;
-    memcpy(block[set][way].program_data, packet->program_data, CACHE_LINE_BYTES);
+    block_tag[(uint64_t) set*NUM_WAY + way] = packet->address;
+    memcpy(line_data(set, way), packet->program_data, CACHE_LINE_BYTES);
+    block[set][way].compressed_size = packet->compressed_size;
+    block[set][way].compressor = packet->compressor;
     block[set][way].cpu = packet->cpu;
     block[set][way].instr_id = packet->instr_id;
 
@@ -1127,19 +1458,16 @@ int CACHE::check_hit(PACKET *packet)
     }
 
     // hit
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == packet->address)) {
+    uint32_t way = find_way(set, packet->address);
+    if (way < NUM_WAY) {
 
-            match_way = way;
-
-            DP ( if (warmup_complete[packet->cpu]) {
-            cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
-            cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
-            cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl; });
+        match_way = way;
 
-            break;
-        }
+        DP ( if (warmup_complete[packet->cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
+        cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+        cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
+        cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl; });
     }
 
     return match_way;
@@ -1157,20 +1485,18 @@ int CACHE::invalidate_entry(uint64_t inval_addr)
     }
 
     // invalidate
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == inval_addr)) {
-
-            block[set][way].valid = 0;
+    uint32_t way = find_way(set, inval_addr);
+    if (way < NUM_WAY) {
 
-            match_way = way;
+        block[set][way].valid = 0;
+        block_tag[(uint64_t) set*NUM_WAY + way] = INVALID_TAG;
 
-            DP ( if (warmup_complete[cpu]) {
-            cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;
-            cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl; });
+        match_way = way;
 
-            break;
-        }
+        DP ( if (warmup_complete[cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;
+        cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+        cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl; });
     }
 
     return match_way;
@@ -1196,9 +1522,12 @@ void CACHE::fill_cache_cc(uint32_t set, uint32_t way, uint32_t cf, PACKET *packe
         pf_fill++;
 
     // Set the identifying information - tag, compression factor, and block ID.
-    uint32_t compressed_size = get_compressed_size(packet->program_data);
+    uint32_t compressed_size = get_compressed_size(packet);
     compressed_cache_block[set][way].sbTag = get_sb_tag(packet->address);
-    compressed_cache_block[set][way].compressed_size[cf] = get_compressed_size(packet->program_data);
+    cc_sb_tag[(uint64_t) set*NUM_WAY + way] = compressed_cache_block[set][way].sbTag;
+    compressed_cache_block[set][way].compressed_size[cf] = compressed_size;
+    compressed_cache_block[set][way].compressor[cf] = packet->compressor;
+    compressor_fill[packet->compressor]++;
     compressed_cache_block[set][way].compressionFactor = get_compression_factor(compressed_size);
     compressed_cache_block[set][way].blkId[cf] = get_blkid_cc(packet->address);
 
@@ -1235,9 +1564,10 @@ int CACHE::check_hit_cc(PACKET *packet) {
         assert(0);
     }
 
-    for(uint32_t way = 0; way < NUM_WAY; way++) {
-        // Skip any ways which don't have the same superblock tag.
-        if(compressed_cache_block[set][way].sbTag != get_sb_tag(packet->address)) continue;
+    // Only look at the ways holding lines of the same superblock.
+    uint64_t match = match_tags(&cc_sb_tag[(uint64_t) set*NUM_WAY], NUM_WAY, get_sb_tag(packet->address));
+    for(; match; match &= match - 1) {
+        uint32_t way = __builtin_ctzll(match);
 
         // Check if any of the block IDs in this way are valid + match the given block ID.
         for(uint32_t cf = 0; cf < compressed_cache_block[set][way].compressionFactor; cf++) {
@@ -1248,7 +1578,7 @@ int CACHE::check_hit_cc(PACKET *packet) {
     return -1;
 }
 
-uint8_t CACHE::evict_compressed_line(uint32_t set, uint32_t way, PACKET pkt, uint32_t& evicted_cf) {
+uint8_t CACHE::evict_compressed_line(uint32_t set, uint32_t way, PACKET *packet, uint32_t& evicted_cf) {
     assert(is_compressed);
     uint32_t num_dirty = 1;
     uint8_t do_fill = 1;
@@ -1288,7 +1618,7 @@ uint8_t CACHE::evict_compressed_line(uint32_t set, uint32_t way, PACKET pkt, uin
                     // lower level WQ is full, cannot replace this victim
                     do_fill = 0;
                     lower_level->increment_WQ_FULL(evicted_block_addr);
-                    STALL[pkt.type]++;
+                    STALL[packet->type]++;
 
                     DP ( if (warmup_complete[fill_cpu]) {
                             cout << "[" << NAME << "] " << __func__ << "do_fill: " << +do_fill;
@@ -1298,15 +1628,16 @@ uint8_t CACHE::evict_compressed_line(uint32_t set, uint32_t way, PACKET pkt, uin
                     PACKET writeback_packet;
 
                     writeback_packet.fill_level = fill_level << 1;
-                    writeback_packet.cpu = pkt.cpu;
+                    writeback_packet.cpu = packet->cpu;
                     writeback_packet.address = compressed_cache_block[set][way].address[index];
                     writeback_packet.full_addr = compressed_cache_block[set][way].full_addr[index];
                     writeback_packet.data = compressed_cache_block[set][way].data[index];
                     memcpy(writeback_packet.program_data, compressed_cache_block[set][way].program_data[index], CACHE_LINE_BYTES);
-                    writeback_packet.instr_id = pkt.instr_id;
+                    writeback_packet.compressed_size = compressed_cache_block[set][way].compressed_size[index];
+                    writeback_packet.instr_id = packet->instr_id;
                     writeback_packet.ip = 0; // writeback does not have ip
                     writeback_packet.type = WRITEBACK;
-                    writeback_packet.event_cycle = current_core_cycle[pkt.cpu];
+                    writeback_packet.event_cycle = current_core_cycle[packet->cpu];
 
                     invalidate_entry_cc(compressed_cache_block[set][way].address[index]);
                     lower_level->add_wq(&writeback_packet);
@@ -1338,9 +1669,10 @@ int CACHE::invalidate_entry_cc(uint64_t inval_addr) {
     }
 
     int evicted_way = -1, evicted_cf = -1;
-    for(uint32_t way = 0; way < NUM_WAY; way++) {
-        // Skip any ways which don't have the same superblock tag.
-        if(compressed_cache_block[set][way].sbTag != get_sb_tag(inval_addr)) continue;
+    // Only look at the ways holding lines of the same superblock.
+    uint64_t match = match_tags(&cc_sb_tag[(uint64_t) set*NUM_WAY], NUM_WAY, get_sb_tag(inval_addr));
+    for(; match; match &= match - 1) {
+        uint32_t way = __builtin_ctzll(match);
 
         // Check if any of the block IDs in this way are valid + match the given block ID.
         for(uint32_t cf = 0; cf < compressed_cache_block[set][way].compressionFactor; cf++) {
@@ -1367,7 +1699,10 @@ int CACHE::invalidate_entry_cc(uint64_t inval_addr) {
     }
 
     // Invalidate the entire line if no way is valid.
-    if(!any_valid) compressed_cache_block[set][evicted_way].compressionFactor = 0;
+    if(!any_valid) {
+        compressed_cache_block[set][evicted_way].compressionFactor = 0;
+        cc_sb_tag[(uint64_t) set*NUM_WAY + evicted_way] = INVALID_TAG;
+    }
 
     return evicted_way;
 }
@@ -1383,6 +1718,8 @@ int CACHE::add_rq(PACKET *packet)
         if (packet->fill_level < fill_level) {
             packet->data = WQ.entry[wq_index].data;
             memcpy(packet->program_data, WQ.entry[wq_index].program_data, CACHE_LINE_BYTES);
+            packet->compressed_size = WQ.entry[wq_index].compressed_size;
+            packet->compressor = WQ.entry[wq_index].compressor;
             if (packet->instruction)
                 upper_level_icache[packet->cpu]->return_data(packet);
             else // data
@@ -1400,7 +1737,7 @@ int CACHE::add_rq(PACKET *packet)
         // update processed packets
         if ((cache_type == IS_L1D) && (packet->type != PREFETCH)) {
             if (PROCESSED.occupancy < PROCESSED.SIZE)
-                PROCESSED.add_queue(packet);
+                PROCESSED.add_queue(packet, NULL);
 
             DP ( if (warmup_complete[packet->cpu]) {
             cout << "[" << NAME << "_RQ] " << __func__ << " instr_id: " << packet->instr_id << " found recent writebacks";
@@ -1423,7 +1760,7 @@ int CACHE::add_rq(PACKET *packet)
 
         if (packet->instruction) {
             uint32_t rob_index = packet->rob_index;
-            RQ.entry[index].rob_index_depend_on_me.insert (rob_index);
+            RQ.deps[index].rob_index_depend_on_me.insert (rob_index);
             RQ.entry[index].instr_merged = 1;
 
             DP (if (warmup_complete[packet->cpu]) {
@@ -1436,12 +1773,12 @@ int CACHE::add_rq(PACKET *packet)
             if (packet->type == RFO) {
 
                 uint32_t sq_index = packet->sq_index;
-                RQ.entry[index].sq_index_depend_on_me.insert (sq_index);
+                RQ.deps[index].sq_index_depend_on_me.insert (sq_index);
                 RQ.entry[index].store_merged = 1;
             }
             else {
                 uint32_t lq_index = packet->lq_index;
-                RQ.entry[index].lq_index_depend_on_me.insert (lq_index);
+                RQ.deps[index].lq_index_depend_on_me.insert (lq_index);
                 RQ.entry[index].load_merged = 1;
 
                 DP (if (warmup_complete[packet->cpu]) {
@@ -1476,6 +1813,7 @@ int CACHE::add_rq(PACKET *packet)
 #endif
 
     RQ.entry[index] = *packet;
+    RQ.index_entry(index);
 
     // ADD LATENCY
     if (RQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1529,6 +1867,7 @@ int CACHE::add_wq(PACKET *packet)
     }
 
     WQ.entry[index] = *packet;
+    WQ.index_entry(index);
 
     // ADD LATENCY
     if (WQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1631,6 +1970,8 @@ int CACHE::add_pq(PACKET *packet)
 
             packet->data = WQ.entry[wq_index].data;
             memcpy(packet->program_data, WQ.entry[wq_index].program_data, CACHE_LINE_BYTES);
+            packet->compressed_size = WQ.entry[wq_index].compressed_size;
+            packet->compressor = WQ.entry[wq_index].compressor;
             if (packet->instruction)
                 upper_level_icache[packet->cpu]->return_data(packet);
             else // data
@@ -1680,6 +2021,7 @@ int CACHE::add_pq(PACKET *packet)
 #endif
 
     PQ.entry[index] = *packet;
+    PQ.index_entry(index);
 
     // ADD LATENCY
     if (PQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1727,6 +2069,8 @@ void CACHE::return_data(PACKET *packet)
     MSHR.entry[mshr_index].returned = COMPLETED;
     MSHR.entry[mshr_index].data = packet->data;
     memcpy( MSHR.entry[mshr_index].program_data, packet->program_data, CACHE_LINE_BYTES);
+    MSHR.entry[mshr_index].compressed_size = packet->compressed_size;
+    MSHR.entry[mshr_index].compressor = packet->compressor;
     MSHR.entry[mshr_index].latency = (current_core_cycle[packet->cpu] - MSHR.entry[mshr_index].event_cycle);
     if(MSHR.read_occupancy != 0)
         MSHR.entry[mshr_index].effective_latency += (uint64_t) ((double)(current_core_cycle[packet->cpu] - MSHR.entry[mshr_index].last_update_cycle)/(double)(MSHR.read_occupancy));
@@ -1783,6 +2127,10 @@ void CACHE::update_fill_cycle()
 
 int CACHE::check_mshr(PACKET *packet)
 {
+    int index = MSHR.find_entry(packet);
+    if (index != -2)
+        return index;
+
     // search mshr
     for (uint32_t index=0; index<MSHR_SIZE; index++) {
         if (MSHR.entry[index].address == packet->address) {
@@ -1810,7 +2158,7 @@ int CACHE::check_mshr(PACKET *packet)
     return -1;
 }
 
-void CACHE::add_mshr(PACKET *packet)
+void CACHE::add_mshr(PACKET *packet, PACKET_DEPS *packet_deps)
 {
     uint32_t index = 0;
     bool is_demand = (packet->type == LOAD);
@@ -1820,6 +2168,8 @@ void CACHE::add_mshr(PACKET *packet)
         if (MSHR.entry[index].address == 0) {
 
             MSHR.entry[index] = *packet;
+            MSHR.deps[index] = *packet_deps;
+            MSHR.index_entry(index);
             MSHR.entry[index].returned = INFLIGHT;
             MSHR.entry[index].effective_latency = 0;
             MSHR.entry[index].last_update_cycle = current_core_cycle[packet->cpu];
@@ -0,0 +1,348 @@
+#include "checkpoint.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+#include <sstream>
+
+// registered globals, in no particular order since they come from static initializers
+static CHECKPOINT_GLOBAL_STATE *checkpoint_globals = NULL;
+
+CHECKPOINT_GLOBAL_STATE::CHECKPOINT_GLOBAL_STATE(const char *var_name, void *var_data, size_t var_size)
+{
+    name = var_name;
+    data = var_data;
+    size = var_size;
+    next = checkpoint_globals;
+    checkpoint_globals = this;
+}
+
+// a checkpoint only fits the configuration it was taken with
+struct CHECKPOINT_HEADER {
+    uint64_t magic;
+    uint32_t num_cpus, llc_set, llc_way, compressed, cloudsuite,
+             block_size, compressed_block_size;
+    uint64_t skip_instructions,
+             num_retired[NUM_CPUS],
+             cycle[NUM_CPUS];
+};
+
+static FILE *checkpoint_file;
+static const char *checkpoint_path;
+
+static void checkpoint_write(const void *data, size_t size)
+{
+    if (size && (fwrite(data, size, 1, checkpoint_file) != 1)) {
+        cerr << "[CHECKPOINT] cannot write " << checkpoint_path << endl;
+        assert(0);
+    }
+}
+
+static void checkpoint_read(void *data, size_t size)
+{
+    if (size && (fread(data, size, 1, checkpoint_file) != 1)) {
+        cerr << "[CHECKPOINT] " << checkpoint_path << " is truncated" << endl;
+        assert(0);
+    }
+}
+
+template <typename T> static void checkpoint_write_value(T value) { checkpoint_write(&value, sizeof(T)); }
+template <typename T> static T checkpoint_read_value() { T value; checkpoint_read(&value, sizeof(T)); return value; }
+
+static void checkpoint_write_map(FLAT_MAP &table)
+{
+    checkpoint_write_value<uint64_t>(table.size());
+    for (uint64_t i=0; i<table.capacity; i++) {
+        if (table.key[i] == FLAT_MAP_EMPTY)
+            continue;
+        checkpoint_write_value(table.key[i]);
+        checkpoint_write_value(table.value[i]);
+    }
+}
+
+static void checkpoint_read_map(FLAT_MAP &table)
+{
+    table.clear();
+    uint64_t size = checkpoint_read_value<uint64_t>();
+    for (uint64_t i=0; i<size; i++) {
+        uint64_t key = checkpoint_read_value<uint64_t>();
+        table.insert(key, checkpoint_read_value<uint64_t>());
+    }
+}
+
+template <typename T> static void checkpoint_write_vector(vector <T> &values)
+{
+    checkpoint_write_value<uint64_t>(values.size());
+    checkpoint_write(values.data(), values.size()*sizeof(T));
+}
+
+template <typename T> static void checkpoint_read_vector(vector <T> &values)
+{
+    values.resize(checkpoint_read_value<uint64_t>());
+    checkpoint_read(values.data(), values.size()*sizeof(T));
+}
+
+static void checkpoint_cache(CACHE *cache, uint8_t save)
+{
+    for (uint32_t i=0; i<cache->NUM_SET; i++) {
+        if (save)
+            checkpoint_write(cache->block[i], cache->NUM_WAY*sizeof(BLOCK));
+        else
+            checkpoint_read(cache->block[i], cache->NUM_WAY*sizeof(BLOCK));
+    }
+
+    uint64_t num_line = (uint64_t) cache->NUM_SET*cache->NUM_WAY;
+    if (save) {
+        checkpoint_write(cache->block_tag, num_line*sizeof(uint64_t));
+        checkpoint_write(cache->block_data, num_line*CACHE_LINE_BYTES);
+    } else {
+        checkpoint_read(cache->block_tag, num_line*sizeof(uint64_t));
+        checkpoint_read(cache->block_data, num_line*CACHE_LINE_BYTES);
+    }
+
+#ifdef COMPRESSED_CACHE
+    if (cache->is_compressed) {
+        for (uint32_t i=0; i<cache->NUM_SET; i++) {
+            if (save)
+                checkpoint_write(cache->compressed_cache_block[i], cache->NUM_WAY*sizeof(COMPRESSED_CACHE_BLOCK));
+            else
+                checkpoint_read(cache->compressed_cache_block[i], cache->NUM_WAY*sizeof(COMPRESSED_CACHE_BLOCK));
+        }
+
+        if (save)
+            checkpoint_write(cache->cc_sb_tag, num_line*sizeof(uint64_t));
+        else
+            checkpoint_read(cache->cc_sb_tag, num_line*sizeof(uint64_t));
+    }
+#endif
+}
+
+static void checkpoint_header(CHECKPOINT_HEADER *header)
+{
+    memset(header, 0, sizeof(CHECKPOINT_HEADER));
+    header->magic = CHECKPOINT_MAGIC;
+    header->num_cpus = NUM_CPUS;
+    header->llc_set = LLC_SET;
+    header->llc_way = LLC_WAY;
+    header->compressed = uncore.LLC.is_compressed;
+    header->cloudsuite = knob_cloudsuite;
+    header->block_size = sizeof(BLOCK);
+#ifdef COMPRESSED_CACHE
+    header->compressed_block_size = sizeof(COMPRESSED_CACHE_BLOCK);
+#endif
+}
+
+static void open_checkpoint(const char *path, CHECKPOINT_HEADER *header)
+{
+    checkpoint_path = path;
+    checkpoint_file = fopen(path, "rb");
+    if (checkpoint_file == NULL) {
+        cerr << "[CHECKPOINT] cannot open " << path << endl;
+        assert(0);
+    }
+
+    CHECKPOINT_HEADER expected;
+    checkpoint_header(&expected);
+    checkpoint_read(header, sizeof(CHECKPOINT_HEADER));
+
+    if ((header->magic != expected.magic) || (header->num_cpus != expected.num_cpus) || (header->llc_set != expected.llc_set)
+        || (header->llc_way != expected.llc_way) || (header->cloudsuite != expected.cloudsuite)
+        || (header->block_size != expected.block_size) || (header->compressed_block_size != expected.compressed_block_size)) {
+        cerr << "[CHECKPOINT] " << path << " was taken with a different configuration" << endl;
+        assert(0);
+    }
+}
+
+void save_checkpoint(const char *path)
+{
+    checkpoint_path = path;
+    checkpoint_file = fopen(path, "wb");
+    if (checkpoint_file == NULL) {
+        cerr << "[CHECKPOINT] cannot create " << path << endl;
+        assert(0);
+    }
+
+    CHECKPOINT_HEADER header;
+    checkpoint_header(&header);
+    header.skip_instructions = skip_instructions;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        header.num_retired[i] = ooo_cpu[i].num_retired;
+        header.cycle[i] = current_core_cycle[i];
+    }
+    checkpoint_write(&header, sizeof(CHECKPOINT_HEADER));
+
+    // TLBs and caches
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        checkpoint_cache(&ooo_cpu[i].ITLB, 1);
+        checkpoint_cache(&ooo_cpu[i].DTLB, 1);
+        checkpoint_cache(&ooo_cpu[i].STLB, 1);
+        checkpoint_cache(&ooo_cpu[i].L1I, 1);
+        checkpoint_cache(&ooo_cpu[i].L1D, 1);
+        checkpoint_cache(&ooo_cpu[i].L2C, 1);
+    }
+    checkpoint_cache(&uncore.LLC, 1);
+
+    // page table and page allocator
+    checkpoint_write_map(page_table);
+    checkpoint_write_map(inverse_table);
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        checkpoint_write_map(cl_footprint[i]);
+
+    checkpoint_write_vector(page_clock.vpage);
+    checkpoint_write_vector(page_clock.ppage);
+    checkpoint_write_vector(page_clock.cpu);
+    checkpoint_write_vector(page_clock.referenced);
+    checkpoint_write_value(page_clock.hand);
+    checkpoint_write_value(page_clock.swaps);
+    checkpoint_write_value(page_clock.scanned);
+    checkpoint_write_value(page_clock.second_chances);
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        checkpoint_write_vector(tlb_shootdown[i]);
+        checkpoint_write_vector(cache_shootdown[i]);
+    }
+
+    checkpoint_write_value(previous_ppage);
+    checkpoint_write_value(num_adjacent_page);
+    checkpoint_write_value(allocated_pages);
+    checkpoint_write(num_cl, sizeof(num_cl));
+    checkpoint_write(num_page, sizeof(num_page));
+    checkpoint_write(minor_fault, sizeof(minor_fault));
+    checkpoint_write(major_fault, sizeof(major_fault));
+
+    ostringstream engine;
+    engine << champsim_rand.engine;
+    checkpoint_write_value<uint64_t>(engine.str().size());
+    checkpoint_write(engine.str().data(), engine.str().size());
+
+    // DRAM open rows
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        for (uint32_t j=0; j<DRAM_RANKS; j++)
+            for (uint32_t k=0; k<DRAM_BANKS; k++)
+                checkpoint_write_value(uncore.DRAM.bank_request[i][j][k].open_row);
+
+    // registered globals
+    uint64_t num_globals = 0;
+    for (CHECKPOINT_GLOBAL_STATE *state = checkpoint_globals; state; state = state->next)
+        num_globals++;
+    checkpoint_write_value(num_globals);
+    for (CHECKPOINT_GLOBAL_STATE *state = checkpoint_globals; state; state = state->next) {
+        checkpoint_write_value<uint64_t>(strlen(state->name));
+        checkpoint_write(state->name, strlen(state->name));
+        checkpoint_write_value<uint64_t>(state->size);
+        checkpoint_write(state->data, state->size);
+    }
+
+    if (fclose(checkpoint_file) != 0) {
+        cerr << "[CHECKPOINT] cannot write " << path << endl;
+        assert(0);
+    }
+
+    cout << "Saved checkpoint " << path << " (" << num_globals << " registered globals)" << endl;
+}
+
+uint64_t checkpoint_trace_position(const char *path, uint32_t cpu)
+{
+    CHECKPOINT_HEADER header;
+    open_checkpoint(path, &header);
+    fclose(checkpoint_file);
+
+    return header.skip_instructions + header.num_retired[cpu];
+}
+
+void load_checkpoint(const char *path)
+{
+    CHECKPOINT_HEADER header;
+    open_checkpoint(path, &header);
+
+    if (header.compressed != (uint32_t)uncore.LLC.is_compressed) {
+        cerr << "[CHECKPOINT] " << path << " was taken with a different configuration" << endl;
+        assert(0);
+    }
+
+    skip_instructions = header.skip_instructions;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        // the core picks up at its first unretired instruction
+        ooo_cpu[i].num_retired = header.num_retired[i];
+        ooo_cpu[i].instr_unique_id = header.num_retired[i];
+        ooo_cpu[i].last_sim_instr = header.num_retired[i];
+        ooo_cpu[i].next_print_instruction = (header.num_retired[i] / STAT_PRINTING_PERIOD + 1) * STAT_PRINTING_PERIOD;
+
+        current_core_cycle[i] = header.cycle[i];
+        stall_cycle[i] = header.cycle[i];
+        ooo_cpu[i].last_sim_cycle = header.cycle[i];
+    }
+
+    // TLBs and caches
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        checkpoint_cache(&ooo_cpu[i].ITLB, 0);
+        checkpoint_cache(&ooo_cpu[i].DTLB, 0);
+        checkpoint_cache(&ooo_cpu[i].STLB, 0);
+        checkpoint_cache(&ooo_cpu[i].L1I, 0);
+        checkpoint_cache(&ooo_cpu[i].L1D, 0);
+        checkpoint_cache(&ooo_cpu[i].L2C, 0);
+    }
+    checkpoint_cache(&uncore.LLC, 0);
+
+    // page table and page allocator
+    checkpoint_read_map(page_table);
+    checkpoint_read_map(inverse_table);
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        checkpoint_read_map(cl_footprint[i]);
+
+    checkpoint_read_vector(page_clock.vpage);
+    checkpoint_read_vector(page_clock.ppage);
+    checkpoint_read_vector(page_clock.cpu);
+    checkpoint_read_vector(page_clock.referenced);
+    page_clock.hand = checkpoint_read_value<uint64_t>();
+    page_clock.swaps = checkpoint_read_value<uint64_t>();
+    page_clock.scanned = checkpoint_read_value<uint64_t>();
+    page_clock.second_chances = checkpoint_read_value<uint64_t>();
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        checkpoint_read_vector(tlb_shootdown[i]);
+        checkpoint_read_vector(cache_shootdown[i]);
+    }
+
+    previous_ppage = checkpoint_read_value<uint64_t>();
+    num_adjacent_page = checkpoint_read_value<uint64_t>();
+    allocated_pages = checkpoint_read_value<uint64_t>();
+    checkpoint_read(num_cl, sizeof(num_cl));
+    checkpoint_read(num_page, sizeof(num_page));
+    checkpoint_read(minor_fault, sizeof(minor_fault));
+    checkpoint_read(major_fault, sizeof(major_fault));
+
+    string engine(checkpoint_read_value<uint64_t>(), '\0');
+    checkpoint_read(&engine[0], engine.size());
+    istringstream engine_stream(engine);
+    engine_stream >> champsim_rand.engine;
+
+    // DRAM open rows
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        for (uint32_t j=0; j<DRAM_RANKS; j++)
+            for (uint32_t k=0; k<DRAM_BANKS; k++)
+                uncore.DRAM.bank_request[i][j][k].open_row = checkpoint_read_value<uint32_t>();
+
+    // registered globals, matched by name since the policies may differ from the run that saved them
+    uint64_t num_globals = checkpoint_read_value<uint64_t>(), num_loaded = 0;
+    for (uint64_t n=0; n<num_globals; n++) {
+        string name(checkpoint_read_value<uint64_t>(), '\0');
+        checkpoint_read(&name[0], name.size());
+        uint64_t size = checkpoint_read_value<uint64_t>();
+
+        CHECKPOINT_GLOBAL_STATE *state = checkpoint_globals;
+        while (state && (name != state->name))
+            state = state->next;
+
+        if (state && (state->size == size)) {
+            checkpoint_read(state->data, size);
+            num_loaded++;
+        }
+        else {
+            if (state)
+                cout << "[CHECKPOINT] " << name << " changed size, keeping its initial state" << endl;
+            fseek(checkpoint_file, size, SEEK_CUR);
+        }
+    }
+
+    fclose(checkpoint_file);
+
+    cout << "Loaded checkpoint " << path << " (" << num_loaded << " of " << num_globals << " saved globals)" << endl;
+}
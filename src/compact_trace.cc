@@ -0,0 +1,323 @@
+#include "compact_trace.h"
+
+#define COMPACT_DICTIONARY_SIZE (1u << COMPACT_TRACE_LOG2_DICTIONARY)
+#define COMPACT_LINE_TABLE_SIZE (1u << COMPACT_TRACE_LOG2_LINES)
+
+static inline void put_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static inline const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in == end)
+            return NULL;
+
+        uint8_t byte = *in++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return in;
+        }
+    }
+
+    return NULL;
+}
+
+static inline uint64_t zigzag(uint64_t current, uint64_t previous)
+{
+    int64_t delta = (int64_t)(current - previous);
+    return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t encoded, uint64_t previous)
+{
+    int64_t delta = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+    return previous + (uint64_t)delta;
+}
+
+static inline uint32_t varint_size(uint64_t value)
+{
+    uint32_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline uint64_t hash_line(const uint8_t *value)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < CACHE_LINE_BYTES; i += 8) {
+        uint64_t word;
+        memcpy(&word, value + i, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+COMPACT_TRACE::COMPACT_TRACE()
+{
+    dictionary = (uint8_t (*)[CACHE_LINE_BYTES])malloc(COMPACT_DICTIONARY_SIZE * CACHE_LINE_BYTES);
+    line_tag = (uint64_t *)malloc(COMPACT_LINE_TABLE_SIZE * sizeof(uint64_t));
+    line_value = (uint8_t (*)[CACHE_LINE_BYTES])malloc(COMPACT_LINE_TABLE_SIZE * CACHE_LINE_BYTES);
+    assert(dictionary && line_tag && line_value);
+
+    reset();
+}
+
+COMPACT_TRACE::~COMPACT_TRACE()
+{
+    free(dictionary);
+    free(line_tag);
+    free(line_value);
+}
+
+void COMPACT_TRACE::reset()
+{
+    last_ip = 0;
+    last_address = 0;
+
+    memset(dictionary, 0, COMPACT_DICTIONARY_SIZE * CACHE_LINE_BYTES);
+    dictionary_next = 0;
+    dictionary_index.clear();
+
+    // tag 0 marks an empty entry, tags are stored as line + 1
+    memset(line_tag, 0, COMPACT_LINE_TABLE_SIZE * sizeof(uint64_t));
+
+    num_instr = 0;
+    num_literal = 0;
+    num_delta = 0;
+    num_dictionary = 0;
+}
+
+uint32_t COMPACT_TRACE::line_index(uint64_t line)
+{
+    return (uint32_t)((line * 0x9E3779B97F4A7C15ULL) >> (64 - COMPACT_TRACE_LOG2_LINES));
+}
+
+void COMPACT_TRACE::insert_dictionary(const uint8_t *value)
+{
+    uint32_t slot = dictionary_next;
+    dictionary_next = (dictionary_next + 1) & (COMPACT_DICTIONARY_SIZE - 1);
+
+    // drop the index entry of the line we are about to overwrite (the index is empty when decoding)
+    if (!dictionary_index.empty()) {
+        auto evicted = dictionary_index.find(hash_line(dictionary[slot]));
+        if ((evicted != dictionary_index.end()) && (evicted->second == slot))
+            dictionary_index.erase(evicted);
+    }
+
+    memcpy(dictionary[slot], value, CACHE_LINE_BYTES);
+}
+
+void COMPACT_TRACE::encode_value(uint64_t address, const uint8_t *value, std::vector<uint8_t> &out)
+{
+    uint64_t line = address >> LOG2_BLOCK_SIZE;
+    uint32_t index = line_index(line);
+
+    // cost of a literal, not counting the tag
+    uint32_t best_cost = CACHE_LINE_BYTES, best_tag = COMPACT_VALUE_LITERAL;
+
+    uint64_t hash = hash_line(value);
+    auto found = dictionary_index.find(hash);
+    if ((found != dictionary_index.end()) && (memcmp(dictionary[found->second], value, CACHE_LINE_BYTES) == 0)) {
+        best_cost = 0;
+        best_tag = COMPACT_VALUE_DICTIONARY + found->second;
+    }
+
+    uint64_t mask = 0;
+    if (line_tag[index] == line + 1) {
+        uint32_t changed = 0;
+        for (int i = 0; i < CACHE_LINE_BYTES; i++) {
+            if (line_value[index][i] != value[i]) {
+                mask |= 1ULL << i;
+                changed++;
+            }
+        }
+
+        if (varint_size(best_tag) + best_cost > 1 + varint_size(mask) + changed) {
+            best_cost = varint_size(mask) + changed;
+            best_tag = COMPACT_VALUE_DELTA;
+        }
+    }
+
+    put_varint(out, best_tag);
+    if (best_tag == COMPACT_VALUE_LITERAL) {
+        out.insert(out.end(), value, value + CACHE_LINE_BYTES);
+        num_literal++;
+    }
+    else if (best_tag == COMPACT_VALUE_DELTA) {
+        put_varint(out, mask);
+        for (int i = 0; i < CACHE_LINE_BYTES; i++) {
+            if (mask & (1ULL << i))
+                out.push_back(value[i]);
+        }
+        num_delta++;
+    }
+    else
+        num_dictionary++;
+
+    // literal and delta values become dictionary entries, same as in decode_value()
+    if (best_tag < COMPACT_VALUE_DICTIONARY) {
+        uint32_t slot = dictionary_next;
+        insert_dictionary(value);
+        dictionary_index[hash] = slot;
+    }
+
+    line_tag[index] = line + 1;
+    memcpy(line_value[index], value, CACHE_LINE_BYTES);
+}
+
+const uint8_t *COMPACT_TRACE::decode_value(uint64_t address, const uint8_t *in, const uint8_t *end, uint8_t *value)
+{
+    uint64_t line = address >> LOG2_BLOCK_SIZE;
+    uint32_t index = line_index(line);
+
+    uint64_t tag;
+    in = get_varint(in, end, &tag);
+    if (in == NULL)
+        return NULL;
+
+    if (tag == COMPACT_VALUE_LITERAL) {
+        if (end - in < CACHE_LINE_BYTES)
+            return NULL;
+        memcpy(value, in, CACHE_LINE_BYTES);
+        in += CACHE_LINE_BYTES;
+    }
+    else if (tag == COMPACT_VALUE_DELTA) {
+        uint64_t mask;
+        in = get_varint(in, end, &mask);
+        if (in == NULL)
+            return NULL;
+
+        // a delta is only ever encoded against a line the encoder has seen
+        if (line_tag[index] != line + 1) {
+            cerr << "[COMPACT_TRACE] delta against unknown line: " << hex << address << dec << endl;
+            assert(0);
+        }
+
+        memcpy(value, line_value[index], CACHE_LINE_BYTES);
+        for (int i = 0; i < CACHE_LINE_BYTES; i++) {
+            if (mask & (1ULL << i)) {
+                if (in == end)
+                    return NULL;
+                value[i] = *in++;
+            }
+        }
+    }
+    else {
+        uint64_t slot = tag - COMPACT_VALUE_DICTIONARY;
+        assert(slot < COMPACT_DICTIONARY_SIZE);
+        memcpy(value, dictionary[slot], CACHE_LINE_BYTES);
+    }
+
+    if (tag < COMPACT_VALUE_DICTIONARY)
+        insert_dictionary(value);
+
+    line_tag[index] = line + 1;
+    memcpy(line_value[index], value, CACHE_LINE_BYTES);
+
+    return in;
+}
+
+#ifdef DATA_TRACE
+void COMPACT_TRACE::encode(const input_instr *instr, std::vector<uint8_t> &out)
+{
+    const uint64_t *memory[COMPACT_TRACE_OPERANDS];
+    const uint8_t *value[COMPACT_TRACE_OPERANDS];
+    for (int i = 0; i < NUM_INSTR_DESTINATIONS; i++) {
+        memory[i] = &instr->destination_memory[i];
+        value[i] = instr->destination_cache_line_value[i];
+    }
+    for (int i = 0; i < NUM_INSTR_SOURCES; i++) {
+        memory[NUM_INSTR_DESTINATIONS + i] = &instr->source_memory[i];
+        value[NUM_INSTR_DESTINATIONS + i] = instr->source_cache_line_value[i];
+    }
+
+    uint8_t flags = (instr->is_branch ? 1 : 0) | (instr->branch_taken ? 2 : 0);
+    for (int i = 0; i < COMPACT_TRACE_OPERANDS; i++) {
+        if (*memory[i])
+            flags |= 1 << (2 + i);
+    }
+    out.push_back(flags);
+
+    put_varint(out, zigzag(instr->ip, last_ip));
+    last_ip = instr->ip;
+
+    out.insert(out.end(), instr->destination_registers, instr->destination_registers + NUM_INSTR_DESTINATIONS);
+    out.insert(out.end(), instr->source_registers, instr->source_registers + NUM_INSTR_SOURCES);
+
+    for (int i = 0; i < COMPACT_TRACE_OPERANDS; i++) {
+        if (*memory[i] == 0)
+            continue;
+
+        put_varint(out, zigzag(*memory[i], last_address));
+        last_address = *memory[i];
+
+        encode_value(*memory[i], value[i], out);
+    }
+
+    num_instr++;
+}
+
+const uint8_t *COMPACT_TRACE::decode(const uint8_t *in, const uint8_t *end, input_instr *instr)
+{
+    uint64_t *memory[COMPACT_TRACE_OPERANDS];
+    uint8_t *value[COMPACT_TRACE_OPERANDS];
+    for (int i = 0; i < NUM_INSTR_DESTINATIONS; i++) {
+        memory[i] = &instr->destination_memory[i];
+        value[i] = instr->destination_cache_line_value[i];
+    }
+    for (int i = 0; i < NUM_INSTR_SOURCES; i++) {
+        memory[NUM_INSTR_DESTINATIONS + i] = &instr->source_memory[i];
+        value[NUM_INSTR_DESTINATIONS + i] = instr->source_cache_line_value[i];
+    }
+
+    if (end - in < 1 + 1 + NUM_INSTR_DESTINATIONS + NUM_INSTR_SOURCES)
+        return NULL;
+
+    uint8_t flags = *in++;
+    instr->is_branch = flags & 1;
+    instr->branch_taken = (flags >> 1) & 1;
+
+    uint64_t encoded;
+    in = get_varint(in, end, &encoded);
+    if ((in == NULL) || (end - in < NUM_INSTR_DESTINATIONS + NUM_INSTR_SOURCES))
+        return NULL;
+    instr->ip = last_ip = unzigzag(encoded, last_ip);
+
+    memcpy(instr->destination_registers, in, NUM_INSTR_DESTINATIONS);
+    in += NUM_INSTR_DESTINATIONS;
+    memcpy(instr->source_registers, in, NUM_INSTR_SOURCES);
+    in += NUM_INSTR_SOURCES;
+
+    for (int i = 0; i < COMPACT_TRACE_OPERANDS; i++) {
+        if ((flags & (1 << (2 + i))) == 0) {
+            *memory[i] = 0;
+            memset(value[i], 0, CACHE_LINE_BYTES);
+            continue;
+        }
+
+        in = get_varint(in, end, &encoded);
+        if (in == NULL)
+            return NULL;
+        *memory[i] = last_address = unzigzag(encoded, last_address);
+
+        in = decode_value(*memory[i], in, end, value[i]);
+        if (in == NULL)
+            return NULL;
+    }
+
+    num_instr++;
+    return in;
+}
+#endif
@@ -1,138 +1,216 @@
 #include "compression/cpack.h"
 #include <iostream>
 #include <cassert>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 using std::cout;
 using std::endl;
 
 namespace cpack {
 
-// returns size of compressed line in bytes
-int compress(const uint8_t input[64], uint8_t output[68]) {
-	int out_idx = 0;
-	uint8_t dict[64] = {0};
-	int dict_size = 0;
-
-	for(int i = 0; i < 16; i++) {
-		assert(out_idx < 544);
+// code lengths in bits: 2-bit or 4-bit prefix, 4-bit dictionary index, literal bytes
+#define CPACK_ZZZZ_BITS 2
+#define CPACK_ZZZX_BITS (4 + 8)
+#define CPACK_MMMM_BITS (2 + 4)
+#define CPACK_MMMX_BITS (4 + 4 + 8)
+#define CPACK_MMXX_BITS (4 + 4 + 16)
+#define CPACK_XXXX_BITS (2 + 32)
+
+#define CPACK_ZZZZ 0
+#define CPACK_ZZZX 1
+#define CPACK_MMMM 2
+#define CPACK_MMMX 3
+#define CPACK_MMXX 4
+#define CPACK_XXXX 5
+
+#if defined(__AVX2__)
+// one bit per 4-byte lane of the two halves of a line
+static inline uint32_t word_mask(__m256i lo, __m256i hi)
+{
+	return _mm256_movemask_ps(_mm256_castsi256_ps(lo)) | (_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8);
+}
+#endif
 
-		bool found = false;
+static const int code_bits[6] = { CPACK_ZZZZ_BITS, CPACK_ZZZX_BITS, CPACK_MMMM_BITS, CPACK_MMMX_BITS, CPACK_MMXX_BITS, CPACK_XXXX_BITS };
 
-		uint8_t a = input[4*i];
-		uint8_t b = input[4*i+1];
-		uint8_t c = input[4*i+2];
-		uint8_t d = input[4*i+3];
+// The dictionary only ever holds the first word with each value of its low two bytes (the
+// words a, b of a line are checked against it first), so word i matches the first earlier
+// word j that is not zzzx/zzzz and has the same low two bytes, and is xxxx when j is i.
+// classify() fills in the pattern of each word and its dictionary word, which is also its
+// index in the dictionary after counting the xxxx words before it.
+static void classify(const uint8_t input[64], int pattern[16], int match[16])
+{
+	uint32_t word[16];
+	memcpy(word, input, 64);
+
+	// one bit per word
+	uint32_t zzzz = 0, zzzx = 0;
+#if defined(__AVX2__)
+	__m256i lo = _mm256_loadu_si256((const __m256i*) input),
+	        hi = _mm256_loadu_si256((const __m256i*) (input + 32)),
+	        zero = _mm256_setzero_si256(),
+	        low3 = _mm256_set1_epi32(0xFFFFFF),
+	        low2 = _mm256_set1_epi32(0xFFFF),
+	        lo2 = _mm256_and_si256(lo, low2),
+	        hi2 = _mm256_and_si256(hi, low2);
+
+	zzzz = word_mask(_mm256_cmpeq_epi32(lo, zero), _mm256_cmpeq_epi32(hi, zero));
+	zzzx = word_mask(_mm256_cmpeq_epi32(_mm256_and_si256(lo, low3), zero), _mm256_cmpeq_epi32(_mm256_and_si256(hi, low3), zero));
+#else
+	for (int i = 0; i < 16; i++) {
+		zzzz |= (word[i] == 0) << i;
+		zzzx |= ((word[i] & 0xFFFFFF) == 0) << i;
+	}
+#endif
 
-		// check against zero patterns
-		if(a == 0 && b == 0 && c == 0) {
-			if (d == 0) { // pattern zzzz ouput (00)
-				set_bit(output, out_idx, 0, 0);
-			} else { // pattern zzzx output (1101)B
-				set_bit(output, out_idx, 1, 1, 0, 1);
-				set_byte(output, out_idx, d);
-			}
+	for (int i = 0; i < 16; i++) {
+		if (zzzx & (1 << i)) {
+			pattern[i] = (zzzz & (1 << i)) ? CPACK_ZZZZ : CPACK_ZZZX;
 			continue;
 		}
 
-		// check against dictionary
-		for(int j = 0; j < dict_size; j++) {	
-			if(a == dict[4*j] && b == dict[4*j+1]) {
-				if(c == dict[4*j+2]) {
-					if(d == dict[4*j+3]) { // pattern mmmm output (10) bbbb
-						set_bit(output, out_idx, 1, 0);
-						set_idx(output, out_idx, j);
-					} else { // pattern mmmx output (1110)bbbbB
-						set_bit(output, out_idx, 1, 1, 1, 0);
-						set_idx(output, out_idx, j);
-						set_byte(output, out_idx, d);
-					}
-				} else { // pattern mmxx output (1100)bbbbBB
-					set_bit(output, out_idx, 1, 1, 0, 0);
-					set_idx(output, out_idx, j);
-					set_byte(output, out_idx, c);
-					set_byte(output, out_idx, d);
-				}
-				found = true;
-				break;
-			}
-		}
+		// the words with the same low two bytes, word i included
+#if defined(__AVX2__)
+		__m256i key = _mm256_set1_epi32(word[i] & 0xFFFF);
+		uint32_t same = word_mask(_mm256_cmpeq_epi32(lo2, key), _mm256_cmpeq_epi32(hi2, key));
+#else
+		uint32_t same = 0;
+		for (int j = 0; j <= i; j++)
+			same |= (((word[j] ^ word[i]) & 0xFFFF) == 0) << j;
+#endif
+		match[i] = __builtin_ctz(same & ~zzzx);
+
+		uint32_t differ = word[i] ^ word[match[i]];
+		if (match[i] == i)
+			pattern[i] = CPACK_XXXX;
+		else if (differ == 0)
+			pattern[i] = CPACK_MMMM;
+		else if ((differ & 0xFFFFFF) == 0)
+			pattern[i] = CPACK_MMMX;
+		else
+			pattern[i] = CPACK_MMXX;
+	}
+}
 
-		if(found) {
-			continue;
-		}
+// returns size of compressed line in bytes, without encoding it
+int compressed_size(const uint8_t input[64]) {
+	int pattern[16], match[16], bits = 0;
+	classify(input, pattern, match);
 
-		// pattern xxxx output (01)BBBB
-		set_bit(output, out_idx, 0, 1);
-		set_byte(output, out_idx, a);
-		set_byte(output, out_idx, b);
-		set_byte(output, out_idx, c);
-		set_byte(output, out_idx, d);
+	for (int i = 0; i < 16; i++)
+		bits += code_bits[pattern[i]];
 
-		// add new pattern to dictionary
-		dict[4*dict_size] = a;
-		dict[4*dict_size+1] = b;
-		dict[4*dict_size+2] = c;
-		dict[4*dict_size+3] = d;
+	return (bits + 7) / 8;
+}
 
-		dict_size += 1;
+// the codes are written from bit 0 of output[0] up, and each code (prefix, index or byte)
+// from its most significant bit, like decompress() reads them
+class BIT_WRITER {
+  public:
+	uint8_t *output;
+	uint64_t buffer;
+	int buffered, written;
+
+	BIT_WRITER(uint8_t *out) : output(out), buffer(0), buffered(0), written(0) {}
+
+	// the first code bit is the most significant of value
+	void put(uint32_t value, int bits) {
+		buffer |= (uint64_t) reverse(value, bits) << buffered;
+		buffered += bits;
+		if (buffered >= 32) {
+			for (int i = 0; i < 4; i++)
+				output[written++] = buffer >> (8*i);
+			buffer >>= 32;
+			buffered -= 32;
+		}
 	}
 
-	return (out_idx % 8 == 0 ? out_idx / 8 : out_idx / 8 + 1);
-}
+	// returns the number of bits
+	int flush() {
+		int bits = 8*written + buffered;
+		for (; buffered > 0; buffered -= 8) {
+			output[written++] = buffer;
+			buffer >>= 8;
+		}
+		return bits;
+	}
 
-void set_bit(uint8_t* output, int& idx, bool a, bool b)
-{
-	set_bit(output, idx, a);
-	set_bit(output, idx, b);
-}
+  private:
+	static uint32_t reverse(uint32_t value, int bits) {
+		uint32_t reversed = 0;
+		for (int i = 0; i < bits; i += 8) {
+			reversed = (reversed << 8) | reverse_byte[value & 0xFF];
+			value >>= 8;
+		}
+		return reversed >> ((8 - bits % 8) % 8);
+	}
 
-void set_bit(uint8_t* output, int& idx, bool a, bool b, bool c, bool d)
-{
-	set_bit(output, idx, a);
-	set_bit(output, idx, b);
-	set_bit(output, idx, c);
-	set_bit(output, idx, d);
-}
+	static const uint8_t reverse_byte[256];
+};
 
+#define R2(n) n, n + 2*64, n + 1*64, n + 3*64
+#define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#define R6(n) R4(n), R4(n + 2*4), R4(n + 1*4), R4(n + 3*4)
+const uint8_t BIT_WRITER::reverse_byte[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R2
+#undef R4
+#undef R6
 
-void set_byte(uint8_t* output, int& idx, uint8_t byte)
-{
-	set_bit(output, idx, byte & 128);
-	set_bit(output, idx, byte & 64);
-	set_bit(output, idx, byte & 32);
-	set_bit(output, idx, byte & 16);
-	set_bit(output, idx, byte & 8);
-	set_bit(output, idx, byte & 4);
-	set_bit(output, idx, byte & 2);
-	set_bit(output, idx, byte & 1);
-}
+// returns size of compressed line in bytes
+int compress(const uint8_t input[64], uint8_t output[68]) {
+	int pattern[16], match[16], dict_index[16], dict_size = 0;
+	classify(input, pattern, match);
 
-void set_idx(uint8_t* output, int& out_idx, int idx)
-{
-	set_bit(output, out_idx, idx & 8);
-	set_bit(output, out_idx, idx & 4);
-	set_bit(output, out_idx, idx & 2);
-	set_bit(output, out_idx, idx & 1);
-}
+	BIT_WRITER writer(output);
+	for (int i = 0; i < 16; i++) {
+		const uint8_t *word = &input[4*i];
 
-void set_bit(uint8_t* output, int& idx, bool a)
-{
-	if(a == 0) {
-		output[idx/8] &= ~(1 << (idx%8));
-	} else {
-		output[idx/8] |= 1 << (idx%8);
+		switch (pattern[i]) {
+			case CPACK_ZZZZ: // (00)
+				writer.put(0x0, 2);
+				break;
+			case CPACK_ZZZX: // (1101)B
+				writer.put(0xD, 4);
+				writer.put(word[3], 8);
+				break;
+			case CPACK_MMMM: // (10)bbbb
+				writer.put(0x2, 2);
+				writer.put(dict_index[match[i]], 4);
+				break;
+			case CPACK_MMMX: // (1110)bbbbB
+				writer.put(0xE, 4);
+				writer.put(dict_index[match[i]], 4);
+				writer.put(word[3], 8);
+				break;
+			case CPACK_MMXX: // (1100)bbbbBB
+				writer.put(0xC, 4);
+				writer.put(dict_index[match[i]], 4);
+				writer.put(word[2], 8);
+				writer.put(word[3], 8);
+				break;
+			default: // (01)BBBB, and the word joins the dictionary
+				dict_index[i] = dict_size++;
+				writer.put(0x1, 2);
+				writer.put((word[0] << 24) | (word[1] << 16) | (word[2] << 8) | word[3], 32);
+				break;
+		}
 	}
 
-	idx++;
+	return (writer.flush() + 7) / 8;
 }
 
+// in_size is in bits, decoding stops after 16 words so the padding of the last byte is ignored.
 // returns 0. could be modified to return 1 on error.
 int decompress(const uint8_t input[68], uint8_t output[64], int in_size) {
 	uint8_t dict[64];
 	int dict_size = 0;
 	int out_idx = 0;
 
-	for(int i = 0; i < in_size; /**/) {
+	for(int i = 0; i < in_size && out_idx < 64; /**/) {
 		bool bit1 = read_bit(input, i);
 		bool bit2 = read_bit(input, i);
 
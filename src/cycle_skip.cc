@@ -0,0 +1,261 @@
+#include "cycle_skip.h"
+
+CYCLE_SKIP::CYCLE_SKIP()
+{
+    skipped_cycles = 0;
+
+    cheap_state = 0;
+    full_state = 0;
+    full_valid = 0;
+
+    full = 0;
+    hash = 0;
+    weight = 0;
+    cycle = 0;
+    next_event = UINT64_MAX;
+}
+
+void CYCLE_SKIP::operate()
+{
+    uint64_t state = scan(0);
+    if (state != cheap_state) {
+        cheap_state = state;
+        full_valid = 0;
+        return;
+    }
+
+    // the last two full passes bracket one whole iteration
+    state = scan(1);
+    if (full_valid && (state == full_state) && (next_event != UINT64_MAX) && (next_event > cycle + 1)) {
+        skipped_cycles += next_event - 1 - cycle;
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            current_core_cycle[i] = next_event - 1;
+    }
+
+    full_state = state;
+    full_valid = 1;
+}
+
+uint64_t CYCLE_SKIP::scan(uint8_t full_scan)
+{
+    full = full_scan;
+    hash = 0;
+    weight = 0x9E3779B97F4A7C15ULL;
+    cycle = current_core_cycle[0];
+    next_event = UINT64_MAX;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        scan_core(&ooo_cpu[i]);
+
+    scan_cache(&uncore.LLC);
+    scan_dram(&uncore.DRAM);
+
+    return hash;
+}
+
+void CYCLE_SKIP::scan_queue(PACKET_QUEUE *queue, uint8_t in_order)
+{
+    add(queue->occupancy);
+    if (full == 0)
+        return;
+
+    add_event(queue->next_fill_cycle);
+    add_event(queue->next_schedule_cycle);
+    add_event(queue->next_process_cycle);
+
+    // an entry that came and went during the iteration still moved the head
+    add(queue->head);
+    if (queue->occupancy == 0)
+        return;
+
+    add(queue->tail);
+    add(queue->num_returned);
+    add(queue->next_fill_index + ((uint64_t)queue->next_schedule_index << 21) + ((uint64_t)queue->next_process_index << 42));
+    add(queue->next_fill_cycle);
+    add(queue->next_schedule_cycle);
+    add(queue->next_process_cycle);
+    add(queue->ACCESS + queue->FORWARD + queue->MERGED + queue->TO_CACHE + queue->FULL);
+
+    // queues filled at the tail and drained from the head only need their occupied range walked
+    uint32_t first = in_order ? queue->head : 0,
+             count = in_order ? queue->occupancy : queue->SIZE;
+
+    for (uint32_t n=0, i=first; n<count; n++, i=(i+1 == queue->SIZE) ? 0 : i+1) {
+        PACKET *entry = &queue->entry[i];
+        if (entry->address == 0)
+            continue;
+
+        add(i);
+        add(entry->address);
+        add(entry->event_cycle);
+        add(entry->instr_id);
+        add(entry->cpu);
+        add(entry->fill_level);
+        add(entry->type | (entry->returned << 8) | (entry->scheduled << 16) | (entry->translated << 24));
+        add(entry->fetched | (entry->instr_merged << 8) | (entry->load_merged << 16) | (entry->store_merged << 24));
+        add_event(entry->event_cycle);
+    }
+}
+
+void CYCLE_SKIP::scan_cache(CACHE *cache)
+{
+    if (full == 0) {
+        add(cache->WQ.occupancy + ((uint64_t)cache->RQ.occupancy << 16) + ((uint64_t)cache->PQ.occupancy << 32) + ((uint64_t)cache->MSHR.occupancy << 48));
+        add(cache->PROCESSED.occupancy);
+        return;
+    }
+
+    scan_queue(&cache->WQ, 1);
+    scan_queue(&cache->RQ, 1);
+    scan_queue(&cache->PQ, 1);
+    scan_queue(&cache->MSHR, 0);
+    scan_queue(&cache->PROCESSED, 1);
+
+    // the counters only ever grow, so their sums are enough
+    uint64_t counters = cache->pf_requested + cache->pf_issued + cache->pf_useful + cache->pf_useless + cache->pf_fill;
+    for (uint32_t i=0; i<NUM_TYPES; i++)
+        counters += cache->ACCESS[i] + cache->HIT[i] + cache->MISS[i] + cache->MSHR_MERGED[i] + cache->STALL[i];
+    add(counters);
+}
+
+void CYCLE_SKIP::scan_core(O3_CPU *core)
+{
+    add(core->instr_unique_id);
+    add(core->num_retired);
+    add(core->completed_executions);
+    add(core->inflight_reg_executions);
+    add(core->inflight_mem_executions);
+    add(core->ROB.last_fetch);
+    add(core->ROB.next_schedule);
+    add(core->LQ.occupancy);
+    add(core->SQ.occupancy);
+
+    if (full)
+        scan_core_entries(core);
+
+    scan_cache(&core->ITLB);
+    scan_cache(&core->DTLB);
+    scan_cache(&core->STLB);
+    scan_cache(&core->L1I);
+    scan_cache(&core->L1D);
+    scan_cache(&core->L2C);
+}
+
+void CYCLE_SKIP::scan_core_entries(O3_CPU *core)
+{
+    add(core->next_ITLB_fetch);
+    add(core->fetch_stall);
+    add(core->num_branch);
+    add(core->branch_mispredictions);
+    add(stall_cycle[core->cpu]);
+    add_event(stall_cycle[core->cpu]);
+
+    add(core->ROB.head);
+    add(core->ROB.tail);
+    add(core->ROB.occupancy);
+    add(core->ROB.last_read);
+    add(core->ROB.last_scheduled);
+    add(core->ROB.next_fetch[0]);
+    add(core->ROB.next_fetch[1]);
+    add(core->LQ.head);
+    add(core->LQ.tail);
+    add(core->SQ.head);
+    add(core->SQ.tail);
+    add(core->STA_head);
+    add(core->STA_tail);
+    add(core->RTE0_head);
+    add(core->RTE0_tail);
+    add(core->RTE1_head);
+    add(core->RTE1_tail);
+    add(core->RTL0_head);
+    add(core->RTL0_tail);
+    add(core->RTL1_head);
+    add(core->RTL1_tail);
+    add(core->RTS0_head);
+    add(core->RTS0_tail);
+    add(core->RTS1_head);
+    add(core->RTS1_tail);
+
+    // retired entries are reset; the scheduler also looks at the slot after the last instruction
+    for (uint32_t n=0, i=core->ROB.head; n<=core->ROB.occupancy; n++, i=(i+1 == core->ROB.SIZE) ? 0 : i+1) {
+        ooo_model_instr *entry = &core->ROB.entry[i];
+        // new instructions only enter at the tail, so the flags and counters are enough here
+        add(entry->event_cycle);
+        add(entry->fetched | ((uint64_t)entry->scheduled << 8) | ((uint64_t)entry->executed << 16) | ((uint64_t)entry->translated << 24)
+            | ((uint64_t)entry->data_translated << 32) | ((uint64_t)entry->reg_ready << 40) | ((uint64_t)entry->mem_ready << 48));
+        add(entry->num_reg_ops | ((uint64_t)entry->num_mem_ops << 16) | ((uint64_t)entry->num_reg_dependent << 32));
+        add_event(entry->event_cycle);
+    }
+
+    // the deadlock check in the main loop
+    ooo_model_instr *head = &core->ROB.entry[core->ROB.head];
+    if (head->ip)
+        add_event(head->event_cycle + DEADLOCK_CYCLE);
+
+    for (uint32_t i=0; core->LQ.occupancy && (i<core->LQ.SIZE); i++) {
+        LSQ_ENTRY *entry = &core->LQ.entry[i];
+        add(entry->instr_id);
+        add(entry->event_cycle);
+        add(entry->producer_id);
+        add(entry->physical_address);
+        add(entry->translated | (entry->fetched << 8));
+        add_event(entry->event_cycle);
+    }
+
+    for (uint32_t i=0; core->SQ.occupancy && (i<core->SQ.SIZE); i++) {
+        LSQ_ENTRY *entry = &core->SQ.entry[i];
+        add(entry->instr_id);
+        add(entry->event_cycle);
+        add(entry->producer_id);
+        add(entry->physical_address);
+        add(entry->translated | (entry->fetched << 8));
+        add_event(entry->event_cycle);
+    }
+}
+
+void CYCLE_SKIP::scan_dram(MEMORY_CONTROLLER *dram)
+{
+    if (full) {
+        add(dram->processed_writes);
+        for (uint32_t i=0; i<NUM_TYPES+1; i++)
+            for (uint32_t j=0; j<NUM_TYPES+1; j++)
+                add(dram->dbus_congested[i][j]);
+    }
+
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        scan_queue(&dram->WQ[i], 0);
+        scan_queue(&dram->RQ[i], 0);
+        add(dram->dbus_cycle_available[i]);
+
+        if (full == 0)
+            continue;
+
+        add(dram->write_mode[i]);
+        add(dram->scheduled_reads[i]);
+        add(dram->scheduled_writes[i]);
+        add(dram->dbus_cycle_congested[i]);
+        add(dram->WQ[i].ROW_BUFFER_HIT + dram->WQ[i].ROW_BUFFER_MISS);
+        add(dram->RQ[i].ROW_BUFFER_HIT + dram->RQ[i].ROW_BUFFER_MISS);
+        add_event(dram->dbus_cycle_available[i]);
+
+        for (uint32_t j=0; j<DRAM_RANKS; j++) {
+            for (uint32_t k=0; k<DRAM_BANKS; k++) {
+                // banks only change when a request is scheduled on or leaves them, which moves scheduled_*
+                BANK_REQUEST *bank = &dram->bank_request[i][j][k];
+                if (bank->working == 0)
+                    continue;
+
+                add((j << 8) | k);
+                add(bank->cycle_available);
+                add(bank->open_row);
+                add(bank->request_index);
+                add(bank->working | (bank->working_type << 8) | (bank->is_read << 16) | (bank->is_write << 24));
+
+                add_event(bank->cycle_available);
+                // reset_remain_requests() compares against cycle_available - tCAS
+                if (bank->cycle_available > tCAS)
+                    add_event(bank->cycle_available - tCAS);
+            }
+        }
+    }
+}
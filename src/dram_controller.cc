@@ -434,6 +434,8 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
 
             packet->data = WQ[channel].entry[wq_index].data;
             memcpy(packet->program_data, WQ[channel].entry[wq_index].program_data, CACHE_LINE_BYTES);
+            packet->compressed_size = WQ[channel].entry[wq_index].compressed_size;
+            packet->compressor = WQ[channel].entry[wq_index].compressor;
             if (packet->instruction) 
                 upper_level_icache[packet->cpu]->return_data(packet);
             else // data
@@ -464,6 +466,7 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
         if (RQ[channel].entry[index].address == 0) {
             
             RQ[channel].entry[index] = *packet;
+            RQ[channel].index_entry(index);
             RQ[channel].occupancy++;
 
 #ifdef DEBUG_PRINT
@@ -506,6 +509,7 @@ int MEMORY_CONTROLLER::add_wq(PACKET *packet)
         if (WQ[channel].entry[index].address == 0) {
             
             WQ[channel].entry[index] = *packet;
+            WQ[channel].index_entry(index);
             WQ[channel].occupancy++;
 
 #ifdef DEBUG_PRINT
@@ -599,6 +603,10 @@ void MEMORY_CONTROLLER::update_process_cycle(PACKET_QUEUE *queue)
 
 int MEMORY_CONTROLLER::check_dram_queue(PACKET_QUEUE *queue, PACKET *packet)
 {
+    int found = queue->find_entry(packet);
+    if (found != -2)
+        return found;
+
     // search write queue
     for (uint32_t index=0; index<queue->SIZE; index++) {
         if (queue->entry[index].address == packet->address) {
@@ -0,0 +1,240 @@
+#include "interval_log.h"
+
+#include <zlib.h>
+
+static void put_varint(vector<uint8_t> &out, uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+        out.push_back(value | 0x80);
+    out.push_back(value);
+}
+
+// returns 0 past the end of the input
+static int get_varint(const uint8_t *&in, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; (in < end) && (shift < 64); shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return 1;
+    }
+    return 0;
+}
+
+static uint32_t log2_cf(uint8_t cf)
+{
+    uint32_t log2 = 0;
+    for (; (1U << log2) < cf; log2++);
+    return log2;
+}
+
+INTERVAL_LOG_WRITER::INTERVAL_LOG_WRITER()
+{
+    file = NULL;
+    offset = 0;
+}
+
+INTERVAL_LOG_WRITER::~INTERVAL_LOG_WRITER()
+{
+    if (file)
+        close();
+}
+
+int INTERVAL_LOG_WRITER::open(const char *path, uint32_t num_sets)
+{
+    file = fopen(path, "wb");
+    if (file == NULL)
+        return 0;
+
+    pending.assign(num_sets, vector<LOG_INTERVAL>());
+    blocks.assign(num_sets, vector<uint64_t>());
+    count.assign(num_sets, 0);
+
+    uint64_t magic = INTERVAL_LOG_MAGIC;
+    fwrite(&magic, sizeof(magic), 1, file);
+    fwrite(&num_sets, sizeof(num_sets), 1, file);
+    offset = sizeof(magic) + sizeof(num_sets);
+    return !ferror(file);
+}
+
+void INTERVAL_LOG_WRITER::add(uint32_t set, const LOG_INTERVAL &interval)
+{
+    pending[set].push_back(interval);
+    count[set]++;
+    if (pending[set].size() == INTERVAL_LOG_BLOCK)
+        flush(set);
+}
+
+void INTERVAL_LOG_WRITER::flush(uint32_t set)
+{
+    vector<LOG_INTERVAL> &interval = pending[set];
+    if (interval.empty())
+        return;
+
+    vector<uint8_t> raw;
+    uint32_t previous_end = 0;
+    for (uint32_t i=0; i<interval.size(); i++) {
+        put_varint(raw, interval[i].end - previous_end);
+        previous_end = interval[i].end;
+    }
+    for (uint32_t i=0; i<interval.size(); i++)
+        put_varint(raw, interval[i].end - interval[i].start);
+    uint64_t previous_superblock = 0;
+    for (uint32_t i=0; i<interval.size(); i++) {
+        int64_t delta = interval[i].superblock - previous_superblock;
+        put_varint(raw, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        previous_superblock = interval[i].superblock;
+    }
+    for (uint32_t i=0; i<interval.size(); i+=4) {
+        uint8_t packed = 0;
+        for (uint32_t j=0; (j<4) && (i+j<interval.size()); j++)
+            packed |= log2_cf(interval[i+j].cf) << (2*j);
+        raw.push_back(packed);
+    }
+
+    uLongf deflated_size = compressBound(raw.size());
+    vector<uint8_t> deflated(deflated_size);
+    compress2(deflated.data(), &deflated_size, raw.data(), raw.size(), Z_DEFAULT_COMPRESSION);
+
+    uint32_t header[4] = { set, (uint32_t)interval.size(), (uint32_t)raw.size(), (uint32_t)deflated_size };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(deflated.data(), 1, deflated_size, file);
+
+    blocks[set].push_back(offset);
+    offset += sizeof(header) + deflated_size;
+    interval.clear();
+}
+
+int INTERVAL_LOG_WRITER::close()
+{
+    if (file == NULL)
+        return 0;
+
+    for (uint32_t set=0; set<pending.size(); set++)
+        flush(set);
+
+    uint64_t index_offset = offset;
+    for (uint32_t set=0; set<pending.size(); set++) {
+        uint32_t num_blocks = blocks[set].size();
+        fwrite(&count[set], sizeof(uint64_t), 1, file);
+        fwrite(&num_blocks, sizeof(num_blocks), 1, file);
+        fwrite(blocks[set].data(), sizeof(uint64_t), num_blocks, file);
+    }
+
+    uint64_t magic = INTERVAL_LOG_MAGIC;
+    fwrite(&index_offset, sizeof(index_offset), 1, file);
+    fwrite(&magic, sizeof(magic), 1, file);
+
+    int result = !ferror(file);
+    fclose(file);
+    file = NULL;
+    return result;
+}
+
+INTERVAL_LOG_READER::INTERVAL_LOG_READER()
+{
+    file = NULL;
+    num_sets = 0;
+}
+
+INTERVAL_LOG_READER::~INTERVAL_LOG_READER()
+{
+    close();
+}
+
+void INTERVAL_LOG_READER::close()
+{
+    if (file)
+        fclose(file);
+    file = NULL;
+    num_sets = 0;
+    count.clear();
+    blocks.clear();
+}
+
+int INTERVAL_LOG_READER::open(const char *path)
+{
+    close();
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+
+    // a log that was never closed has no trailer
+    uint64_t magic = 0, trailer_magic = 0, index_offset = 0;
+    int ok = (fread(&magic, sizeof(magic), 1, file) == 1) && (magic == INTERVAL_LOG_MAGIC)
+          && (fread(&num_sets, sizeof(num_sets), 1, file) == 1)
+          && (fseek(file, -(long)(sizeof(index_offset) + sizeof(trailer_magic)), SEEK_END) == 0)
+          && (fread(&index_offset, sizeof(index_offset), 1, file) == 1)
+          && (fread(&trailer_magic, sizeof(trailer_magic), 1, file) == 1) && (trailer_magic == INTERVAL_LOG_MAGIC)
+          && (fseek(file, index_offset, SEEK_SET) == 0);
+
+    count.assign(ok ? num_sets : 0, 0);
+    blocks.assign(ok ? num_sets : 0, vector<uint64_t>());
+    for (uint32_t set=0; ok && (set<num_sets); set++) {
+        uint32_t num_blocks = 0;
+        ok = (fread(&count[set], sizeof(uint64_t), 1, file) == 1)
+          && (fread(&num_blocks, sizeof(num_blocks), 1, file) == 1);
+        if (ok) {
+            blocks[set].resize(num_blocks);
+            ok = (fread(blocks[set].data(), sizeof(uint64_t), num_blocks, file) == num_blocks);
+        }
+    }
+
+    if (!ok)
+        close();
+    return ok;
+}
+
+int INTERVAL_LOG_READER::read_set(uint32_t set, vector<LOG_INTERVAL> &interval)
+{
+    interval.clear();
+    if (set >= num_sets)
+        return 0;
+
+    vector<uint8_t> deflated, raw;
+    for (uint32_t b=0; b<blocks[set].size(); b++) {
+        uint32_t header[4];
+        if ((fseek(file, blocks[set][b], SEEK_SET) != 0) || (fread(header, sizeof(header), 1, file) != 1) || (header[0] != set))
+            return 0;
+
+        uint32_t num = header[1];
+        deflated.resize(header[3]);
+        raw.resize(header[2]);
+        uLongf raw_size = raw.size();
+        if ((fread(deflated.data(), 1, deflated.size(), file) != deflated.size())
+         || (uncompress(raw.data(), &raw_size, deflated.data(), deflated.size()) != Z_OK) || (raw_size != raw.size()))
+            return 0;
+
+        const uint8_t *in = raw.data(), *end = raw.data() + raw.size();
+        uint32_t first = interval.size();
+        interval.resize(first + num);
+
+        uint64_t value, previous = 0;
+        for (uint32_t i=0; i<num; i++) {
+            if (!get_varint(in, end, value))
+                return 0;
+            previous += value;
+            interval[first+i].end = previous;
+        }
+        for (uint32_t i=0; i<num; i++) {
+            if (!get_varint(in, end, value))
+                return 0;
+            interval[first+i].start = interval[first+i].end - value;
+        }
+        previous = 0;
+        for (uint32_t i=0; i<num; i++) {
+            if (!get_varint(in, end, value))
+                return 0;
+            previous += (value >> 1) ^ -(value & 1);
+            interval[first+i].superblock = previous;
+        }
+        if (end - in != (num + 3) / 4)
+            return 0;
+        for (uint32_t i=0; i<num; i++)
+            interval[first+i].cf = 1 << ((in[i/4] >> (2*(i%4))) & 3);
+    }
+
+    return 1;
+}
@@ -0,0 +1,433 @@
+#include "llc_mrc.h"
+#include "compression/bdi.h"
+
+#include <algorithm>
+#include <cmath>
+
+LLC_MRC llc_mrc;
+
+MRC_LIVENESS::MRC_LIVENESS(uint64_t w)
+{
+    window = w;
+    top.assign(2*window, 0);
+    add.assign(2*window, 0);
+}
+
+// every time is one leaf, a leaf in use again starts from zero
+void MRC_LIVENESS::clear(uint64_t time)
+{
+    uint64_t leaf = time % window, node = 1, low = 0, high = window - 1;
+    int32_t value = 0;
+    while (low != high) {
+        value += add[node];
+        uint64_t mid = (low + high) / 2;
+        if (leaf <= mid) {
+            node = 2*node;
+            high = mid;
+        } else {
+            node = 2*node + 1;
+            low = mid + 1;
+        }
+    }
+    value += top[node];
+    if (value)
+        update(1, 0, window - 1, leaf, leaf, -value);
+}
+
+// first and last are times at most window - 1 apart, so the range wraps around the ring at most once
+void MRC_LIVENESS::increment(uint64_t first, uint64_t last)
+{
+    uint64_t a = first % window, b = last % window;
+    if (a <= b)
+        update(1, 0, window - 1, a, b, 1);
+    else {
+        update(1, 0, window - 1, a, window - 1, 1);
+        update(1, 0, window - 1, 0, b, 1);
+    }
+}
+
+int32_t MRC_LIVENESS::max(uint64_t first, uint64_t last)
+{
+    uint64_t a = first % window, b = last % window;
+    if (a <= b)
+        return query(1, 0, window - 1, a, b);
+    return std::max(query(1, 0, window - 1, a, window - 1), query(1, 0, window - 1, 0, b));
+}
+
+void MRC_LIVENESS::update(uint64_t node, uint64_t low, uint64_t high, uint64_t first, uint64_t last, int32_t value)
+{
+    if ((first <= low) && (high <= last)) {
+        top[node] += value;
+        add[node] += value;
+        return;
+    }
+    uint64_t mid = (low + high) / 2;
+    if (first <= mid)
+        update(2*node, low, mid, first, last, value);
+    if (last > mid)
+        update(2*node + 1, mid + 1, high, first, last, value);
+    top[node] = std::max(top[2*node], top[2*node + 1]) + add[node];
+}
+
+int32_t MRC_LIVENESS::query(uint64_t node, uint64_t low, uint64_t high, uint64_t first, uint64_t last)
+{
+    if ((first <= low) && (high <= last))
+        return top[node];
+    uint64_t mid = (low + high) / 2;
+    int32_t result = INT32_MIN;
+    if (first <= mid)
+        result = query(2*node, low, mid, first, last);
+    if (last > mid)
+        result = std::max(result, query(2*node + 1, mid + 1, high, first, last));
+    return result + add[node];
+}
+
+// the ring has a power of two leaves, at least the window
+static uint64_t ring_size(uint64_t window)
+{
+    uint64_t size = 1;
+    while (size < window)
+        size <<= 1;
+    return size;
+}
+
+MRC_OPTGEN::MRC_OPTGEN(uint64_t c) : liveness(ring_size(LLC_MRC_OPT_WINDOW * c))
+{
+    capacity = c;
+    hits = 0;
+}
+
+void MRC_OPTGEN::reuse(uint64_t last, uint64_t now)
+{
+    // the line is live from its last access up to the one before this
+    if ((now - last >= liveness.window) || ((uint64_t)liveness.max(last, now - 1) >= capacity))
+        return;
+    liveness.increment(last, now - 1);
+    hits++;
+}
+
+void MRC_FENWICK::assign(uint64_t slots)
+{
+    tree.assign(slots, 0);
+    total = 0;
+}
+
+void MRC_FENWICK::build(const vector<uint64_t> &weight)
+{
+    for (uint64_t i=0; i<weight.size(); i++) {
+        tree[i] = weight[i];
+        total += weight[i];
+    }
+    // each node passes its sum up to its parent, also the empty ones holding their children's
+    for (uint64_t i=0; i<tree.size(); i++) {
+        uint64_t parent = (i+1) + ((i+1) & (~(i+1) + 1));
+        if (parent <= tree.size())
+            tree[parent-1] += tree[i];
+    }
+}
+
+void MRC_FENWICK::add(uint64_t slot, int64_t value)
+{
+    total += value;
+    for (uint64_t i=slot+1; i<=tree.size(); i+=i&(~i+1))
+        tree[i-1] += value;
+}
+
+uint64_t MRC_FENWICK::prefix(uint64_t slot)
+{
+    uint64_t sum = 0;
+    for (uint64_t i=slot; i>0; i-=i&(~i+1))
+        sum += tree[i-1];
+    return sum;
+}
+
+// SHARDS samples whole superblocks by a hash of their address
+static uint64_t hash_superblock(uint64_t superblock)
+{
+    superblock ^= superblock >> 33;
+    superblock *= 0xff51afd7ed558ccdULL;
+    superblock ^= superblock >> 33;
+    superblock *= 0xc4ceb9fe1a85ec53ULL;
+    superblock ^= superblock >> 33;
+    return superblock;
+}
+
+static uint64_t superblock_of(uint64_t address)
+{
+#ifdef NO_SUPERBLOCK
+    return address;
+#else
+    return address >> const_lg2(MAX_COMPRESSIBILITY);
+#endif
+}
+
+// the compression factor the compressed LLC gives a line of that size
+static uint8_t compression_factor(uint32_t size)
+{
+    uint32_t cf = BLOCK_SIZE / size;
+    for (uint32_t max_cf = MAX_COMPRESSIBILITY; max_cf > 1; max_cf >>= 1)
+        if (cf >= max_cf)
+            return max_cf;
+    return 1;
+}
+
+LLC_MRC::LLC_MRC()
+{
+    csv = NULL;
+    rate = 1;
+    threshold = UINT64_MAX;
+    next_slot = 0;
+    now = 0;
+    reset_stats();
+}
+
+LLC_MRC::~LLC_MRC()
+{
+    for (uint32_t i=0; i<opt.size(); i++)
+        delete opt[i];
+}
+
+void LLC_MRC::configure(const char *spec)
+{
+    path = spec;
+    size_t colon = path.rfind(':');
+    if (colon != string::npos) {
+        char *end;
+        double r = strtod(path.c_str() + colon + 1, &end);
+        if ((*end == '\0') && (end != path.c_str() + colon + 1)) {
+            if ((r <= 0) || (r > 1)) {
+                cerr << "[LLC_MRC] " << spec << ": the sampling rate must be in (0, 1]" << endl;
+                assert(0);
+            }
+            rate = r;
+            path = path.substr(0, colon);
+        }
+    }
+    threshold = (rate < 1) ? (uint64_t)(rate * 18446744073709551616.0) : UINT64_MAX;
+
+    // open it now rather than find out at the end of the run
+    csv = fopen(path.c_str(), "w");
+    if (csv == NULL) {
+        cerr << "[LLC_MRC] cannot create " << path << endl;
+        assert(0);
+    }
+
+    // half-octave steps around the LLC, a miniature of RATE times each
+    for (int step=2*LLC_MRC_MIN_OCTAVE; step<=2*LLC_MRC_MAX_OCTAVE; step++) {
+        uint64_t lines = llround(LLC_SET * LLC_WAY * pow(2.0, step / 2.0));
+        capacity.push_back(lines);
+        sampled_lines.push_back(lines * rate);
+        opt.push_back(new MRC_OPTGEN(max(1LL, llround(lines * rate))));
+    }
+    ideal_hits.assign(capacity.size(), 0);
+    yacc_hits.assign(capacity.size(), 0);
+
+    marks.assign(1 << 16);
+    ideal_bytes.assign(1 << 16);
+    yacc_bytes.assign(1 << 16);
+}
+
+// renumbers the lines by the order of their last access once every slot has been used
+void LLC_MRC::compact()
+{
+    vector<pair<uint64_t, MRC_LINE*>> order;
+    order.reserve(line.size());
+    for (auto it=line.begin(); it!=line.end(); it++)
+        order.push_back(make_pair(it->second.slot, &it->second));
+    sort(order.begin(), order.end());
+
+    vector<uint64_t> one(order.size(), 1), size(order.size()), yacc(order.size());
+    for (uint64_t i=0; i<order.size(); i++) {
+        order[i].second->slot = i;
+        size[i] = order[i].second->size;
+        yacc[i] = order[i].second->yacc;
+    }
+
+    uint64_t slots = max((uint64_t)1 << 16, 2*(uint64_t)order.size());
+    marks.assign(slots);
+    marks.build(one);
+    ideal_bytes.assign(slots);
+    ideal_bytes.build(size);
+    yacc_bytes.assign(slots);
+    yacc_bytes.build(yacc);
+    next_slot = order.size();
+}
+
+void LLC_MRC::move_to_top(MRC_LINE &l, uint8_t size, uint8_t cf)
+{
+    marks.add(l.slot, -1);
+    ideal_bytes.add(l.slot, -(int64_t)l.size);
+    yacc_bytes.add(l.slot, -(int64_t)l.yacc);
+
+    l.slot = next_slot++;
+    l.size = size;
+    l.cf = cf;
+    l.yacc = 0;
+    marks.add(l.slot, 1);
+    ideal_bytes.add(l.slot, size);
+}
+
+// weighs the lines of the address's superblock again in their order down the stack
+void LLC_MRC::regroup(uint64_t address)
+{
+#ifdef NO_SUPERBLOCK
+    // any lines with the same compression factor share a way
+    MRC_LINE &l = line[address];
+    uint8_t weight = BLOCK_SIZE / l.cf;
+    yacc_bytes.add(l.slot, (int64_t)weight - l.yacc);
+    l.yacc = weight;
+#else
+    MRC_LINE *mate[MAX_COMPRESSIBILITY];
+    uint32_t mates = 0, opened[MAX_COMPRESSIBILITY+1] = { 0 };
+    uint64_t first = superblock_of(address) << const_lg2(MAX_COMPRESSIBILITY);
+    for (uint32_t i=0; i<MAX_COMPRESSIBILITY; i++) {
+        auto found = line.find(first + i);
+        if (found == line.end())
+            continue;
+        // most recent first
+        uint32_t j = mates++;
+        for (; (j > 0) && (mate[j-1]->slot < found->second.slot); j--)
+            mate[j] = mate[j-1];
+        mate[j] = &found->second;
+    }
+
+    for (uint32_t i=0; i<mates; i++) {
+        uint8_t weight = (opened[mate[i]->cf]++ % mate[i]->cf) ? 0 : BLOCK_SIZE;
+        if (weight != mate[i]->yacc) {
+            yacc_bytes.add(mate[i]->slot, (int64_t)weight - mate[i]->yacc);
+            mate[i]->yacc = weight;
+        }
+    }
+#endif
+}
+
+// a reuse with that many bytes on top of it hits from the first point of the curve that holds them
+void LLC_MRC::count_hit(vector<uint64_t> &hits, uint64_t bytes)
+{
+    for (uint32_t i=0; i<sampled_lines.size(); i++) {
+        if (sampled_lines[i] * BLOCK_SIZE >= bytes) {
+            hits[i]++;
+            return;
+        }
+    }
+}
+
+void LLC_MRC::operate(CACHE *llc, PACKET *packet)
+{
+    // interval_dumper leaves writebacks out of the stream as well
+    if (packet->type == WRITEBACK)
+        return;
+
+    uint64_t address = packet->full_addr >> LOG2_BLOCK_SIZE;
+    accesses++;
+    if ((threshold != UINT64_MAX) && (hash_superblock(superblock_of(address)) >= threshold))
+        return;
+    sampled++;
+
+#ifdef COMPRESSED_CACHE
+    uint32_t size = llc->get_compressed_size(packet);
+#else
+    uint32_t size = bdi::GeneralCompress(packet->program_data, 64, 1);
+#endif
+    size = min(max(size, 1U), (uint32_t)BLOCK_SIZE);
+    uint8_t cf = compression_factor(size);
+
+    if (next_slot == marks.tree.size())
+        compact();
+    for (uint32_t i=0; i<opt.size(); i++)
+        opt[i]->advance(now);
+
+    auto found = line.find(address);
+    if (found == line.end()) {
+        MRC_LINE &l = line[address];
+        l.slot = next_slot++;
+        l.time = now;
+        l.size = size;
+        l.cf = cf;
+        l.yacc = 0;
+        marks.add(l.slot, 1);
+        ideal_bytes.add(l.slot, size);
+        cold++;
+    } else {
+        // distances in the stack as it was before this access
+        MRC_LINE &l = found->second;
+        uint64_t distance = line.size() - marks.prefix(l.slot);
+        if (distance >= lru_distance.size())
+            lru_distance.resize(2*distance, 0);
+        lru_distance[distance]++;
+        count_hit(ideal_hits, ideal_bytes.from(l.slot));
+        count_hit(yacc_hits, yacc_bytes.from(l.slot));
+
+        for (uint32_t i=0; i<opt.size(); i++)
+            opt[i]->reuse(l.time, now);
+        move_to_top(l, size, cf);
+        l.time = now;
+    }
+    regroup(address);
+    now++;
+}
+
+void LLC_MRC::reset_stats()
+{
+    accesses = 0;
+    sampled = 0;
+    cold = 0;
+    fill(lru_distance.begin(), lru_distance.end(), 0);
+    fill(ideal_hits.begin(), ideal_hits.end(), 0);
+    fill(yacc_hits.begin(), yacc_hits.end(), 0);
+    for (uint32_t i=0; i<opt.size(); i++)
+        opt[i]->hits = 0;
+}
+
+// the fewest sampled lines of uncompressed LRU with at least that many hits
+uint64_t LLC_MRC::lru_equivalent(double hits)
+{
+    double sum = 0;
+    for (uint64_t distance=1; distance<lru_distance.size(); distance++) {
+        sum += lru_distance[distance];
+        if (sum >= hits)
+            return distance;
+    }
+    return lru_distance.size();
+}
+
+void LLC_MRC::print()
+{
+    cout << endl << "LLC miss-ratio curve (fully associative, region of interest";
+    if (rate < 1)
+        cout << ", " << sampled << " of " << accesses << " accesses sampled";
+    cout << ")" << endl;
+    cout << "Compressed caches hold the same data bytes, x is the uncompressed LRU capacity they do as well as" << endl;
+    printf("%10s %12s %12s %12s %12s %12s %8s %8s\n", "size(KB)", "lines", "LRU miss(%)", "OPT miss(%)",
+           "ideal(%)", "YACC(%)", "ideal x", "YACC x");
+    fprintf(csv, "size_kb,lines,lru_miss_ratio,opt_miss_ratio,ideal_miss_ratio,yacc_miss_ratio,ideal_effective_capacity,yacc_effective_capacity\n");
+
+    // SHARDS-adj: the accesses the sample has more or fewer than expected are put down to the hottest lines
+    double expected = accesses * rate,
+           adjust = expected - sampled;
+
+    uint64_t lru_hits = 0, ideal = 0, yacc = 0, distance = 1;
+    for (uint32_t i=0; i<capacity.size(); i++) {
+        for (; (distance <= sampled_lines[i]) && (distance < lru_distance.size()); distance++)
+            lru_hits += lru_distance[distance];
+        ideal += ideal_hits[i];
+        yacc += yacc_hits[i];
+
+        double hits[4] = { (double)lru_hits, (double)opt[i]->hits, (double)ideal, (double)yacc }, miss[4];
+        for (uint32_t j=0; j<4; j++)
+            miss[j] = expected ? min(1.0, max(0.0, 1 - (hits[j] + adjust) / expected)) : 0;
+        // past the working set every cache does as well as one of its size
+        double ideal_x = max(1.0, lru_equivalent(ideal) / (capacity[i] * rate)),
+               yacc_x = max(1.0, lru_equivalent(yacc) / (capacity[i] * rate));
+
+        printf("%10lu %12lu %12.3f %12.3f %12.3f %12.3f %8.2f %8.2f%s\n", capacity[i] * BLOCK_SIZE / 1024, capacity[i],
+               100*miss[0], 100*miss[1], 100*miss[2], 100*miss[3], ideal_x, yacc_x,
+               (capacity[i] == (uint64_t)LLC_SET * LLC_WAY) ? "  <- LLC" : "");
+        fprintf(csv, "%lu,%lu,%.6f,%.6f,%.6f,%.6f,%.4f,%.4f\n", capacity[i] * BLOCK_SIZE / 1024, capacity[i],
+                miss[0], miss[1], miss[2], miss[3], ideal_x, yacc_x);
+    }
+
+    fclose(csv);
+    csv = NULL;
+    cout << "Miss-ratio curve: " << path << endl;
+}
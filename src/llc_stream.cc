@@ -0,0 +1,231 @@
+#include "llc_stream.h"
+
+LLC_STREAM llc_capture;
+
+struct LLC_STREAM_HEADER {
+    uint64_t magic;
+    uint32_t num_cpus, line_bytes;
+};
+
+LLC_STREAM::LLC_STREAM()
+{
+    file = NULL;
+    writing = 0;
+    records = 0;
+
+    line_addr = NULL;
+    line_data = NULL;
+    reset();
+}
+
+LLC_STREAM::~LLC_STREAM()
+{
+    close();
+}
+
+void LLC_STREAM::reset()
+{
+    last_cycle = 0;
+    last_addr = 0;
+    last_ip = 0;
+    records = 0;
+
+    if (line_addr) {
+        for (uint32_t i=0; i<LLC_STREAM_LINES; i++)
+            line_addr[i] = UINT64_MAX;
+    }
+}
+
+int LLC_STREAM::open_write(const char *path)
+{
+    const char *last_dot = strrchr(path, '.');
+    file = gzopen(path, (last_dot && (strcmp(last_dot, ".gz") == 0)) ? "wb1" : "wbT");
+    if (file == NULL)
+        return 0;
+    writing = 1;
+
+    line_addr = new uint64_t[LLC_STREAM_LINES];
+    line_data = new char[LLC_STREAM_LINES][CACHE_LINE_BYTES];
+    reset();
+
+    LLC_STREAM_HEADER header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LLC_STREAM_MAGIC;
+    header.num_cpus = NUM_CPUS;
+    header.line_bytes = CACHE_LINE_BYTES;
+    gzwrite(file, &header, sizeof(header));
+
+    return 1;
+}
+
+int LLC_STREAM::open_read(const char *path)
+{
+    file = gzopen(path, "rb");
+    if (file == NULL)
+        return 0;
+    writing = 0;
+    gzbuffer(file, 1 << 20);
+
+    line_addr = new uint64_t[LLC_STREAM_LINES];
+    line_data = new char[LLC_STREAM_LINES][CACHE_LINE_BYTES];
+    reset();
+
+    LLC_STREAM_HEADER header;
+    if ((gzread(file, &header, sizeof(header)) != sizeof(header)) || (header.magic != LLC_STREAM_MAGIC)) {
+        cerr << "[LLC_STREAM] " << path << " is not an LLC access stream" << endl;
+        assert(0);
+    }
+    if ((header.num_cpus > NUM_CPUS) || (header.line_bytes != CACHE_LINE_BYTES)) {
+        cerr << "[LLC_STREAM] " << path << " was captured with " << header.num_cpus << " cores and " << header.line_bytes << "B lines" << endl;
+        assert(0);
+    }
+
+    return 1;
+}
+
+void LLC_STREAM::close()
+{
+    if (file)
+        gzclose(file);
+    file = NULL;
+
+    delete[] line_addr;
+    delete[] line_data;
+    line_addr = NULL;
+    line_data = NULL;
+}
+
+void LLC_STREAM::put_varint(uint8_t *&out, uint64_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+}
+
+uint64_t LLC_STREAM::get_varint()
+{
+    uint64_t value = 0;
+    for (uint32_t shift=0; shift<64; shift+=7) {
+        int c = gzgetc(file);
+        if (c == -1) {
+            cerr << "[LLC_STREAM] stream is truncated" << endl;
+            assert(0);
+        }
+        value |= (uint64_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+            break;
+    }
+
+    return value;
+}
+
+// zigzag keeps small negative deltas small
+static uint64_t zigzag(uint64_t delta) { return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63); }
+static uint64_t unzigzag(uint64_t value) { return (value >> 1) ^ (0 - (value & 1)); }
+
+void LLC_STREAM::record_access(CACHE *llc, PACKET *packet)
+{
+    uint8_t buffer[3 + 3*10 + CACHE_LINE_BYTES], *out = buffer;
+    uint32_t cpu = packet->cpu;
+
+    uint32_t compressed_size = CACHE_LINE_BYTES;
+#ifdef COMPRESSED_CACHE
+    if (llc->is_compressed)
+        compressed_size = llc->get_compressed_size(packet);
+#endif
+
+    // zero lines are common, and reads of a line mostly see the data it had last time
+    uint8_t data_mode = LLC_STREAM_DATA_LINE;
+    uint64_t address = packet->full_addr >> LOG2_BLOCK_SIZE;
+    uint32_t slot = address & (LLC_STREAM_LINES - 1);
+    if ((line_addr[slot] == address) && (memcmp(line_data[slot], packet->program_data, CACHE_LINE_BYTES) == 0))
+        data_mode = LLC_STREAM_DATA_SAME;
+    else {
+        data_mode = LLC_STREAM_DATA_ZERO;
+        for (uint32_t i=0; i<CACHE_LINE_BYTES; i++) {
+            if (packet->program_data[i]) {
+                data_mode = LLC_STREAM_DATA_LINE;
+                break;
+            }
+        }
+        line_addr[slot] = address;
+        memcpy(line_data[slot], packet->program_data, CACHE_LINE_BYTES);
+    }
+
+    uint8_t fill = (packet->type != PREFETCH) || (packet->fill_level <= llc->fill_level);
+    *out++ = packet->type | (fill << 2) | (data_mode << 3);
+    *out++ = cpu;
+    *out++ = compressed_size;
+
+    put_varint(out, zigzag(current_core_cycle[cpu] - last_cycle));
+    put_varint(out, zigzag(packet->full_addr - last_addr));
+    put_varint(out, zigzag(packet->ip - last_ip));
+    last_cycle = current_core_cycle[cpu];
+    last_addr = packet->full_addr;
+    last_ip = packet->ip;
+
+    if (data_mode == LLC_STREAM_DATA_LINE) {
+        memcpy(out, packet->program_data, CACHE_LINE_BYTES);
+        out += CACHE_LINE_BYTES;
+    }
+
+    gzwrite(file, buffer, out - buffer);
+    records++;
+}
+
+void LLC_STREAM::record_mark(uint8_t mark, uint32_t cpu)
+{
+    uint8_t buffer[3] = { mark, (uint8_t)cpu, 0 };
+    gzwrite(file, buffer, sizeof(buffer));
+}
+
+int LLC_STREAM::read(LLC_STREAM_RECORD *record)
+{
+    uint8_t head[3];
+    int n = gzread(file, head, sizeof(head));
+    if (n == 0)
+        return 0;
+    if (n != sizeof(head)) {
+        cerr << "[LLC_STREAM] stream is truncated" << endl;
+        assert(0);
+    }
+
+    record->cpu = head[1];
+    if (head[0] >= LLC_STREAM_MARK_WARMUP) {
+        record->mark = head[0];
+        return 1;
+    }
+
+    record->mark = 0;
+    record->type = head[0] & 3;
+    record->fill = (head[0] >> 2) & 1;
+    record->compressed_size = head[2];
+
+    last_cycle += unzigzag(get_varint());
+    last_addr += unzigzag(get_varint());
+    last_ip += unzigzag(get_varint());
+    record->cycle = last_cycle;
+    record->full_addr = last_addr;
+    record->ip = last_ip;
+
+    uint8_t data_mode = (head[0] >> 3) & 3;
+    uint64_t address = record->full_addr >> LOG2_BLOCK_SIZE;
+    uint32_t slot = address & (LLC_STREAM_LINES - 1);
+    if (data_mode == LLC_STREAM_DATA_SAME)
+        memcpy(record->data, line_data[slot], CACHE_LINE_BYTES);
+    else {
+        if (data_mode == LLC_STREAM_DATA_ZERO)
+            memset(record->data, 0, CACHE_LINE_BYTES);
+        else if (gzread(file, record->data, CACHE_LINE_BYTES) != CACHE_LINE_BYTES) {
+            cerr << "[LLC_STREAM] stream is truncated" << endl;
+            assert(0);
+        }
+        line_addr[slot] = address;
+        memcpy(line_data[slot], record->data, CACHE_LINE_BYTES);
+    }
+
+    records++;
+    return 1;
+}
@@ -0,0 +1,330 @@
+#include "llc_sweep.h"
+#include "compression/bdi.h"
+#include "compression/cpack.h"
+#include "compression/fpc.h"
+
+LLC_SWEEP llc_sweep;
+
+SHADOW_LLC::SHADOW_LLC(string spec)
+{
+    name = spec;
+    policy = SHADOW_LRU;
+#ifdef COMPRESSED_CACHE
+    compressed = 1;
+#else
+    compressed = 0;
+#endif
+    compression = SHADOW_BUILD_COMPRESSION;
+
+    size_t colon = spec.find(':');
+    string geometry = spec.substr(0, colon);
+    if (sscanf(geometry.c_str(), "%ux%u", &num_set, &num_way) != 2) {
+        cerr << "[LLC_SWEEP] " << spec << ": expected SETSxWAYS" << endl;
+        assert(0);
+    }
+    if ((num_set == 0) || (num_set & (num_set - 1)) || (num_way == 0)) {
+        cerr << "[LLC_SWEEP] " << spec << ": the number of sets must be a power of two" << endl;
+        assert(0);
+    }
+    log2_set = lg2(num_set);
+
+    while (colon != string::npos) {
+        size_t next = spec.find(':', colon + 1);
+        string option = spec.substr(colon + 1, (next == string::npos) ? string::npos : next - colon - 1);
+        colon = next;
+
+        if (option == "lru")
+            policy = SHADOW_LRU;
+        else if (option == "srrip")
+            policy = SHADOW_SRRIP;
+        else if (option == "c")
+            compressed = 1;
+        else if (option == "u")
+            compressed = 0;
+        else if (option == "bdi")
+            compression = SHADOW_BDI;
+        else if (option == "cpack")
+            compression = SHADOW_CPACK;
+        else if (option == "fpc")
+            compression = SHADOW_FPC;
+        else if (option == "none")
+            compression = SHADOW_NO_COMPRESSION;
+        else {
+            cerr << "[LLC_SWEEP] " << spec << ": unknown option " << option << endl;
+            assert(0);
+        }
+    }
+
+#ifndef COMPRESSED_CACHE
+    // the build has no compressor of its own to fall back on
+    if (compressed && (compression == SHADOW_BUILD_COMPRESSION))
+        compression = SHADOW_BDI;
+#endif
+
+    way_state = new SHADOW_WAY[num_set*num_way];
+    for (uint32_t i=0; i<num_set; i++) {
+        for (uint32_t j=0; j<num_way; j++) {
+            SHADOW_WAY *way = &way_state[i*num_way + j];
+            memset(way, 0, sizeof(SHADOW_WAY));
+            way->lru = j;
+            way->rrpv = SHADOW_MAX_RRPV;
+        }
+    }
+
+    lines_stored = 0;
+    reset_stats();
+}
+
+SHADOW_LLC::~SHADOW_LLC()
+{
+    delete[] way_state;
+}
+
+void SHADOW_LLC::reset_stats()
+{
+    for (uint32_t i=0; i<NUM_TYPES; i++) {
+        access[i] = 0;
+        hit[i] = 0;
+        miss[i] = 0;
+    }
+    for (uint32_t i=0; i<MAX_COMPRESSIBILITY; i++)
+        cf_count[i] = 0;
+    lines_stored_over_time = 0;
+    updates = 0;
+}
+
+void SHADOW_LLC::operate(uint64_t address, uint32_t type, uint8_t fill, uint32_t compressed_size)
+{
+    // the same superblock layout as get_set_cc/get_sb_tag/get_blkid_cc
+    uint32_t sb_bits = 0, cf = 1;
+    uint64_t blk_id = 0;
+    if (compressed) {
+        cf = 64 / ((compressed_size > 1) ? compressed_size : 1);
+        for (uint32_t max_cf = MAX_COMPRESSIBILITY; max_cf; max_cf >>= 1) {
+            if (cf >= max_cf) {
+                cf = max_cf;
+                break;
+            }
+        }
+#ifndef NO_SUPERBLOCK
+        sb_bits = lg2(MAX_COMPRESSIBILITY);
+        blk_id = address & (MAX_COMPRESSIBILITY - 1);
+#else
+        blk_id = address;
+#endif
+    }
+
+    uint32_t set_index = (address >> sb_bits) & (num_set - 1);
+    uint64_t sb_tag = address >> (sb_bits + log2_set);
+#ifdef NO_SUPERBLOCK
+    if (compressed)
+        sb_tag = 0;
+#endif
+    SHADOW_WAY *set = &way_state[set_index*num_way];
+
+    access[type]++;
+
+    int way = find_hit(set, sb_tag, blk_id);
+
+    // a writeback that changes the compression factor is refilled
+    if ((way >= 0) && (type == WRITEBACK) && (set[way].cf != cf)) {
+        for (uint32_t i=0; i<set[way].cf; i++) {
+            if (set[way].valid[i] && (set[way].blk_id[i] == blk_id)) {
+                set[way].valid[i] = 0;
+                lines_stored--;
+            }
+        }
+        way = -1;
+    }
+
+    if (way >= 0) {
+        hit[type]++;
+        update(set, way, type, 1, set[way].cf);
+        return;
+    }
+
+    miss[type]++;
+    if (fill == 0)
+        return;
+
+    uint32_t slot;
+    way = find_victim(set, sb_tag, cf, slot);
+    if (slot == MAX_COMPRESSIBILITY) {
+        evict(&set[way]);
+        set[way].sb_tag = sb_tag;
+        set[way].cf = cf;
+        slot = 0;
+    }
+    set[way].valid[slot] = 1;
+    set[way].blk_id[slot] = blk_id;
+    lines_stored++;
+
+    update(set, way, type, 0, cf);
+}
+
+int SHADOW_LLC::find_hit(SHADOW_WAY *set, uint64_t sb_tag, uint64_t blk_id)
+{
+    for (uint32_t way=0; way<num_way; way++) {
+        if (set[way].sb_tag != sb_tag)
+            continue;
+
+        for (uint32_t i=0; i<set[way].cf; i++)
+            if (set[way].valid[i] && (set[way].blk_id[i] == blk_id))
+                return way;
+    }
+
+    return -1;
+}
+
+// slot is MAX_COMPRESSIBILITY when the whole way is (re)allocated
+uint32_t SHADOW_LLC::find_victim(SHADOW_WAY *set, uint64_t sb_tag, uint32_t cf, uint32_t &slot)
+{
+    // a free slot next to lines of the same superblock and compression factor
+    for (uint32_t way=0; way<num_way; way++) {
+        if ((set[way].cf != cf) || (set[way].sb_tag != sb_tag))
+            continue;
+
+        for (uint32_t i=0; i<cf; i++) {
+            if (set[way].valid[i] == 0) {
+                slot = i;
+                return way;
+            }
+        }
+    }
+
+    slot = MAX_COMPRESSIBILITY;
+
+    // an invalid way
+    for (uint32_t way=0; way<num_way; way++)
+        if (set[way].cf == 0)
+            return way;
+
+    if (policy == SHADOW_SRRIP) {
+        while (1) {
+            for (uint32_t way=0; way<num_way; way++)
+                if (set[way].rrpv == SHADOW_MAX_RRPV)
+                    return way;
+
+            for (uint32_t way=0; way<num_way; way++)
+                set[way].rrpv++;
+        }
+    }
+
+    uint32_t victim = 0;
+    for (uint32_t way=1; way<num_way; way++)
+        if (set[way].lru > set[victim].lru)
+            victim = way;
+
+    return victim;
+}
+
+void SHADOW_LLC::update(SHADOW_WAY *set, uint32_t way, uint32_t type, uint8_t hit, uint32_t cf)
+{
+    // writeback hits do not change the replacement state
+    if ((type == WRITEBACK) && hit)
+        return;
+
+    updates++;
+    lines_stored_over_time += lines_stored;
+    cf_count[cf - 1]++;
+
+    if (policy == SHADOW_SRRIP) {
+        set[way].rrpv = hit ? 0 : SHADOW_MAX_RRPV - 1;
+        return;
+    }
+
+    for (uint32_t i=0; i<num_way; i++) {
+        if (set[i].cf && (set[i].lru < set[way].lru))
+            set[i].lru++;
+    }
+    set[way].lru = 0;
+}
+
+void SHADOW_LLC::evict(SHADOW_WAY *way)
+{
+    for (uint32_t i=0; i<way->cf; i++) {
+        if (way->valid[i])
+            lines_stored--;
+        way->valid[i] = 0;
+    }
+    way->cf = 0;
+}
+
+LLC_SWEEP::~LLC_SWEEP()
+{
+    for (uint32_t i=0; i<shadow.size(); i++)
+        delete shadow[i];
+}
+
+void LLC_SWEEP::configure(const char *spec)
+{
+    string list = spec;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos)
+            comma = list.size();
+        if (comma > start)
+            shadow.push_back(new SHADOW_LLC(list.substr(start, comma - start)));
+        start = comma + 1;
+    }
+}
+
+void LLC_SWEEP::operate(CACHE *llc, PACKET *packet)
+{
+    // each compressor runs at most once per request
+    uint32_t compressed_size[5] = { 0, 0, 0, CACHE_LINE_BYTES, 0 };
+    uint8_t fill = (packet->type != PREFETCH) || (packet->fill_level <= llc->fill_level);
+
+    for (uint32_t i=0; i<shadow.size(); i++) {
+        uint32_t algorithm = shadow[i]->compression;
+        if (shadow[i]->compressed && (compressed_size[algorithm] == 0)) {
+            if (algorithm == SHADOW_BDI)
+                compressed_size[algorithm] = bdi::GeneralCompress(packet->program_data, 64, 1);
+            else if (algorithm == SHADOW_CPACK)
+                compressed_size[algorithm] = min(64, cpack::compressed_size((const uint8_t*) packet->program_data));
+            else if (algorithm == SHADOW_FPC)
+                compressed_size[algorithm] = min(64U, fpc::compressed_size((const uint8_t*) packet->program_data));
+#ifdef COMPRESSED_CACHE
+            else
+                compressed_size[algorithm] = llc->get_compressed_size(packet);
+#endif
+        }
+
+        shadow[i]->operate(packet->full_addr >> LOG2_BLOCK_SIZE, packet->type, fill, compressed_size[algorithm]);
+    }
+}
+
+void LLC_SWEEP::reset_stats()
+{
+    for (uint32_t i=0; i<shadow.size(); i++)
+        shadow[i]->reset_stats();
+}
+
+void LLC_SWEEP::print()
+{
+    cout << endl << "LLC sweep (shadow tag arrays, region of interest)" << endl;
+    printf("%-28s %10s %12s %12s %12s %9s %12s %12s\n", "config", "size(KB)", "access", "hit", "miss", "hit(%)", "util(%)", "compression");
+
+    for (uint32_t i=0; i<shadow.size(); i++) {
+        SHADOW_LLC *s = shadow[i];
+        uint64_t total_access = 0, total_hit = 0, total_miss = 0;
+        for (uint32_t j=0; j<NUM_TYPES; j++) {
+            total_access += s->access[j];
+            total_hit += s->hit[j];
+            total_miss += s->miss[j];
+        }
+
+        // lines held per way on average, and the compression ratio of the lines that were used
+        double utilization = s->updates ? (double)s->lines_stored_over_time / ((double)s->updates * s->num_set * s->num_way) : 0,
+               lines = 0, ways = 0;
+        for (uint32_t cf=1; cf<=MAX_COMPRESSIBILITY; cf++) {
+            lines += s->cf_count[cf-1];
+            ways += (double)s->cf_count[cf-1] / cf;
+        }
+
+        printf("%-28s %10lu %12lu %12lu %12lu %9.3f %12.3f %12.3f\n", s->name.c_str(), (uint64_t)s->num_set*s->num_way*BLOCK_SIZE/1024,
+                total_access, total_hit, total_miss, total_access ? 100.0*total_hit/total_access : 0.0,
+                100.0*utilization, ways ? lines/ways : 1.0);
+    }
+}
@@ -0,0 +1,184 @@
+#include "lockstep.h"
+
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+LOCKSTEP lockstep;
+
+int LLC_PORT::add_rq(PACKET *packet)
+{
+    add_request(packet, 1);
+    return -1;
+}
+
+int LLC_PORT::add_wq(PACKET *packet)
+{
+    add_request(packet, 2);
+    return -1;
+}
+
+int LLC_PORT::add_pq(PACKET *packet)
+{
+    add_request(packet, 3);
+    return -1;
+}
+
+void LLC_PORT::add_request(PACKET *packet, uint8_t queue_type)
+{
+    request.push_back(*packet);
+    request_type.push_back(queue_type);
+    pending[queue_type]++;
+}
+
+void LLC_PORT::return_data(PACKET *packet)
+{
+    // the LLC returns data straight to the L2C
+    cerr << "[LLC_PORT] " << __func__ << " should never be called" << endl;
+    assert(0);
+}
+
+void LLC_PORT::operate()
+{
+}
+
+void LLC_PORT::increment_WQ_FULL(uint64_t address)
+{
+    wq_full++;
+}
+
+// the L2C sees the LLC as it was at the start of the quantum plus its own requests
+uint32_t LLC_PORT::get_occupancy(uint8_t queue_type, uint64_t address)
+{
+    uint32_t occupancy = llc->get_occupancy(queue_type, address) + ((queue_type < 4) ? pending[queue_type] : 0),
+             size = llc->get_size(queue_type, address);
+
+    return (occupancy < size) ? occupancy : size;
+}
+
+uint32_t LLC_PORT::get_size(uint8_t queue_type, uint64_t address)
+{
+    return llc->get_size(queue_type, address);
+}
+
+void LLC_PORT::drain()
+{
+    for (; wq_full; wq_full--)
+        llc->increment_WQ_FULL(0);
+
+    // a request the LLC cannot take yet waits for the next quantum, and so does everything after it
+    uint32_t i = 0;
+    for (; i<request.size(); i++) {
+        int result;
+        if (request_type[i] == 1)
+            result = llc->add_rq(&request[i]);
+        else if (request_type[i] == 2) {
+            if (llc->WQ.occupancy >= llc->WQ.SIZE)
+                break;
+            result = llc->add_wq(&request[i]);
+        }
+        else
+            result = llc->add_pq(&request[i]);
+
+        if (result == -2)
+            break;
+
+        pending[request_type[i]]--;
+    }
+
+    request.erase(request.begin(), request.begin() + i);
+    request_type.erase(request_type.begin(), request_type.begin() + i);
+}
+
+void LOCKSTEP::start(uint64_t cycles, void (*core_cycle)(uint32_t))
+{
+    quantum = cycles;
+    operate_core = core_cycle;
+
+    epoch = 0;
+    finished = 0;
+    stopping = 0;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        port[i].llc = &uncore.LLC;
+        ooo_cpu[i].L2C.lower_level = &port[i];
+        finished_cycle[i] = current_core_cycle[i];
+    }
+
+    for (uint32_t i=1; i<NUM_CPUS; i++)
+        worker[i] = thread(&LOCKSTEP::run_worker, this, i);
+}
+
+void LOCKSTEP::run_cores()
+{
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        finished_cycle[i].store(current_core_cycle[i], memory_order_relaxed);
+
+    active = 1;
+    finished.store(0, memory_order_relaxed);
+    epoch.fetch_add(1, memory_order_release);
+
+    run_core(0);
+
+    while (finished.load(memory_order_acquire) < NUM_CPUS-1)
+        this_thread::yield();
+    active = 0;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        port[i].drain();
+}
+
+void LOCKSTEP::stop()
+{
+    stopping = 1;
+    epoch.fetch_add(1, memory_order_release);
+
+    for (uint32_t i=1; i<NUM_CPUS; i++)
+        worker[i].join();
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        port[i].drain();
+        ooo_cpu[i].L2C.lower_level = &uncore.LLC;
+    }
+}
+
+void LOCKSTEP::run_worker(uint32_t cpu)
+{
+    uint64_t seen = 0;
+    while (1) {
+        uint64_t current;
+        while ((current = epoch.load(memory_order_acquire)) == seen)
+            this_thread::yield();
+        seen = current;
+
+        if (stopping)
+            return;
+
+        run_core(cpu);
+        finished.fetch_add(1, memory_order_release);
+    }
+}
+
+void LOCKSTEP::run_core(uint32_t cpu)
+{
+    for (uint64_t i=0; i<quantum; i++) {
+        operate_core(cpu);
+        finished_cycle[cpu].store(current_core_cycle[cpu], memory_order_release);
+    }
+}
+
+void LOCKSTEP::lock_page_table(uint32_t cpu)
+{
+    // with a quantum of 1, the lower cores finish their cycle first, as in a sequential run
+    if (quantum == 1) {
+        for (uint32_t i=0; i<cpu; i++)
+            while (finished_cycle[i].load(memory_order_acquire) < current_core_cycle[cpu])
+                this_thread::yield();
+    }
+
+    page_table_mutex.lock();
+}
+
+void LOCKSTEP::unlock_page_table()
+{
+    page_table_mutex.unlock();
+}
@@ -3,6 +3,12 @@
 #include <getopt.h>
 #include "ooo_cpu.h"
 #include "uncore.h"
+#include "cycle_skip.h"
+#include "checkpoint.h"
+#include "lockstep.h"
+#include "llc_stream.h"
+#include "llc_sweep.h"
+#include "llc_mrc.h"
 
 uint8_t warmup_complete[NUM_CPUS], 
         simulation_complete[NUM_CPUS], 
@@ -10,10 +16,14 @@ uint8_t warmup_complete[NUM_CPUS],
         all_simulation_complete = 0,
         MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS,
         knob_cloudsuite = 0,
-        knob_low_bandwidth = 0;
+        knob_low_bandwidth = 0,
+        knob_cycle_skip = 0,
+        knob_functional_warmup = 0;
 
 uint64_t warmup_instructions     = 1000000,
          simulation_instructions = 10000000,
+         skip_instructions       = 0,
+         lockstep_quantum        = 0,
          champsim_seed;
 
 time_t start_time;
@@ -22,14 +32,21 @@ double ped_coefficient;
 unsigned obol_cost_ratio = 4;
 unsigned obol_cost_threshold = 160;
 
+// post-warmup checkpoint to write, or to start from instead of warming up
+const char *save_checkpoint_path = NULL, *load_checkpoint_path = NULL;
+
+// LLC access stream to capture, or to replay instead of simulating the cores
+const char *llc_capture_path = NULL, *llc_replay_path = NULL;
+
 // Used in some policies; set via the -o and -x flags.
 string main_output_folder;
 double benchmark_compression_ratio = 1.0;
 
 // PAGE TABLE
 uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0;
-queue <uint64_t > page_queue;
-map <uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
+FLAT_MAP page_table, inverse_table, cl_footprint[NUM_CPUS];
+PAGE_CLOCK page_clock;
+vector <uint64_t> tlb_shootdown[NUM_CPUS], cache_shootdown[NUM_CPUS];
 uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
 void record_roi_stats(uint32_t cpu, CACHE *cache)
@@ -149,6 +166,11 @@ void reset_cache_stats(uint32_t cpu, CACHE *cache)
     cache->WQ.TO_CACHE = 0;
     cache->WQ.FORWARD = 0;
     cache->WQ.FULL = 0;
+
+#ifdef COMPRESSED_CACHE
+    for (uint32_t i=0; i<NUM_COMPRESSORS; i++)
+        cache->compressor_fill[i] = 0;
+#endif
 }
 
 void finish_warmup()
@@ -202,6 +224,11 @@ void finish_warmup()
         ooo_cpu[i].L2C.LATENCY  = L2C_LATENCY;
     }
     uncore.LLC.LATENCY = LLC_LATENCY;
+
+    if (llc_capture.file)
+        llc_capture.record_mark(LLC_STREAM_MARK_WARMUP, 0);
+    llc_sweep.reset_stats();
+    llc_mrc.reset_stats();
 }
 
 void print_deadlock(uint32_t i)
@@ -276,6 +303,31 @@ uint64_t rotr64 (uint64_t n, unsigned int c)
 }
 
 RANDOM champsim_rand(champsim_seed);
+
+// drop the translations and private cache lines of swapped pages that cpu was told about
+static void shoot_down_pages(uint32_t cpu)
+{
+    // the TLBs hold vpages without the cpu bits
+    uint64_t high_bit_mask = rotr64(cpu, lg2(NUM_CPUS));
+    for (uint32_t i=0; i<tlb_shootdown[cpu].size(); i++) {
+        uint64_t tlb_vpage = tlb_shootdown[cpu][i] ^ high_bit_mask;
+        ooo_cpu[cpu].ITLB.invalidate_entry(tlb_vpage);
+        ooo_cpu[cpu].DTLB.invalidate_entry(tlb_vpage);
+        ooo_cpu[cpu].STLB.invalidate_entry(tlb_vpage);
+    }
+    tlb_shootdown[cpu].clear();
+
+    for (uint32_t i=0; i<cache_shootdown[cpu].size(); i++) {
+        for (uint32_t j=0; j<BLOCK_SIZE; j++) {
+            uint64_t cl_addr = (cache_shootdown[cpu][i] << 6) | j;
+            ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
+            ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
+            ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
+        }
+    }
+    cache_shootdown[cpu].clear();
+}
+
 uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_vpage)
 {
 #ifdef SANITY_CHECK
@@ -286,6 +338,9 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     uint8_t  swap = 0;
     uint64_t high_bit_mask = rotr64(cpu, lg2(NUM_CPUS)),
              unique_va = va | high_bit_mask;
+    // cores running on their own threads take turns on the page table
+    LOCKSTEP_PAGE_TABLE_LOCK page_table_lock(cpu);
+
     //uint64_t vpage = unique_va >> LOG2_PAGE_SIZE,
     uint64_t vpage = unique_vpage | high_bit_mask,
              voffset = unique_va & ((1<<LOG2_PAGE_SIZE) - 1);
@@ -293,77 +348,63 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     // smart random number generator
     uint64_t random_ppage;
 
-    map <uint64_t, uint64_t>::iterator pr = page_table.begin();
-    map <uint64_t, uint64_t>::iterator ppage_check = inverse_table.begin();
-
-    // check unique cache line footprint
-    map <uint64_t, uint64_t>::iterator cl_check = unique_cl[cpu].find(unique_va >> LOG2_BLOCK_SIZE);
-    if (cl_check == unique_cl[cpu].end()) { // we've never seen this cache line before
-        unique_cl[cpu].insert(make_pair(unique_va >> LOG2_BLOCK_SIZE, 0));
+    // check unique cache line footprint, one bit per cache line of the page
+    uint64_t &footprint = cl_footprint[cpu].insert(unique_va >> LOG2_PAGE_SIZE, 0),
+             cl_bit = 1ULL << ((unique_va >> LOG2_BLOCK_SIZE) & ((PAGE_SIZE/BLOCK_SIZE) - 1));
+    if ((footprint & cl_bit) == 0) { // we've never seen this cache line before
+        footprint |= cl_bit;
         num_cl[cpu]++;
     }
-    else
-        cl_check->second++;
 
-    pr = page_table.find(vpage);
-    if (pr == page_table.end()) { // no VA => PA translation found 
+    uint64_t *pr = page_table.find(vpage);
+    if (pr == NULL) { // no VA => PA translation found 
 
         if (allocated_pages >= DRAM_PAGES) { // not enough memory
 
-            // TODO: elaborate page replacement algorithm
-            // here, ChampSim randomly selects a page that is not recently used and we only track 32K recently accessed pages
-            uint8_t  found_NRU = 0;
-            uint64_t NRU_vpage = 0; // implement it
-            map <uint64_t, uint64_t>::iterator pr2 = recent_page.begin();
-            for (pr = page_table.begin(); pr != page_table.end(); pr++) {
-
-                NRU_vpage = pr->first;
-                if (recent_page.find(NRU_vpage) == recent_page.end()) {
-                    found_NRU = 1;
-                    break;
-                }
+            // CLOCK page replacement: a page walked since the hand last passed it gets a second
+            // chance, and its translations are shot down so that using it again sets its bit
+            while (page_clock.referenced[page_clock.hand]) {
+                page_clock.referenced[page_clock.hand] = 0;
+                tlb_shootdown[page_clock.cpu[page_clock.hand]].push_back(page_clock.vpage[page_clock.hand]);
+                page_clock.second_chances++;
+                page_clock.advance();
             }
-#ifdef SANITY_CHECK
-            if (found_NRU == 0)
-                assert(0);
+            uint64_t frame = page_clock.hand;
+            page_clock.advance();
+            page_clock.swaps++;
+
+            uint64_t NRU_vpage = page_clock.vpage[frame],
+                     mapped_ppage = page_clock.ppage[frame];
+            uint32_t NRU_cpu = page_clock.cpu[frame];
 
-            if (pr == page_table.end())
-                assert(0);
-#endif
             DP ( if (warmup_complete[cpu]) {
-            cout << "[SWAP] update page table NRU_vpage: " << hex << pr->first << " new_vpage: " << vpage << " ppage: " << pr->second << dec << endl; });
+            cout << "[SWAP] update page table NRU_vpage: " << hex << NRU_vpage << " new_vpage: " << vpage << " ppage: " << mapped_ppage << dec << endl; });
 
             // update page table with new VA => PA mapping
-            // since we cannot change the key value already inserted in a map structure, we need to erase the old node and add a new node
-            uint64_t mapped_ppage = pr->second;
-            page_table.erase(pr);
-            page_table.insert(make_pair(vpage, mapped_ppage));
+            page_table.erase(NRU_vpage);
+            page_table.insert(vpage, frame);
+            page_clock.vpage[frame] = vpage;
+            page_clock.cpu[frame] = cpu;
+            page_clock.referenced[frame] = 1;
 
             // update inverse table with new PA => VA mapping
-            ppage_check = inverse_table.find(mapped_ppage);
+            uint64_t *ppage_check = inverse_table.find(mapped_ppage);
 #ifdef SANITY_CHECK
-            if (ppage_check == inverse_table.end())
+            if (ppage_check == NULL)
                 assert(0);
 #endif
-            ppage_check->second = vpage;
+            *ppage_check = vpage;
 
             DP ( if (warmup_complete[cpu]) {
             cout << "[SWAP] update inverse table NRU_vpage: " << hex << NRU_vpage << " new_vpage: ";
-            cout << ppage_check->second << " ppage: " << ppage_check->first << dec << endl; });
-
-            // update page_queue
-            page_queue.pop();
-            page_queue.push(vpage);
+            cout << *ppage_check << " ppage: " << mapped_ppage << dec << endl; });
 
-            // invalidate corresponding vpage and ppage from the cache hierarchy
-            ooo_cpu[cpu].ITLB.invalidate_entry(NRU_vpage);
-            ooo_cpu[cpu].DTLB.invalidate_entry(NRU_vpage);
-            ooo_cpu[cpu].STLB.invalidate_entry(NRU_vpage);
+            // invalidate corresponding vpage and ppage from the cache hierarchy, the private
+            // ones of the old owner the next time it translates
+            tlb_shootdown[NRU_cpu].push_back(NRU_vpage);
+            cache_shootdown[NRU_cpu].push_back(mapped_ppage);
             for (uint32_t i=0; i<BLOCK_SIZE; i++) {
                 uint64_t cl_addr = (mapped_ppage << 6) | i;
-                ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
-                ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
-                ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
                 uncore.LLC.invalidate_entry(cl_addr);
 #ifdef COMPRESSED_CACHE
                 if(uncore.LLC.is_compressed)
@@ -389,10 +430,10 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
             //random_ppage |= (cpu<<(32-LOG2_PAGE_SIZE)); 
 
             while (1) { // try to find an empty physical page number
-                ppage_check = inverse_table.find(random_ppage); // check if this page can be allocated 
-                if (ppage_check != inverse_table.end()) { // random_ppage is not available
+                uint64_t *ppage_check = inverse_table.find(random_ppage); // check if this page can be allocated 
+                if (ppage_check != NULL) { // random_ppage is not available
                     DP ( if (warmup_complete[cpu]) {
-                    cout << "vpage: " << hex << ppage_check->first << " is already mapped to ppage: " << random_ppage << dec << endl; }); 
+                    cout << "vpage: " << hex << *ppage_check << " is already mapped to ppage: " << random_ppage << dec << endl; }); 
                     
                     if (num_adjacent_page > 0)
                         fragmented = 1;
@@ -410,9 +451,8 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
 
             // insert translation to page tables
             //printf("Insert  num_adjacent_page: %u  vpage: %lx  ppage: %lx\n", num_adjacent_page, vpage, random_ppage);
-            page_table.insert(make_pair(vpage, random_ppage));
-            inverse_table.insert(make_pair(random_ppage, vpage));
-            page_queue.push(vpage);
+            page_table.insert(vpage, page_clock.add(cpu, vpage, random_ppage));
+            inverse_table.insert(random_ppage, vpage);
             previous_ppage = random_ppage;
             num_adjacent_page--;
             num_page[cpu]++;
@@ -433,14 +473,17 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     }
     else {
         //printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, pr->second);
+        page_clock.referenced[*pr] = 1;
     }
 
     pr = page_table.find(vpage);
 #ifdef SANITY_CHECK
-    if (pr == page_table.end())
+    if (pr == NULL)
         assert(0);
 #endif
-    uint64_t ppage = pr->second;
+    uint64_t ppage = page_clock.ppage[*pr];
+
+    shoot_down_pages(cpu);
 
     uint64_t pa = ppage << LOG2_PAGE_SIZE;
     pa |= voffset;
@@ -459,6 +502,194 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     return pa;
 }
 
+// runs the LLC alone on a captured access stream, through the functional path
+void replay_llc_stream(const char *path)
+{
+    LLC_STREAM stream;
+    if (!stream.open_read(path)) {
+        cerr << "[LLC_STREAM] cannot open " << path << endl;
+        assert(0);
+    }
+
+    // writebacks and misses leave the LLC and are dropped
+    LLC_STREAM_SINK sink;
+    uncore.LLC.lower_level = &sink;
+
+    LLC_STREAM_RECORD record;
+    PACKET packet;
+    while (stream.read(&record)) {
+        if (record.mark == LLC_STREAM_MARK_WARMUP) {
+            for (uint32_t i=0; i<NUM_CPUS; i++) {
+                warmup_complete[i] = 1;
+                reset_cache_stats(i, &uncore.LLC);
+            }
+            all_warmup_complete = NUM_CPUS + 1;
+            llc_sweep.reset_stats();
+            llc_mrc.reset_stats();
+            continue;
+        }
+        if (record.mark == LLC_STREAM_MARK_FINISH) {
+            simulation_complete[record.cpu] = 1;
+            record_roi_stats(record.cpu, &uncore.LLC);
+            continue;
+        }
+
+        current_core_cycle[record.cpu] = record.cycle;
+
+        packet.cpu = record.cpu;
+        packet.type = record.type;
+        packet.fill_level = record.fill ? FILL_LLC : FILL_L2;
+        packet.address = record.full_addr >> LOG2_BLOCK_SIZE;
+        packet.full_addr = record.full_addr;
+        packet.ip = record.ip;
+        packet.instr_id = stream.records;
+        packet.event_cycle = record.cycle;
+        memcpy(packet.program_data, record.data, CACHE_LINE_BYTES);
+        packet.compressed_size = COMPRESSED_SIZE_UNKNOWN; // the capture may have used another compression
+
+        uncore.LLC.functional_access(&packet);
+    }
+
+    // a capture that stopped early has no end marker for some cores
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        if (simulation_complete[i] == 0)
+            record_roi_stats(i, &uncore.LLC);
+    }
+
+    uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time);
+    cout << endl << "LLC replay: " << stream.records << " accesses (Simulation time: " << elapsed_second << " sec)" << endl;
+
+    cout << endl << "Region of Interest Statistics" << endl;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        cout << endl << "CPU " << i << endl;
+        print_roi_stats(i, &uncore.LLC);
+    }
+
+    uncore.LLC.llc_replacement_final_stats();
+#ifdef COMPRESSION_HYBRID
+    uncore.LLC.print_compressor_stats();
+#endif
+
+    if (llc_sweep.shadow.size())
+        llc_sweep.print();
+    if (llc_mrc.path.size())
+        llc_mrc.print();
+}
+
+// one cycle of a core's pipeline and private caches
+void operate_core(uint32_t cpu)
+{
+    // proceed one cycle
+    current_core_cycle[cpu]++;
+
+    //cout << "Trying to process instr_id: " << ooo_cpu[cpu].instr_unique_id << " fetch_stall: " << +ooo_cpu[cpu].fetch_stall;
+    //cout << " stall_cycle: " << stall_cycle[cpu] << " current: " << current_core_cycle[cpu] << endl;
+
+    // core might be stalled due to page fault or branch misprediction
+    if (stall_cycle[cpu] <= current_core_cycle[cpu]) {
+
+        // fetch unit
+        if (ooo_cpu[cpu].ROB.occupancy < ooo_cpu[cpu].ROB.SIZE) {
+            // handle branch
+            if (ooo_cpu[cpu].fetch_stall == 0) 
+                ooo_cpu[cpu].handle_branch();
+        }
+
+        // fetch
+        ooo_cpu[cpu].fetch_instruction();
+
+
+        // schedule (including decode latency)
+        uint32_t schedule_index = ooo_cpu[cpu].ROB.next_schedule;
+        if ((ooo_cpu[cpu].ROB.entry[schedule_index].scheduled == 0) && (ooo_cpu[cpu].ROB.entry[schedule_index].event_cycle <= current_core_cycle[cpu]))
+            ooo_cpu[cpu].schedule_instruction();
+
+        // execute
+        ooo_cpu[cpu].execute_instruction();
+
+        // memory operation
+        ooo_cpu[cpu].schedule_memory_instruction();
+        ooo_cpu[cpu].execute_memory_instruction();
+
+        // complete 
+        ooo_cpu[cpu].update_rob();
+
+        // retire
+        if ((ooo_cpu[cpu].ROB.entry[ooo_cpu[cpu].ROB.head].executed == COMPLETED) && (ooo_cpu[cpu].ROB.entry[ooo_cpu[cpu].ROB.head].event_cycle <= current_core_cycle[cpu]))
+            ooo_cpu[cpu].retire_rob();
+    }
+}
+
+// heartbeat, deadlock, warmup and end of simulation checks of a core
+void check_core(uint32_t cpu, uint8_t show_heartbeat, uint64_t elapsed_hour, uint64_t elapsed_minute, uint64_t elapsed_second)
+{
+    // heartbeat information
+    if (show_heartbeat && (ooo_cpu[cpu].num_retired >= ooo_cpu[cpu].next_print_instruction)) {
+        float cumulative_ipc;
+        if (warmup_complete[cpu])
+            cumulative_ipc = (1.0*(ooo_cpu[cpu].num_retired - ooo_cpu[cpu].begin_sim_instr)) / (current_core_cycle[cpu] - ooo_cpu[cpu].begin_sim_cycle);
+        else
+            cumulative_ipc = (1.0*ooo_cpu[cpu].num_retired) / current_core_cycle[cpu];
+        float heartbeat_ipc = (1.0*ooo_cpu[cpu].num_retired - ooo_cpu[cpu].last_sim_instr) / (current_core_cycle[cpu] - ooo_cpu[cpu].last_sim_cycle);
+
+        cout << "Heartbeat CPU " << cpu << " instructions: " << ooo_cpu[cpu].num_retired << " cycles: " << current_core_cycle[cpu];
+        cout << " heartbeat IPC: " << heartbeat_ipc << " cumulative IPC: " << cumulative_ipc; 
+        cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
+        ooo_cpu[cpu].next_print_instruction += STAT_PRINTING_PERIOD;
+
+        ooo_cpu[cpu].last_sim_instr = ooo_cpu[cpu].num_retired;
+        ooo_cpu[cpu].last_sim_cycle = current_core_cycle[cpu];
+    }
+
+    // check for deadlock
+    if (ooo_cpu[cpu].ROB.entry[ooo_cpu[cpu].ROB.head].ip && (ooo_cpu[cpu].ROB.entry[ooo_cpu[cpu].ROB.head].event_cycle + DEADLOCK_CYCLE) <= current_core_cycle[cpu])
+        print_deadlock(cpu);
+
+    // check for warmup
+    // warmup complete
+    if ((warmup_complete[cpu] == 0) && (ooo_cpu[cpu].num_retired > warmup_instructions)) {
+        warmup_complete[cpu] = 1;
+        all_warmup_complete++;
+    }
+    if (all_warmup_complete == NUM_CPUS) { // this part is called only once when all cores are warmed up
+        all_warmup_complete++;
+        finish_warmup();
+
+        if (save_checkpoint_path)
+            save_checkpoint(save_checkpoint_path);
+    }
+
+    /*
+    if (all_warmup_complete == 0) { 
+        all_warmup_complete = 1;
+        finish_warmup();
+    }
+    if (ooo_cpu[1].num_retired > 0)
+        warmup_complete[1] = 1;
+    */
+    
+    // simulation complete
+    if ((all_warmup_complete > NUM_CPUS) && (simulation_complete[cpu] == 0) && (ooo_cpu[cpu].num_retired >= (ooo_cpu[cpu].begin_sim_instr + ooo_cpu[cpu].simulation_instructions))) {
+        simulation_complete[cpu] = 1;
+        ooo_cpu[cpu].finish_sim_instr = ooo_cpu[cpu].num_retired - ooo_cpu[cpu].begin_sim_instr;
+        ooo_cpu[cpu].finish_sim_cycle = current_core_cycle[cpu] - ooo_cpu[cpu].begin_sim_cycle;
+
+        cout << "Finished CPU " << cpu << " instructions: " << ooo_cpu[cpu].finish_sim_instr << " cycles: " << ooo_cpu[cpu].finish_sim_cycle;
+        cout << " cumulative IPC: " << ((float) ooo_cpu[cpu].finish_sim_instr / ooo_cpu[cpu].finish_sim_cycle);
+        cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
+
+        record_roi_stats(cpu, &ooo_cpu[cpu].L1D);
+        record_roi_stats(cpu, &ooo_cpu[cpu].L1I);
+        record_roi_stats(cpu, &ooo_cpu[cpu].L2C);
+        record_roi_stats(cpu, &uncore.LLC);
+
+        if (llc_capture.file)
+            llc_capture.record_mark(LLC_STREAM_MARK_FINISH, cpu);
+
+        all_simulation_complete++;
+    }
+}
+
 int main(int argc, char** argv)
 {
 	// interrupt signal hanlder
@@ -491,6 +722,16 @@ int main(int argc, char** argv)
             {"cost_threshold", required_argument, 0, 'm'},
             {"ped_coefficient", required_argument, 0, 'p'},
             {"compression_ratio", required_argument, 0, 'x'},
+            {"skip_instructions", required_argument, 0, 'k'},
+            {"cycle_skip", no_argument, 0, 'e'},
+            {"functional_warmup", no_argument, 0, 'f'},
+            {"save_checkpoint", required_argument, 0, 'a'},
+            {"load_checkpoint", required_argument, 0, 'l'},
+            {"lockstep_quantum", required_argument, 0, 'q'},
+            {"llc_capture", required_argument, 0, 'u'},
+            {"llc_replay", required_argument, 0, 'y'},
+            {"llc_sweep", required_argument, 0, 'z'},
+            {"llc_mrc", required_argument, 0, 'j'},
             {0, 0, 0, 0}      
         };
 
@@ -539,6 +780,36 @@ int main(int argc, char** argv)
             case 'x':
                 benchmark_compression_ratio = atof(optarg);
                 break;
+            case 'k':
+                skip_instructions = atol(optarg);
+                break;
+            case 'e':
+                knob_cycle_skip = 1;
+                break;
+            case 'f':
+                knob_functional_warmup = 1;
+                break;
+            case 'a':
+                save_checkpoint_path = optarg;
+                break;
+            case 'l':
+                load_checkpoint_path = optarg;
+                break;
+            case 'q':
+                lockstep_quantum = atol(optarg);
+                break;
+            case 'u':
+                llc_capture_path = optarg;
+                break;
+            case 'y':
+                llc_replay_path = optarg;
+                break;
+            case 'z':
+                llc_sweep.configure(optarg);
+                break;
+            case 'j':
+                llc_mrc.configure(optarg);
+                break;
             default:
                 abort();
         }
@@ -549,6 +820,27 @@ int main(int argc, char** argv)
     // consequences of knobs
     cout << "Warmup Instructions: " << warmup_instructions << endl;
     cout << "Simulation Instructions: " << simulation_instructions << endl;
+    if (skip_instructions)
+        cout << "Skip Instructions: " << skip_instructions << endl;
+    if (lockstep_quantum) {
+        cout << "Lock-step core threads: quantum " << lockstep_quantum << " cycle(s)" << endl;
+        // requests waiting in the LLC ports are invisible to the idle cycle check
+        knob_cycle_skip = 0;
+    }
+    if (knob_cycle_skip)
+        cout << "Cycle skipping: on" << endl;
+    if (llc_capture_path)
+        cout << "LLC access stream: " << llc_capture_path << endl;
+    if (llc_replay_path)
+        cout << "LLC replay of: " << llc_replay_path << endl;
+    if (llc_sweep.shadow.size())
+        cout << "LLC sweep: " << llc_sweep.shadow.size() << " shadow LLCs" << endl;
+    if (llc_mrc.path.size())
+        cout << "LLC miss-ratio curve: " << llc_mrc.path << (llc_mrc.rate < 1 ? " (sampled)" : "") << endl;
+    if (knob_functional_warmup)
+        cout << "Functional warmup: on" << endl;
+    if (load_checkpoint_path)
+        cout << "Warmup from checkpoint: " << load_checkpoint_path << endl;
     //cout << "Scramble Loads: " << (knob_scramble_loads ? "ture" : "false") << endl;
     cout << "Number of CPUs: " << NUM_CPUS << endl;
     cout << "LLC sets: " << LLC_SET << endl;
@@ -584,15 +876,9 @@ int main(int argc, char** argv)
 
             sprintf(ooo_cpu[count_traces].trace_string, "%s", argv[i]);
 
-            char *full_name = ooo_cpu[count_traces].trace_string,
-                 *last_dot = strrchr(ooo_cpu[count_traces].trace_string, '.');
-
-            if (full_name[last_dot - full_name + 1] == 'g') // gzip format
-                sprintf(ooo_cpu[count_traces].gunzip_command, "gunzip -c %s", argv[i]);
-            else if (full_name[last_dot - full_name + 1] == 'x') // xz
-                sprintf(ooo_cpu[count_traces].gunzip_command, "xz -dc %s", argv[i]);
-            else {
-                cout << "ChampSim does not support traces other than gz or xz compression!" << endl; 
+            int trace_format = TRACE_READER::detect_format(ooo_cpu[count_traces].trace_string);
+            if (trace_format == -1) {
+                cout << "ChampSim does not support traces other than gz, xz or zst compression!" << endl; 
                 assert(0);
             }
 
@@ -615,11 +901,19 @@ int main(int argc, char** argv)
                 j++;
             }
 
-            ooo_cpu[count_traces].trace_file = popen(ooo_cpu[count_traces].gunzip_command, "r");
-            if (ooo_cpu[count_traces].trace_file == NULL) {
+            // a checkpoint picks up where its run stopped retiring
+            uint64_t trace_skip = skip_instructions;
+            if (load_checkpoint_path && (count_traces < NUM_CPUS))
+                trace_skip = checkpoint_trace_position(load_checkpoint_path, count_traces);
+
+            size_t instr_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+            if (!ooo_cpu[count_traces].trace_reader.open(ooo_cpu[count_traces].trace_string, trace_format, instr_size, trace_skip)) {
                 printf("\n*** Trace file not found: %s ***\n\n", argv[i]);
                 exit(1);
             }
+            if (trace_skip)
+                printf("CPU %d skips %lu instructions (%s)\n", count_traces, trace_skip,
+                        ooo_cpu[count_traces].trace_reader.skip_with_index ? "seeking with the trace index" : "fast-forwarding");
 
             count_traces++;
             if (count_traces > NUM_CPUS) {
@@ -632,7 +926,7 @@ int main(int argc, char** argv)
         }
     }
 
-    if (count_traces != NUM_CPUS) {
+    if ((count_traces != NUM_CPUS) && (llc_replay_path == NULL)) {
         printf("\n*** Not enough traces for the configured number of cores ***\n\n");
         exit(1);
     }
@@ -735,123 +1029,97 @@ int main(int argc, char** argv)
 
     // simulation entry point
     start_time = time(NULL);
-    uint8_t run_simulation = 1;
-    while (run_simulation) {
 
-        uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
-                 elapsed_minute = elapsed_second / 60,
-                 elapsed_hour = elapsed_minute / 60;
-        elapsed_minute -= elapsed_hour*60;
-        elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
-
-        for (int i=0; i<NUM_CPUS; i++) {
-            // proceed one cycle
-            current_core_cycle[i]++;
+    if (llc_replay_path) {
+        replay_llc_stream(llc_replay_path);
+        return 0;
+    }
 
-            //cout << "Trying to process instr_id: " << ooo_cpu[i].instr_unique_id << " fetch_stall: " << +ooo_cpu[i].fetch_stall;
-            //cout << " stall_cycle: " << stall_cycle[i] << " current: " << current_core_cycle[i] << endl;
+    if (llc_capture_path && !llc_capture.open_write(llc_capture_path)) {
+        cerr << "[LLC_STREAM] cannot write " << llc_capture_path << endl;
+        assert(0);
+    }
 
-            // core might be stalled due to page fault or branch misprediction
-            if (stall_cycle[i] <= current_core_cycle[i]) {
+    // the checkpoint replaces warmup
+    if (load_checkpoint_path) {
+        load_checkpoint(load_checkpoint_path);
+        for (int i=0; i<NUM_CPUS; i++)
+            warmup_complete[i] = 1;
+        all_warmup_complete = NUM_CPUS + 1;
+        finish_warmup();
+    }
 
-                // fetch unit
-                if (ooo_cpu[i].ROB.occupancy < ooo_cpu[i].ROB.SIZE) {
-                    // handle branch
-                    if (ooo_cpu[i].fetch_stall == 0) 
-                        ooo_cpu[i].handle_branch();
+    // functional warmup: the warmup instructions only train the branch predictors, TLBs, caches and prefetchers,
+    // the detailed model then retires one more instruction per core and finish_warmup() is called as usual
+    else if (knob_functional_warmup) {
+        uint8_t warming = 1;
+        while (warming) {
+            warming = 0;
+            for (int i=0; i<NUM_CPUS; i++) {
+                if (ooo_cpu[i].num_retired >= warmup_instructions)
+                    continue;
+
+                warming = 1;
+                current_core_cycle[i]++;
+                ooo_cpu[i].functional_instruction();
+
+                if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
+                    cout << "Heartbeat CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " (functional warmup, ";
+                    cout << "Simulation time: " << (uint64_t)(time(NULL) - start_time) << " sec) " << endl;
+                    ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
                 }
-
-                // fetch
-                ooo_cpu[i].fetch_instruction();
-
-
-                // schedule (including decode latency)
-                uint32_t schedule_index = ooo_cpu[i].ROB.next_schedule;
-                if ((ooo_cpu[i].ROB.entry[schedule_index].scheduled == 0) && (ooo_cpu[i].ROB.entry[schedule_index].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].schedule_instruction();
-
-                // execute
-                ooo_cpu[i].execute_instruction();
-
-                // memory operation
-                ooo_cpu[i].schedule_memory_instruction();
-                ooo_cpu[i].execute_memory_instruction();
-
-                // complete 
-                ooo_cpu[i].update_rob();
-
-                // retire
-                if ((ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].executed == COMPLETED) && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].retire_rob();
             }
+        }
 
-            // heartbeat information
-            if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
-                float cumulative_ipc;
-                if (warmup_complete[i])
-                    cumulative_ipc = (1.0*(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr)) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle);
-                else
-                    cumulative_ipc = (1.0*ooo_cpu[i].num_retired) / current_core_cycle[i];
-                float heartbeat_ipc = (1.0*ooo_cpu[i].num_retired - ooo_cpu[i].last_sim_instr) / (current_core_cycle[i] - ooo_cpu[i].last_sim_cycle);
+        for (int i=0; i<NUM_CPUS; i++) {
+            ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
+            ooo_cpu[i].last_sim_cycle = current_core_cycle[i];
+            stall_cycle[i] = current_core_cycle[i];
+        }
+    }
 
-                cout << "Heartbeat CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " cycles: " << current_core_cycle[i];
-                cout << " heartbeat IPC: " << heartbeat_ipc << " cumulative IPC: " << cumulative_ipc; 
-                cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
-                ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
+    uint8_t run_simulation = 1;
+    CYCLE_SKIP cycle_skip;
+    if (lockstep_quantum)
+        lockstep.start(lockstep_quantum, operate_core);
+    while (run_simulation) {
 
-                ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
-                ooo_cpu[i].last_sim_cycle = current_core_cycle[i];
-            }
+        uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
+                 elapsed_minute = elapsed_second / 60,
+                 elapsed_hour = elapsed_minute / 60;
+        elapsed_minute -= elapsed_hour*60;
+        elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
 
-            // check for deadlock
-            if (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].ip && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE) <= current_core_cycle[i])
-                print_deadlock(i);
+        if (lockstep_quantum)
+            lockstep.run_cores();
 
-            // check for warmup
-            // warmup complete
-            if ((warmup_complete[i] == 0) && (ooo_cpu[i].num_retired > warmup_instructions)) {
-                warmup_complete[i] = 1;
-                all_warmup_complete++;
-            }
-            if (all_warmup_complete == NUM_CPUS) { // this part is called only once when all cores are warmed up
-                all_warmup_complete++;
-                finish_warmup();
-            }
+        for (int i=0; i<NUM_CPUS; i++) {
+            if (lockstep_quantum == 0)
+                operate_core(i);
 
-            /*
-            if (all_warmup_complete == 0) { 
-                all_warmup_complete = 1;
-                finish_warmup();
-            }
-            if (ooo_cpu[1].num_retired > 0)
-                warmup_complete[1] = 1;
-            */
-            
-            // simulation complete
-            if ((all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions))) {
-                simulation_complete[i] = 1;
-                ooo_cpu[i].finish_sim_instr = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
-                ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
-
-                cout << "Finished CPU " << i << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
-                cout << " cumulative IPC: " << ((float) ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
-                cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
-
-                record_roi_stats(i, &ooo_cpu[i].L1D);
-                record_roi_stats(i, &ooo_cpu[i].L1I);
-                record_roi_stats(i, &ooo_cpu[i].L2C);
-                record_roi_stats(i, &uncore.LLC);
-
-                all_simulation_complete++;
-            }
+            check_core(i, show_heartbeat, elapsed_hour, elapsed_minute, elapsed_second);
 
             if (all_simulation_complete == NUM_CPUS)
                 run_simulation = 0;
         }
 
         // TODO: should it be backward?
-        uncore.LLC.operate();
-        uncore.DRAM.operate();
+        for (uint64_t i=0; i<(lockstep_quantum ? lockstep_quantum : 1); i++) {
+            uncore.LLC.operate();
+            uncore.DRAM.operate();
+        }
+
+        // if this cycle changed nothing, neither will the ones before the next stored event
+        if (knob_cycle_skip && run_simulation)
+            cycle_skip.operate();
+    }
+
+    if (lockstep_quantum)
+        lockstep.stop();
+
+    if (llc_capture.file) {
+        cout << "LLC access stream: " << llc_capture.records << " accesses written to " << llc_capture_path << endl;
+        llc_capture.close();
     }
 
 #ifndef CRC2_COMPILE
@@ -864,6 +1132,8 @@ int main(int argc, char** argv)
     elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
     
     cout << endl << "ChampSim completed all CPUs" << endl;
+    if (knob_cycle_skip)
+        cout << "Cycle skipping: skipped " << cycle_skip.skipped_cycles << " of " << current_core_cycle[0] << " cycles" << endl;
     if (NUM_CPUS > 1) {
         cout << endl << "Total Simulation Statistics (not including warmup)" << endl;
         for (uint32_t i=0; i<NUM_CPUS; i++) {
@@ -893,6 +1163,9 @@ int main(int argc, char** argv)
         cout << "Major fault: " << major_fault[i] << " Minor fault: " << minor_fault[i] << endl;
     }
 
+    cout << endl << "Page swaps: " << page_clock.swaps << " Frames scanned: " << page_clock.scanned;
+    cout << " Second chances: " << page_clock.second_chances << " Allocated frames: " << allocated_pages << endl;
+
     for (uint32_t i=0; i<NUM_CPUS; i++) {
         ooo_cpu[i].L1D.l1d_prefetcher_final_stats();
         ooo_cpu[i].L2C.l2c_prefetcher_final_stats();
@@ -900,8 +1173,16 @@ int main(int argc, char** argv)
 
 #ifndef CRC2_COMPILE
     uncore.LLC.llc_replacement_final_stats();
+#ifdef COMPRESSION_HYBRID
+    uncore.LLC.print_compressor_stats();
+#endif
     print_dram_stats();
 #endif
 
+    if (llc_sweep.shadow.size())
+        llc_sweep.print();
+    if (llc_mrc.path.size())
+        llc_mrc.print();
+
     return 0;
 }
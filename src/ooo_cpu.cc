@@ -24,20 +24,10 @@ void O3_CPU::handle_branch()
     // first, read PIN trace
     while (continue_reading) {
 
-        size_t instr_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
-
         if (knob_cloudsuite) {
-            if (!fread(&current_cloudsuite_instr, instr_size, 1, trace_file)) {
-                // reached end of file for this trace
+            if (!trace_reader.read(&current_cloudsuite_instr)) {
+                // reached end of file for this trace, the reader thread has already re-opened it
                 cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
-
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
-                }
             } else { // successfully read the trace
 
                 // copy the instruction into the performance model's instruction format
@@ -156,17 +146,9 @@ void O3_CPU::handle_branch()
                 instr_unique_id++;
             }
         } else {
-            if (!fread(&current_instr, instr_size, 1, trace_file)) {
-                // reached end of file for this trace
+            if (!trace_reader.read(&current_instr)) {
+                // reached end of file for this trace, the reader thread has already re-opened it
                 cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
-
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
-                }
             } else { // successfully read the trace
 
                 // copy the instruction into the performance model's instruction format
@@ -1526,7 +1508,7 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
 
     // check if other instructions were merged
     if (queue->entry[index].instr_merged) {
-	ITERATE_SET(i,queue->entry[index].rob_index_depend_on_me, ROB_SIZE) {
+	ITERATE_SET(i,queue->deps[index].rob_index_depend_on_me, ROB_SIZE) {
             // update ROB entry
             if (is_it_tlb) {
                 ROB.entry[i].translated = COMPLETED;
@@ -1582,7 +1564,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
             cout << " full_addr: " << SQ.entry[sq_index].physical_address << dec << " store_merged: " << +queue->entry[index].store_merged;
             cout << " load_merged: " << +queue->entry[index].load_merged << endl; }); 
 
-            handle_merged_translation(&queue->entry[index]);
+            handle_merged_translation(&queue->entry[index], &queue->deps[index]);
         }
         else { 
             LQ.entry[lq_index].physical_address = (queue->entry[index].data_pa << LOG2_PAGE_SIZE) | (LQ.entry[lq_index].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
@@ -1604,7 +1586,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
             cout << " full_addr: " << LQ.entry[lq_index].physical_address << dec << " store_merged: " << +queue->entry[index].store_merged;
             cout << " load_merged: " << +queue->entry[index].load_merged << endl; }); 
 
-            handle_merged_translation(&queue->entry[index]);
+            handle_merged_translation(&queue->entry[index], &queue->deps[index]);
         }
 
         ROB.entry[rob_index].event_cycle = queue->entry[index].event_cycle;
@@ -1612,7 +1594,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
     else { // L1D
 
         if (queue->entry[index].type == RFO)
-            handle_merged_load(&queue->entry[index]);
+            handle_merged_load(&queue->entry[index], &queue->deps[index]);
         else { 
 #ifdef SANITY_CHECK
             if (queue->entry[index].store_merged)
@@ -1639,7 +1621,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
             cout << " load_merged: " << +queue->entry[index].load_merged << " inflight_mem: " << inflight_mem_executions << endl; }); 
 
             release_load_queue(lq_index);
-            handle_merged_load(&queue->entry[index]);
+            handle_merged_load(&queue->entry[index], &queue->deps[index]);
         }
     }
 
@@ -1647,7 +1629,7 @@ void O3_CPU::complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
     queue->remove_queue(&queue->entry[index]);
 }
 
-void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
+void O3_CPU::handle_o3_fetch(PACKET *current_packet, PACKET_DEPS *current_deps, uint32_t cache_type)
 {
     uint32_t rob_index = current_packet->rob_index,
              sq_index  = current_packet->sq_index,
@@ -1675,7 +1657,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
             cout << " full_addr: " << SQ.entry[sq_index].physical_address << dec << " store_merged: " << +current_packet->store_merged;
             cout << " load_merged: " << +current_packet->load_merged << endl; }); 
 
-            handle_merged_translation(current_packet);
+            handle_merged_translation(current_packet, current_deps);
         }
         else { 
             LQ.entry[lq_index].physical_address = (current_packet->data_pa << LOG2_PAGE_SIZE) | (LQ.entry[lq_index].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
@@ -1696,7 +1678,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
             cout << " full_addr: " << LQ.entry[lq_index].physical_address << dec << " store_merged: " << +current_packet->store_merged;
             cout << " load_merged: " << +current_packet->load_merged << endl; }); 
 
-            handle_merged_translation(current_packet);
+            handle_merged_translation(current_packet, current_deps);
         }
 
         ROB.entry[rob_index].event_cycle = current_packet->event_cycle;
@@ -1704,7 +1686,7 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
     else { // L1D
 
         if (current_packet->type == RFO)
-            handle_merged_load(current_packet);
+            handle_merged_load(current_packet, current_deps);
         else { // do traditional things
 #ifdef SANITY_CHECK
             if (rob_index != check_rob(current_packet->instr_id))
@@ -1733,17 +1715,17 @@ void O3_CPU::handle_o3_fetch(PACKET *current_packet, uint32_t cache_type)
 
             release_load_queue(lq_index);
 
-            handle_merged_load(current_packet);
+            handle_merged_load(current_packet, current_deps);
 
             ROB.entry[rob_index].event_cycle = current_packet->event_cycle;
         }
     }
 }
 
-void O3_CPU::handle_merged_translation(PACKET *provider)
+void O3_CPU::handle_merged_translation(PACKET *provider, PACKET_DEPS *provider_deps)
 {
     if (provider->store_merged) {
-	ITERATE_SET(merged, provider->sq_index_depend_on_me, SQ.SIZE) {
+	ITERATE_SET(merged, provider_deps->sq_index_depend_on_me, SQ.SIZE) {
             SQ.entry[merged].translated = COMPLETED;
             SQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (SQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
             SQ.entry[merged].event_cycle = current_core_cycle[cpu];
@@ -1760,7 +1742,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
         }
     }
     if (provider->load_merged) {
-	ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE) {
+	ITERATE_SET(merged, provider_deps->lq_index_depend_on_me, LQ.SIZE) {
             LQ.entry[merged].translated = COMPLETED;
             LQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (LQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
             LQ.entry[merged].event_cycle = current_core_cycle[cpu];
@@ -1782,9 +1764,9 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
     }
 }
 
-void O3_CPU::handle_merged_load(PACKET *provider)
+void O3_CPU::handle_merged_load(PACKET *provider, PACKET_DEPS *provider_deps)
 {
-    ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE) {
+    ITERATE_SET(merged, provider_deps->lq_index_depend_on_me, LQ.SIZE) {
         uint32_t merged_rob_index = LQ.entry[merged].rob_index;
 
         LQ.entry[merged].fetched = COMPLETED;
@@ -1919,3 +1901,126 @@ void O3_CPU::retire_rob()
         num_retired++;
     }
 }
+
+uint64_t O3_CPU::functional_translate(CACHE *tlb, uint64_t ip, uint64_t va, uint8_t type, uint8_t is_instruction, uint8_t asid[2])
+{
+    PACKET tlb_packet;
+    tlb_packet.instruction = is_instruction;
+    tlb_packet.tlb_access = 1;
+    tlb_packet.fill_level = FILL_L1;
+    tlb_packet.cpu = cpu;
+    if (knob_cloudsuite)
+        tlb_packet.address = ((va >> LOG2_PAGE_SIZE) << 9) | (is_instruction ? (256 + asid[0]) : asid[1]);
+    else
+        tlb_packet.address = va >> LOG2_PAGE_SIZE;
+    tlb_packet.full_addr = va;
+    tlb_packet.instr_id = instr_unique_id;
+    tlb_packet.ip = ip;
+    tlb_packet.type = type;
+    tlb_packet.asid[0] = asid[0];
+    tlb_packet.asid[1] = asid[1];
+    tlb_packet.event_cycle = current_core_cycle[cpu];
+
+    tlb->functional_access(&tlb_packet);
+
+    // the TLBs hold physical page numbers
+    return (tlb_packet.data << LOG2_PAGE_SIZE) | (va & ((1 << LOG2_PAGE_SIZE) - 1));
+}
+
+void O3_CPU::functional_access(CACHE *cache, uint64_t ip, uint64_t pa, uint8_t type, uint8_t is_instruction, uint8_t asid[2], const uint8_t *program_data)
+{
+    PACKET data_packet;
+    data_packet.instruction = is_instruction;
+    data_packet.fill_level = FILL_L1;
+    data_packet.cpu = cpu;
+    data_packet.address = pa >> LOG2_BLOCK_SIZE;
+    data_packet.full_addr = pa;
+    if (is_instruction)
+        data_packet.instruction_pa = pa;
+    if (program_data)
+        memcpy(data_packet.program_data, program_data, CACHE_LINE_BYTES);
+    data_packet.instr_id = instr_unique_id;
+    data_packet.ip = ip;
+    data_packet.type = type;
+    data_packet.asid[0] = asid[0];
+    data_packet.asid[1] = asid[1];
+    data_packet.event_cycle = current_core_cycle[cpu];
+
+    cache->functional_access(&data_packet);
+}
+
+void O3_CPU::functional_instruction()
+{
+    // functional warmup: read one instruction and send it straight through the branch predictor, TLBs and caches,
+    // loads before stores, without going through the ROB and LSQ
+    uint64_t ip, *destination_memory, *source_memory;
+    uint8_t is_branch, branch_taken, asid[2];
+    const uint8_t *destination_value[NUM_INSTR_DESTINATIONS_SPARC] = {NULL}, *source_value[NUM_INSTR_SOURCES] = {NULL};
+
+    if (knob_cloudsuite) {
+        if (!trace_reader.read(&current_cloudsuite_instr)) {
+            cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
+            return;
+        }
+
+        ip = current_cloudsuite_instr.ip;
+        is_branch = current_cloudsuite_instr.is_branch;
+        branch_taken = current_cloudsuite_instr.branch_taken;
+        asid[0] = current_cloudsuite_instr.asid[0];
+        asid[1] = current_cloudsuite_instr.asid[1];
+        destination_memory = current_cloudsuite_instr.destination_memory;
+        source_memory = current_cloudsuite_instr.source_memory;
+    } else {
+        if (!trace_reader.read(&current_instr)) {
+            cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
+            return;
+        }
+
+        ip = current_instr.ip;
+        is_branch = current_instr.is_branch;
+        branch_taken = current_instr.branch_taken;
+        asid[0] = cpu;
+        asid[1] = cpu;
+        destination_memory = current_instr.destination_memory;
+        source_memory = current_instr.source_memory;
+#ifdef DATA_TRACE
+        for (uint32_t i=0; i<NUM_INSTR_DESTINATIONS; i++)
+            destination_value[i] = current_instr.destination_cache_line_value[i];
+        for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+            source_value[i] = current_instr.source_cache_line_value[i];
+#endif
+    }
+
+    // branch prediction
+    if (is_branch) {
+        num_branch++;
+        if (predict_branch(ip) != branch_taken)
+            branch_mispredictions++;
+        last_branch_result(ip, branch_taken);
+    }
+
+    // instruction fetch
+    uint64_t instruction_pa = functional_translate(&ITLB, ip, ip, LOAD, 1, asid);
+    functional_access(&L1I, ip, instruction_pa, LOAD, 1, asid, NULL);
+
+    // loads
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (source_memory[i] == 0)
+            continue;
+
+        uint64_t pa = functional_translate(&DTLB, ip, source_memory[i], LOAD, 0, asid);
+        functional_access(&L1D, ip, pa, LOAD, 0, asid, source_value[i]);
+    }
+
+    // stores write the L1D when they retire
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        if (destination_memory[i] == 0)
+            continue;
+
+        uint64_t pa = functional_translate(&DTLB, ip, destination_memory[i], RFO, 0, asid);
+        functional_access(&L1D, ip, pa, RFO, 0, asid, destination_value[i]);
+    }
+
+    instr_unique_id++;
+    num_retired++;
+}
@@ -0,0 +1,124 @@
+#include "page_table.h"
+
+#include <string.h>
+
+FLAT_MAP::FLAT_MAP(uint64_t initial_capacity)
+{
+    // a power of two, and at least 2 so that hash() never shifts by 64
+    for (min_capacity = 2; min_capacity < initial_capacity; min_capacity <<= 1);
+
+    key = NULL;
+    value = NULL;
+    allocate(min_capacity);
+}
+
+FLAT_MAP::~FLAT_MAP()
+{
+    delete[] key;
+    delete[] value;
+}
+
+void FLAT_MAP::allocate(uint64_t new_capacity)
+{
+    delete[] key;
+    delete[] value;
+
+    capacity = new_capacity;
+    occupancy = 0;
+    for (log2_capacity = 0; (1ULL << log2_capacity) < capacity; log2_capacity++);
+
+    key = new uint64_t[capacity];
+    value = new uint64_t[capacity];
+    memset(key, 0xFF, capacity*sizeof(uint64_t)); // FLAT_MAP_EMPTY
+}
+
+void FLAT_MAP::grow()
+{
+    uint64_t *old_key = key, *old_value = value,
+             old_capacity = capacity;
+
+    key = NULL;
+    value = NULL;
+    allocate(2*old_capacity);
+
+    for (uint64_t i=0; i<old_capacity; i++)
+        if (old_key[i] != FLAT_MAP_EMPTY)
+            insert(old_key[i], old_value[i]);
+
+    delete[] old_key;
+    delete[] old_value;
+}
+
+uint64_t &FLAT_MAP::insert(uint64_t k, uint64_t v)
+{
+    uint64_t slot = hash(k);
+    for (; key[slot] != FLAT_MAP_EMPTY; slot = (slot + 1) & (capacity - 1))
+        if (key[slot] == k)
+            return value[slot];
+
+    if (2*(occupancy + 1) > capacity) {
+        grow();
+        return insert(k, v);
+    }
+
+    key[slot] = k;
+    value[slot] = v;
+    occupancy++;
+
+    return value[slot];
+}
+
+void FLAT_MAP::erase(uint64_t k)
+{
+    uint64_t slot = hash(k);
+    for (; key[slot] != k; slot = (slot + 1) & (capacity - 1))
+        if (key[slot] == FLAT_MAP_EMPTY)
+            return;
+
+    // move back every following entry that probed past the freed slot
+    uint64_t hole = slot;
+    for (slot = (slot + 1) & (capacity - 1); key[slot] != FLAT_MAP_EMPTY; slot = (slot + 1) & (capacity - 1)) {
+        uint64_t home = hash(key[slot]);
+        if (((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1))) {
+            key[hole] = key[slot];
+            value[hole] = value[slot];
+            hole = slot;
+        }
+    }
+
+    key[hole] = FLAT_MAP_EMPTY;
+    occupancy--;
+}
+
+void FLAT_MAP::clear()
+{
+    allocate(min_capacity);
+}
+
+PAGE_CLOCK::PAGE_CLOCK()
+{
+    clear();
+}
+
+uint64_t PAGE_CLOCK::add(uint32_t owner, uint64_t frame_vpage, uint64_t frame_ppage)
+{
+    vpage.push_back(frame_vpage);
+    ppage.push_back(frame_ppage);
+    cpu.push_back(owner);
+    referenced.push_back(1);
+
+    return vpage.size() - 1;
+}
+
+void PAGE_CLOCK::clear()
+{
+    vpage.clear();
+    ppage.clear();
+    cpu.clear();
+    referenced.clear();
+
+    hand = 0;
+    swaps = 0;
+    scanned = 0;
+    second_chances = 0;
+}
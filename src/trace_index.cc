@@ -0,0 +1,266 @@
+#include "trace_index.h"
+
+#include <sys/stat.h>
+
+#include <zlib.h>
+#include <lzma.h>
+
+#define TRACE_INDEX_CHUNK (1 << 16)
+
+static uint64_t file_size(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return st.st_size;
+}
+
+TRACE_INDEX::TRACE_INDEX()
+{
+    format = TRACE_FORMAT_GZIP;
+    trace_size = 0;
+}
+
+TRACE_INDEX::~TRACE_INDEX()
+{
+    clear();
+}
+
+void TRACE_INDEX::clear()
+{
+    for (uint32_t i=0; i<point.size(); i++)
+        free(point[i].window);
+    point.clear();
+}
+
+int TRACE_INDEX::build(const char *trace_path, int trace_format, uint64_t span)
+{
+    clear();
+    format = trace_format;
+    trace_size = file_size(trace_path);
+
+    FILE *trace = fopen(trace_path, "rb");
+    if (trace == NULL)
+        return 0;
+
+    int result = 0;
+    if (format == TRACE_FORMAT_GZIP)
+        result = build_gzip(trace, span);
+    else if (format == TRACE_FORMAT_XZ)
+        result = build_xz(trace);
+
+    fclose(trace);
+    return result;
+}
+
+int TRACE_INDEX::build_gzip(FILE *trace, uint64_t span)
+{
+    // same approach as zlib's examples/zran.c: inflate with Z_BLOCK so we stop at
+    // every deflate block boundary, and keep the last 32KB of output around
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK) // 47 = 32 + 15, detect the gzip header
+        return 0;
+
+    uint8_t *input = (uint8_t *)malloc(TRACE_INDEX_CHUNK);
+    uint8_t *window = (uint8_t *)malloc(TRACE_INDEX_WINDOW);
+
+    uint64_t total_in = 0, total_out = 0, last = 0;
+    int ret = Z_OK, result = 1;
+
+    strm.avail_out = 0;
+    while (result) {
+        if (strm.avail_in == 0) {
+            strm.avail_in = fread(input, 1, TRACE_INDEX_CHUNK, trace);
+            strm.next_in = input;
+            if (strm.avail_in == 0)
+                break;
+        }
+
+        if (strm.avail_out == 0) {
+            strm.avail_out = TRACE_INDEX_WINDOW;
+            strm.next_out = window;
+        }
+
+        total_in += strm.avail_in;
+        total_out += strm.avail_out;
+        ret = inflate(&strm, Z_BLOCK);
+        total_in -= strm.avail_in;
+        total_out -= strm.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            // another gzip member may follow
+            inflateReset(&strm);
+            continue;
+        }
+        if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+            cerr << "[TRACE_INDEX] gzip error " << ret << " at compressed offset " << total_in << endl;
+            result = 0;
+            break;
+        }
+
+        // at the end of a deflate block that is not the last one
+        if ((strm.data_type & 128) && !(strm.data_type & 64) && (total_out > 0) && ((total_out - last) >= span)) {
+            TRACE_INDEX_POINT p;
+            p.uncompressed_offset = total_out;
+            p.compressed_offset = total_in;
+            p.bits = strm.data_type & 7;
+            p.window_size = TRACE_INDEX_WINDOW;
+            p.window = (uint8_t *)malloc(TRACE_INDEX_WINDOW);
+
+            // the window is circular, rotate it so the oldest byte comes first
+            uint32_t left = strm.avail_out;
+            if (left)
+                memcpy(p.window, window + TRACE_INDEX_WINDOW - left, left);
+            if (left < TRACE_INDEX_WINDOW)
+                memcpy(p.window + left, window, TRACE_INDEX_WINDOW - left);
+
+            point.push_back(p);
+            last = total_out;
+        }
+    }
+
+    inflateEnd(&strm);
+    free(input);
+    free(window);
+
+    return result;
+}
+
+int TRACE_INDEX::build_xz(FILE *trace)
+{
+    // let liblzma find and merge the indexes of every stream in the file
+    lzma_stream strm = LZMA_STREAM_INIT;
+    lzma_index *index = NULL;
+    if (lzma_file_info_decoder(&strm, &index, UINT64_MAX, trace_size) != LZMA_OK)
+        return 0;
+
+    uint8_t *input = (uint8_t *)malloc(TRACE_INDEX_CHUNK);
+    int result = 0;
+
+    while (1) {
+        if (strm.avail_in == 0) {
+            strm.avail_in = fread(input, 1, TRACE_INDEX_CHUNK, trace);
+            strm.next_in = input;
+        }
+
+        lzma_ret ret = lzma_code(&strm, LZMA_RUN);
+        if (ret == LZMA_SEEK_NEEDED) {
+            fseeko(trace, strm.seek_pos, SEEK_SET);
+            strm.avail_in = 0;
+        }
+        else if (ret == LZMA_STREAM_END) {
+            result = 1;
+            break;
+        }
+        else if (ret != LZMA_OK) {
+            cerr << "[TRACE_INDEX] xz error " << ret << " while reading the stream index" << endl;
+            break;
+        }
+    }
+
+    if (result) {
+        lzma_index_iter iter;
+        lzma_index_iter_init(&iter, index);
+        while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+            TRACE_INDEX_POINT p;
+            p.uncompressed_offset = iter.block.uncompressed_file_offset;
+            p.compressed_offset = iter.block.compressed_file_offset;
+            p.bits = iter.stream.flags->check;
+            p.window_size = 0;
+            p.window = NULL;
+            point.push_back(p);
+        }
+        lzma_index_end(index, NULL);
+    }
+
+    lzma_end(&strm);
+    free(input);
+
+    return result;
+}
+
+int TRACE_INDEX::save(const char *index_path)
+{
+    FILE *f = fopen(index_path, "wb");
+    if (f == NULL)
+        return 0;
+
+    uint64_t magic = TRACE_INDEX_MAGIC, num_points = point.size();
+    uint32_t index_format = format;
+    fwrite(&magic, sizeof(magic), 1, f);
+    fwrite(&index_format, sizeof(index_format), 1, f);
+    fwrite(&trace_size, sizeof(trace_size), 1, f);
+    fwrite(&num_points, sizeof(num_points), 1, f);
+
+    for (uint32_t i=0; i<point.size(); i++) {
+        fwrite(&point[i].uncompressed_offset, sizeof(uint64_t), 1, f);
+        fwrite(&point[i].compressed_offset, sizeof(uint64_t), 1, f);
+        fwrite(&point[i].bits, sizeof(uint32_t), 1, f);
+        fwrite(&point[i].window_size, sizeof(uint32_t), 1, f);
+        if (point[i].window_size)
+            fwrite(point[i].window, 1, point[i].window_size, f);
+    }
+
+    int result = !ferror(f);
+    fclose(f);
+    return result;
+}
+
+int TRACE_INDEX::load(const char *index_path, const char *trace_path, int trace_format)
+{
+    clear();
+
+    FILE *f = fopen(index_path, "rb");
+    if (f == NULL)
+        return 0;
+
+    uint64_t magic = 0, num_points = 0;
+    uint32_t index_format = 0;
+    int ok = (fread(&magic, sizeof(magic), 1, f) == 1) && (magic == TRACE_INDEX_MAGIC)
+          && (fread(&index_format, sizeof(index_format), 1, f) == 1) && ((int)index_format == trace_format)
+          && (fread(&trace_size, sizeof(trace_size), 1, f) == 1) && (trace_size == file_size(trace_path))
+          && (fread(&num_points, sizeof(num_points), 1, f) == 1);
+
+    for (uint64_t i=0; ok && (i<num_points); i++) {
+        TRACE_INDEX_POINT p;
+        p.window = NULL;
+        ok = (fread(&p.uncompressed_offset, sizeof(uint64_t), 1, f) == 1)
+          && (fread(&p.compressed_offset, sizeof(uint64_t), 1, f) == 1)
+          && (fread(&p.bits, sizeof(uint32_t), 1, f) == 1)
+          && (fread(&p.window_size, sizeof(uint32_t), 1, f) == 1)
+          && (p.window_size <= TRACE_INDEX_WINDOW);
+
+        if (ok && p.window_size) {
+            p.window = (uint8_t *)malloc(p.window_size);
+            ok = (fread(p.window, 1, p.window_size, f) == p.window_size);
+        }
+
+        point.push_back(p);
+    }
+
+    fclose(f);
+
+    format = trace_format;
+    if (!ok)
+        clear();
+
+    return ok;
+}
+
+int TRACE_INDEX::find(uint64_t uncompressed_offset)
+{
+    // points are sorted by offset
+    int lo = 0, hi = (int)point.size() - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (point[mid].uncompressed_offset <= uncompressed_offset) {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    return found;
+}
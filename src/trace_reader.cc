@@ -0,0 +1,527 @@
+#include "trace_reader.h"
+
+#include <chrono>
+
+TRACE_READER::TRACE_READER()
+{
+    path[0] = '\0';
+    format = TRACE_FORMAT_GZIP;
+    record_size = 0;
+
+    records = NULL;
+    wrap = NULL;
+    tail = 0;
+    cached_head = 0;
+    head = 0;
+    cached_tail = 0;
+    stop = 0;
+
+    skip_instructions = 0;
+    skip_with_index = 0;
+
+    raw_file = NULL;
+    source_in = NULL;
+    memset(&gz_stream, 0, sizeof(gz_stream));
+    lzma_stream init_stream = LZMA_STREAM_INIT;
+    xz_stream = init_stream;
+    source_open = 0;
+
+    gz_raw = 0;
+    gz_trailer = 0;
+    xz_block = -1;
+
+    stage = NULL;
+    stage_begin = 0;
+    stage_end = 0;
+    compact = 0;
+    compact_state = NULL;
+}
+
+TRACE_READER::~TRACE_READER()
+{
+    close();
+}
+
+int TRACE_READER::detect_format(const char *trace_path)
+{
+    const char *last_dot = strrchr(trace_path, '.');
+    if (last_dot == NULL)
+        return -1;
+
+    if (last_dot[1] == 'g') // gzip
+        return TRACE_FORMAT_GZIP;
+    else if (last_dot[1] == 'x') // xz
+        return TRACE_FORMAT_XZ;
+    else if (last_dot[1] == 'z') // zstd
+        return TRACE_FORMAT_ZSTD;
+
+    return -1;
+}
+
+int TRACE_READER::open(const char *trace_path, int trace_format, size_t size, uint64_t skip)
+{
+    snprintf(path, sizeof(path), "%s", trace_path);
+    format = trace_format;
+    record_size = size;
+    skip_instructions = skip;
+
+    if (!open_source())
+        return 0;
+
+    // compact traces carry decoder state from the start, so they can only be fast-forwarded
+    if (skip_instructions && !compact) {
+        char index_path[1100];
+        snprintf(index_path, sizeof(index_path), "%s.idx", path);
+        skip_with_index = index.load(index_path, path, format);
+    }
+
+    records = (uint8_t *)malloc(TRACE_READER_RING_SIZE * record_size);
+    wrap = (uint8_t *)calloc(TRACE_READER_RING_SIZE, sizeof(uint8_t));
+    assert(records && wrap);
+
+    worker = std::thread(&TRACE_READER::run, this);
+
+    return 1;
+}
+
+int TRACE_READER::read(void *dest)
+{
+    uint64_t h = head.load(std::memory_order_relaxed);
+
+    // only touch the producer's index when the records we already know about are used up
+    while (h == cached_tail) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if (h == cached_tail)
+            std::this_thread::yield();
+    }
+
+    uint64_t slot = h & (TRACE_READER_RING_SIZE - 1);
+    int is_record = !wrap[slot];
+    if (is_record)
+        memcpy(dest, records + slot*record_size, record_size);
+
+    head.store(h + 1, std::memory_order_release);
+
+    return is_record;
+}
+
+void TRACE_READER::close()
+{
+    stop = 1;
+    if (worker.joinable())
+        worker.join();
+
+    close_source();
+
+    free(records);
+    free(wrap);
+    free(source_in);
+    free(stage);
+    records = NULL;
+    wrap = NULL;
+    source_in = NULL;
+    stage = NULL;
+
+    delete compact_state;
+    compact_state = NULL;
+}
+
+int TRACE_READER::open_source()
+{
+    if (source_in == NULL)
+        source_in = (uint8_t *)malloc(TRACE_READER_CHUNK);
+
+    if (format == TRACE_FORMAT_ZSTD) {
+        // no in-process zstd decoder yet, but the pipe is still drained off the simulation thread
+        if (access(path, R_OK) != 0)
+            return 0;
+
+        char command[1100];
+        snprintf(command, sizeof(command), "zstd -dc %s", path);
+        raw_file = popen(command, "r");
+        if (raw_file == NULL)
+            return 0;
+    }
+    else {
+        raw_file = fopen(path, "rb");
+        if (raw_file == NULL)
+            return 0;
+    }
+
+    if (format == TRACE_FORMAT_GZIP) {
+        memset(&gz_stream, 0, sizeof(gz_stream));
+        if (inflateInit2(&gz_stream, 47) != Z_OK) { // 47 = 32 + 15, detect the gzip header
+            fclose(raw_file);
+            raw_file = NULL;
+            return 0;
+        }
+        gz_raw = 0;
+        gz_trailer = 0;
+    }
+    else if (format == TRACE_FORMAT_XZ) {
+        lzma_stream init_stream = LZMA_STREAM_INIT;
+        xz_stream = init_stream;
+        if (lzma_stream_decoder(&xz_stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            fclose(raw_file);
+            raw_file = NULL;
+            return 0;
+        }
+        xz_block = -1;
+    }
+
+    source_open = 1;
+
+    // peek at the start of the trace to see which record format it uses
+    if (stage == NULL)
+        stage = (uint8_t *)malloc(TRACE_READER_STAGE_SIZE);
+    stage_begin = 0;
+    stage_end = 0;
+
+    uint64_t magic = 0;
+    if (fill_stage(sizeof(magic)) >= sizeof(magic))
+        memcpy(&magic, stage, sizeof(magic));
+
+    compact = (magic == COMPACT_TRACE_MAGIC);
+    if (compact) {
+#ifdef DATA_TRACE
+        if (record_size != sizeof(input_instr)) {
+            cerr << endl << "*** COMPACT TRACES CANNOT BE USED WITH -cloudsuite: " << path << " ***" << endl;
+            assert(0);
+        }
+#else
+        cerr << endl << "*** COMPACT TRACE REQUIRES A DATA_TRACE BUILD: " << path << " ***" << endl;
+        assert(0);
+#endif
+        stage_begin += sizeof(magic);
+
+        if (compact_state == NULL)
+            compact_state = new COMPACT_TRACE();
+        compact_state->reset();
+    }
+
+    return 1;
+}
+
+int TRACE_READER::open_source_at(int index_point)
+{
+    TRACE_INDEX_POINT *p = &index.point[index_point];
+
+    raw_file = fopen(path, "rb");
+    if (raw_file == NULL)
+        return 0;
+
+    stage_begin = 0;
+    stage_end = 0;
+    compact = 0;
+
+    if (format == TRACE_FORMAT_GZIP) {
+        // resume raw deflate in the middle of the stream, priming the bits of the
+        // partially consumed byte and the 32KB window saved in the index
+        memset(&gz_stream, 0, sizeof(gz_stream));
+        if (inflateInit2(&gz_stream, -15) != Z_OK) {
+            fclose(raw_file);
+            raw_file = NULL;
+            return 0;
+        }
+        source_open = 1;
+
+        fseeko(raw_file, p->compressed_offset - (p->bits ? 1 : 0), SEEK_SET);
+        if (p->bits) {
+            int byte = getc(raw_file);
+            if (byte == EOF)
+                return 0;
+            inflatePrime(&gz_stream, p->bits, byte >> (8 - p->bits));
+        }
+        inflateSetDictionary(&gz_stream, p->window, p->window_size);
+
+        gz_raw = 1;
+        gz_trailer = 0;
+        return 1;
+    }
+
+    source_open = 1;
+    return open_xz_block(index_point);
+}
+
+int TRACE_READER::open_xz_block(int index_point)
+{
+    TRACE_INDEX_POINT *p = &index.point[index_point];
+
+    // each block is decoded on its own, then we move on to the next indexed block
+    uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+    fseeko(raw_file, p->compressed_offset, SEEK_SET);
+    if (fread(header, 1, 1, raw_file) != 1)
+        return 0;
+
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    lzma_block block;
+    memset(&block, 0, sizeof(block));
+    block.version = 1;
+    block.check = (lzma_check)p->bits;
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(header[0]);
+
+    if (fread(header + 1, 1, block.header_size - 1, raw_file) != block.header_size - 1)
+        return 0;
+    if (lzma_block_header_decode(&block, NULL, header) != LZMA_OK)
+        return 0;
+
+    lzma_end(&xz_stream);
+    lzma_stream init_stream = LZMA_STREAM_INIT;
+    xz_stream = init_stream;
+    lzma_ret ret = lzma_block_decoder(&xz_stream, &block);
+
+    for (int i=0; filters[i].id != LZMA_VLI_UNKNOWN; i++)
+        free(filters[i].options);
+
+    xz_block = index_point;
+    return ret == LZMA_OK;
+}
+
+size_t TRACE_READER::read_source(uint8_t *dest, size_t size)
+{
+    if (format == TRACE_FORMAT_GZIP) {
+        gz_stream.next_out = dest;
+        gz_stream.avail_out = size;
+
+        while (gz_stream.avail_out) {
+            if (gz_stream.avail_in == 0) {
+                gz_stream.next_in = source_in;
+                gz_stream.avail_in = fread(source_in, 1, TRACE_READER_CHUNK, raw_file);
+                if (gz_stream.avail_in == 0)
+                    break;
+            }
+
+            // after a raw deflate stream ends, step over the gzip trailer to the next member
+            if (gz_trailer) {
+                uint32_t skipped = (gz_trailer < gz_stream.avail_in) ? gz_trailer : gz_stream.avail_in;
+                gz_stream.next_in += skipped;
+                gz_stream.avail_in -= skipped;
+                gz_trailer -= skipped;
+                continue;
+            }
+
+            int ret = inflate(&gz_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                if (gz_raw) {
+                    gz_raw = 0;
+                    gz_trailer = 8;
+                    inflateReset2(&gz_stream, 47);
+                }
+                else
+                    inflateReset(&gz_stream);
+            }
+            else if (ret == Z_DATA_ERROR) // garbage after the last member, gzip ignores it too
+                break;
+            else if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+                cerr << endl << "*** CANNOT DECODE TRACE FILE: " << path << " (zlib error " << ret << ") ***" << endl;
+                assert(0);
+            }
+        }
+
+        return size - gz_stream.avail_out;
+    }
+    else if (format == TRACE_FORMAT_XZ) {
+        xz_stream.next_out = dest;
+        xz_stream.avail_out = size;
+
+        while (xz_stream.avail_out) {
+            if ((xz_stream.avail_in == 0) && !feof(raw_file)) {
+                xz_stream.next_in = source_in;
+                xz_stream.avail_in = fread(source_in, 1, TRACE_READER_CHUNK, raw_file);
+            }
+
+            lzma_ret ret = lzma_code(&xz_stream, feof(raw_file) ? LZMA_FINISH : LZMA_RUN);
+            if ((ret == LZMA_STREAM_END) && (xz_block >= 0) && ((uint32_t)(xz_block + 1) < index.point.size())) {
+                // done with this block, continue with the next one
+                uint8_t *next_out = xz_stream.next_out;
+                size_t avail_out = xz_stream.avail_out;
+                if (!open_xz_block(xz_block + 1)) {
+                    cerr << endl << "*** CANNOT SEEK IN TRACE FILE: " << path << " ***" << endl;
+                    assert(0);
+                }
+                xz_stream.next_out = next_out;
+                xz_stream.avail_out = avail_out;
+                continue;
+            }
+            if ((ret == LZMA_STREAM_END) || (ret == LZMA_BUF_ERROR)) // end of trace (or truncated trace)
+                break;
+            if (ret != LZMA_OK) {
+                cerr << endl << "*** CANNOT DECODE TRACE FILE: " << path << " (lzma error " << ret << ") ***" << endl;
+                assert(0);
+            }
+        }
+
+        return size - xz_stream.avail_out;
+    }
+
+    return fread(dest, 1, size, raw_file);
+}
+
+void TRACE_READER::close_source()
+{
+    if (!source_open)
+        return;
+
+    if (format == TRACE_FORMAT_GZIP) {
+        inflateEnd(&gz_stream);
+        fclose(raw_file);
+    }
+    else if (format == TRACE_FORMAT_XZ) {
+        lzma_end(&xz_stream);
+        fclose(raw_file);
+    }
+    else
+        pclose(raw_file);
+
+    raw_file = NULL;
+    xz_block = -1;
+
+    source_open = 0;
+}
+
+size_t TRACE_READER::fill_stage(size_t wanted)
+{
+    if ((stage_end - stage_begin) >= wanted)
+        return stage_end - stage_begin;
+
+    // slide what is left to the front and top the buffer up
+    memmove(stage, stage + stage_begin, stage_end - stage_begin);
+    stage_end -= stage_begin;
+    stage_begin = 0;
+
+    while (stage_end < wanted) {
+        size_t bytes = read_source(stage + stage_end, TRACE_READER_STAGE_SIZE - stage_end);
+        if (bytes == 0)
+            break;
+        stage_end += bytes;
+    }
+
+    return stage_end - stage_begin;
+}
+
+size_t TRACE_READER::read_record(uint8_t *dest)
+{
+    if (compact) {
+#ifdef DATA_TRACE
+        if (fill_stage(COMPACT_TRACE_MAX_RECORD) == 0)
+            return 0;
+
+        const uint8_t *next = compact_state->decode(stage + stage_begin, stage + stage_end, (input_instr *)dest);
+        if (next == NULL) // truncated record at the end of the trace
+            return 0;
+
+        stage_begin = next - stage;
+        return record_size;
+#endif
+    }
+
+    // old format, hand over whatever was peeked before reading straight from the source
+    size_t staged = stage_end - stage_begin;
+    if (staged > record_size)
+        staged = record_size;
+    memcpy(dest, stage + stage_begin, staged);
+    stage_begin += staged;
+
+    if (staged == record_size)
+        return record_size;
+
+    return staged + read_source(dest + staged, record_size - staged);
+}
+
+uint8_t *TRACE_READER::reserve_slot()
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+
+    while ((t - cached_head) == TRACE_READER_RING_SIZE) {
+        if (stop)
+            return NULL;
+
+        cached_head = head.load(std::memory_order_acquire);
+        if ((t - cached_head) == TRACE_READER_RING_SIZE)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    return records + (t & (TRACE_READER_RING_SIZE - 1))*record_size;
+}
+
+void TRACE_READER::skip_records(uint64_t count)
+{
+    if (skip_with_index) {
+        uint64_t target = count * record_size;
+        int p = index.find(target);
+        if ((p >= 0) && (index.point[p].uncompressed_offset > 0)) {
+            close_source();
+            if (!open_source_at(p)) {
+                cerr << endl << "*** CANNOT SEEK IN TRACE FILE: " << path << " ***" << endl;
+                assert(0);
+            }
+
+            // the indexed point is in the middle of a record, so realign to record boundaries
+            uint64_t offset = index.point[p].uncompressed_offset;
+            uint64_t first = (offset + record_size - 1) / record_size;
+            uint64_t discard = first*record_size - offset;
+            while (discard) {
+                size_t chunk = (discard < TRACE_READER_STAGE_SIZE) ? discard : TRACE_READER_STAGE_SIZE;
+                if (read_source(stage, chunk) < chunk)
+                    break;
+                discard -= chunk;
+            }
+
+            count -= first;
+        }
+    }
+
+    // decode and drop the rest
+    uint8_t *record = (uint8_t *)malloc(record_size);
+    while (count && !stop) {
+        if (read_record(record) < record_size) {
+            close_source();
+            if (!open_source()) {
+                cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << path << " ***" << endl;
+                assert(0);
+            }
+            continue;
+        }
+        count--;
+    }
+    free(record);
+}
+
+void TRACE_READER::run()
+{
+    if (skip_instructions)
+        skip_records(skip_instructions);
+
+    while (!stop) {
+        if (!source_open && !open_source()) {
+            cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << path << " ***" << endl;
+            assert(0);
+        }
+
+        // decode straight into the ring until the trace runs out
+        while (1) {
+            uint8_t *slot = reserve_slot();
+            if (slot == NULL)
+                return;
+
+            // a partial record at the end of the trace is dropped, like a short fread
+            if (read_record(slot) < record_size)
+                break;
+
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            wrap[t & (TRACE_READER_RING_SIZE - 1)] = 0;
+            tail.store(t + 1, std::memory_order_release);
+        }
+
+        close_source();
+
+        // tell the core the trace wrapped around, then start over
+        if (reserve_slot() == NULL)
+            return;
+
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        wrap[t & (TRACE_READER_RING_SIZE - 1)] = 1;
+        tail.store(t + 1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,287 @@
+#include "../inc/compression/bdi.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <random>
+
+// Differential test of bdi::BDICompress on 64-byte lines against the BDI implementation it
+// replaced, kept here verbatim. Build with -mavx2 to test the AVX2 kernel.
+
+namespace legacy_bdi {
+
+inline unsigned long long my_llabs(long long x) {
+    unsigned long long t = x >> 63;
+    return (x ^ t) - t;
+}
+
+inline unsigned my_abs(int x) {
+    unsigned t = x >> 31;
+    return (x ^ t) - t;
+}
+
+inline long long unsigned *convertBuffer2Array(char *buffer, unsigned size, unsigned step) {
+    long long unsigned *values = (long long unsigned *)malloc(sizeof(long long unsigned) * size / step);
+
+    //init
+    unsigned int i, j;
+    for (i = 0; i < size / step; i++)
+        values[i] = 0; // Initialize all elements to zero.
+
+    for (i = 0; i < size; i += step)
+        for (j = 0; j < step; j++)
+            values[i / step] += (long long unsigned)((unsigned char)buffer[i + j]) << (8 * j);
+
+    return values;
+}
+
+///
+/// Check if the cache line consists of only zero values
+///
+inline int isZeroPackable(long long unsigned *values, unsigned size) {
+    int nonZero = 0;
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        if (values[i] != 0) {
+            nonZero = 1;
+            break;
+        }
+    }
+    return !nonZero;
+}
+
+///
+/// Check if the cache line consists of only same values
+///
+inline int isSameValuePackable(long long unsigned *values, unsigned size) {
+    int notSame = 0;
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        if (values[0] != values[i]) {
+            notSame = 1;
+            break;
+        }
+    }
+    return !notSame;
+}
+
+///
+/// Check if the cache line values can be compressed with multiple base + 1,2,or 4-byte offset
+/// Returns size after compression
+///
+inline unsigned doubleExponentCompression(long long unsigned *values, unsigned size, unsigned blimit, unsigned bsize) {
+    unsigned long long limit = 0;
+    //define the appropriate size for the mask
+    switch (blimit) {
+    case 1:
+        limit = 56;
+        break;
+    case 2:
+        limit = 48;
+        break;
+    default:
+        // std::cout << "Wrong blimit value = " <<  blimit << std::endl;
+        exit(1);
+    }
+    // finding bases: # BASES
+    // find how many elements can be compressed with mbases
+    unsigned compCount = 0;
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        if ((values[0] >> limit) == (values[i] >> limit)) {
+            compCount++;
+        }
+    }
+    //return compressed size
+    if (compCount != size)
+        return size * bsize;
+    return size * bsize - (compCount - 1) * blimit;
+}
+
+///
+/// Check if the cache line values can be compressed with multiple base + 1,2,or 4-byte offset
+/// Returns size after compression
+///
+inline unsigned multBaseCompression(long long unsigned *values, unsigned size, unsigned blimit, unsigned bsize) {
+    unsigned long long limit = 0;
+    unsigned BASES = 2;
+    //define the appropriate size for the mask
+    switch (blimit) {
+    case 1:
+        limit = 0xFF;
+        break;
+    case 2:
+        limit = 0xFFFF;
+        break;
+    case 4:
+        limit = 0xFFFFFFFF;
+        break;
+    default:
+        //std::cout << "Wrong blimit value = " <<  blimit << std::endl;
+        exit(1);
+    }
+    // finding bases: # BASES
+    //std::vector<unsigned long long> mbases;
+    //mbases.push_back(values[0]); //add the first base
+    unsigned long long mbases[64];
+    unsigned baseCount = 1;
+    mbases[0] = 0;
+    unsigned int i, j;
+    for (i = 0; i < size; i++) {
+        for (j = 0; j < baseCount; j++) {
+            if (my_llabs((long long int)(mbases[j] - values[i])) > limit) {
+                //mbases.push_back(values[i]); // add new base
+                mbases[baseCount++] = values[i];
+            }
+        }
+        if (baseCount >= BASES) //we don't have more bases
+            break;
+    }
+    // find how many elements can be compressed with mbases
+    unsigned compCount = 0;
+    for (i = 0; i < size; i++) {
+        //ol covered = 0;
+        for (j = 0; j < baseCount; j++) {
+            if (my_llabs((long long int)(mbases[j] - values[i])) <= limit) {
+                compCount++;
+                break;
+            }
+        }
+    }
+    //return compressed size
+    unsigned mCompSize = blimit * compCount + bsize * (BASES - 1) + (size - compCount) * bsize;
+    if (compCount < size)
+        return size * bsize;
+    return mCompSize;
+}
+
+inline unsigned BDICompress(char *buffer, unsigned _blockSize) {
+    long long unsigned *values = convertBuffer2Array(buffer, _blockSize, 8);
+    unsigned bestCSize = _blockSize;
+    unsigned currCSize = _blockSize;
+    if (isZeroPackable(values, _blockSize / 8))
+        bestCSize = 1;
+    if (isSameValuePackable(values, _blockSize / 8))
+        currCSize = 8;
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    currCSize = multBaseCompression(values, _blockSize / 8, 1, 8);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    currCSize = multBaseCompression(values, _blockSize / 8, 2, 8);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    currCSize = multBaseCompression(values, _blockSize / 8, 4, 8);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    free(values);
+    values = convertBuffer2Array(buffer, _blockSize, 4);
+    if (isSameValuePackable(values, _blockSize / 4))
+        currCSize = 4;
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    currCSize = multBaseCompression(values, _blockSize / 4, 1, 4);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    currCSize = multBaseCompression(values, _blockSize / 4, 2, 4);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    free(values);
+    values = convertBuffer2Array(buffer, _blockSize, 2);
+    currCSize = multBaseCompression(values, _blockSize / 2, 1, 2);
+    bestCSize = bestCSize > currCSize ? currCSize : bestCSize;
+    free(values);
+
+    buffer = NULL;
+    values = NULL;
+    return bestCSize;
+}
+
+};
+
+static uint64_t lines_checked = 0, size_count[65];
+
+static void check_line(const char *line) {
+    char copy[64];
+    memcpy(copy, line, 64);
+
+    unsigned expected = legacy_bdi::BDICompress(copy, 64),
+             actual = bdi::BDICompress(line, 64);
+    if (actual != expected) {
+        std::cout << "size " << actual << " expected " << expected << " for line";
+        for (int i = 0; i < 64; i++)
+            std::cout << " " << std::hex << (unsigned) (uint8_t) line[i] << std::dec;
+        std::cout << std::endl;
+    }
+    assert(actual == expected);
+
+    lines_checked++;
+    size_count[expected]++;
+}
+
+// word values close to the delta limits, where the old and new comparisons could disagree
+static uint64_t edge_value(std::mt19937_64 &rng, unsigned word_size) {
+    static const uint64_t limits[] = { 0, 0xFF, 0xFFFF, 0xFFFFFFFF };
+    uint64_t mask = (word_size == 8) ? UINT64_MAX : ((1ULL << (8*word_size)) - 1),
+             v = limits[rng() % 4] + (rng() % 5) - 2;
+    if (rng() % 2)
+        v = 0 - v;
+    return v & mask;
+}
+
+static void put_word(char *line, unsigned index, unsigned word_size, uint64_t v) {
+    memcpy(line + index*word_size, &v, word_size);
+}
+
+int main() {
+    std::cout << "BDI TEST" << std::endl;
+    std::mt19937_64 rng(1);
+    char line[64];
+
+    // zero and repeated lines
+    memset(line, 0, 64);
+    check_line(line);
+    memset(line, 0xFF, 64);
+    check_line(line);
+    for (unsigned word_size = 1; word_size <= 8; word_size *= 2) {
+        for (int i = 0; i < 1000; i++) {
+            uint64_t v = rng();
+            for (unsigned w = 0; w < 64/word_size; w++)
+                put_word(line, w, word_size, v);
+            check_line(line);
+        }
+    }
+
+    // a base plus deltas, some words near zero, with every word and delta size
+    for (int i = 0; i < 1000000; i++) {
+        unsigned word_size = 2 << (rng() % 3),
+                 delta_bits = 8 << (rng() % 3);
+        uint64_t base = (rng() % 4) ? rng() : edge_value(rng, word_size);
+        for (unsigned w = 0; w < 64/word_size; w++) {
+            uint64_t delta = rng() & ((1ULL << delta_bits) - 1), v;
+            switch (rng() % 8) {
+                case 0: v = delta; break;                  // near the zero base
+                case 1: v = 0 - delta; break;
+                case 2: v = edge_value(rng, word_size); break;
+                case 3: v = base + (delta >> 1); break;    // usually inside the delta
+                case 4: v = base - (delta >> 1); break;
+                case 5: v = rng(); break;                  // usually breaks the encoding
+                default: v = base + delta - (1ULL << (delta_bits - 1)); break;
+            }
+            if ((rng() % 64) == 0)
+                v = rng();
+            put_word(line, w, word_size, v);
+        }
+        check_line(line);
+    }
+
+    // single bytes over a zero line
+    for (int i = 0; i < 64; i++) {
+        for (int b = 1; b < 256; b++) {
+            memset(line, 0, 64);
+            line[i] = b;
+            check_line(line);
+        }
+    }
+
+    std::cout << lines_checked << " lines, sizes:";
+    for (int i = 0; i <= 64; i++)
+        if (size_count[i])
+            std::cout << " " << i << ":" << size_count[i];
+    std::cout << std::endl;
+
+    std::cout << "all assertions passed" << std::endl;
+}
@@ -0,0 +1,207 @@
+#include "../inc/compression/cpack.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <random>
+
+// Checks cpack::compressed_size and cpack::compress against the bit-at-a-time encoder they
+// replaced, kept here verbatim, and that cpack::decompress restores every line. Build with
+// -mavx2 to test the AVX2 classification.
+
+namespace legacy_cpack {
+
+void set_bit(uint8_t*, int&, bool);
+void set_bit(uint8_t*, int&, bool, bool);
+void set_bit(uint8_t*, int&, bool, bool, bool, bool);
+void set_byte(uint8_t*, int&, uint8_t);
+void set_idx(uint8_t*, int&, int);
+
+// returns size of compressed line in bytes
+int compress(const uint8_t input[64], uint8_t output[68]) {
+	int out_idx = 0;
+	uint8_t dict[64] = {0};
+	int dict_size = 0;
+
+	for(int i = 0; i < 16; i++) {
+		assert(out_idx < 544);
+
+		bool found = false;
+
+		uint8_t a = input[4*i];
+		uint8_t b = input[4*i+1];
+		uint8_t c = input[4*i+2];
+		uint8_t d = input[4*i+3];
+
+		// check against zero patterns
+		if(a == 0 && b == 0 && c == 0) {
+			if (d == 0) { // pattern zzzz ouput (00)
+				set_bit(output, out_idx, 0, 0);
+			} else { // pattern zzzx output (1101)B
+				set_bit(output, out_idx, 1, 1, 0, 1);
+				set_byte(output, out_idx, d);
+			}
+			continue;
+		}
+
+		// check against dictionary
+		for(int j = 0; j < dict_size; j++) {	
+			if(a == dict[4*j] && b == dict[4*j+1]) {
+				if(c == dict[4*j+2]) {
+					if(d == dict[4*j+3]) { // pattern mmmm output (10) bbbb
+						set_bit(output, out_idx, 1, 0);
+						set_idx(output, out_idx, j);
+					} else { // pattern mmmx output (1110)bbbbB
+						set_bit(output, out_idx, 1, 1, 1, 0);
+						set_idx(output, out_idx, j);
+						set_byte(output, out_idx, d);
+					}
+				} else { // pattern mmxx output (1100)bbbbBB
+					set_bit(output, out_idx, 1, 1, 0, 0);
+					set_idx(output, out_idx, j);
+					set_byte(output, out_idx, c);
+					set_byte(output, out_idx, d);
+				}
+				found = true;
+				break;
+			}
+		}
+
+		if(found) {
+			continue;
+		}
+
+		// pattern xxxx output (01)BBBB
+		set_bit(output, out_idx, 0, 1);
+		set_byte(output, out_idx, a);
+		set_byte(output, out_idx, b);
+		set_byte(output, out_idx, c);
+		set_byte(output, out_idx, d);
+
+		// add new pattern to dictionary
+		dict[4*dict_size] = a;
+		dict[4*dict_size+1] = b;
+		dict[4*dict_size+2] = c;
+		dict[4*dict_size+3] = d;
+
+		dict_size += 1;
+	}
+
+	return (out_idx % 8 == 0 ? out_idx / 8 : out_idx / 8 + 1);
+}
+
+void set_bit(uint8_t* output, int& idx, bool a, bool b)
+{
+	set_bit(output, idx, a);
+	set_bit(output, idx, b);
+}
+
+void set_bit(uint8_t* output, int& idx, bool a, bool b, bool c, bool d)
+{
+	set_bit(output, idx, a);
+	set_bit(output, idx, b);
+	set_bit(output, idx, c);
+	set_bit(output, idx, d);
+}
+
+
+void set_byte(uint8_t* output, int& idx, uint8_t byte)
+{
+	set_bit(output, idx, byte & 128);
+	set_bit(output, idx, byte & 64);
+	set_bit(output, idx, byte & 32);
+	set_bit(output, idx, byte & 16);
+	set_bit(output, idx, byte & 8);
+	set_bit(output, idx, byte & 4);
+	set_bit(output, idx, byte & 2);
+	set_bit(output, idx, byte & 1);
+}
+
+void set_idx(uint8_t* output, int& out_idx, int idx)
+{
+	set_bit(output, out_idx, idx & 8);
+	set_bit(output, out_idx, idx & 4);
+	set_bit(output, out_idx, idx & 2);
+	set_bit(output, out_idx, idx & 1);
+}
+
+void set_bit(uint8_t* output, int& idx, bool a)
+{
+	if(a == 0) {
+		output[idx/8] &= ~(1 << (idx%8));
+	} else {
+		output[idx/8] |= 1 << (idx%8);
+	}
+
+	idx++;
+}
+
+};
+
+static uint64_t lines_checked = 0, size_count[69];
+
+static void check_line(const uint8_t *line) {
+    uint8_t expected_output[68] = {0}, output[68] = {0}, restored[64];
+
+    int expected = legacy_cpack::compress(line, expected_output),
+        size = cpack::compress(line, output);
+    assert(size == expected);
+    assert(cpack::compressed_size(line) == expected);
+    assert(memcmp(output, expected_output, sizeof(output)) == 0);
+
+    cpack::decompress(output, restored, 8*size);
+    assert(memcmp(restored, line, 64) == 0);
+
+    lines_checked++;
+    size_count[expected]++;
+}
+
+int main() {
+    std::cout << "CPACK TEST" << std::endl;
+    std::mt19937_64 rng(1);
+    uint8_t line[64];
+
+    memset(line, 0, 64);
+    check_line(line);
+    memset(line, 0xFF, 64);
+    check_line(line);
+
+    // words drawn from a few values that share bytes, to hit every dictionary pattern
+    for (int i = 0; i < 1000000; i++) {
+        uint32_t pool[4];
+        for (int p = 0; p < 4; p++)
+            pool[p] = rng();
+        int spread = 1 + rng() % 4;
+
+        for (int w = 0; w < 16; w++) {
+            uint32_t v = pool[rng() % spread];
+            switch (rng() % 8) {
+                case 0: v = 0; break;
+                case 1: v &= 0xFF000000; break;                                 // zzzx
+                case 2: v = (v & 0x00FFFFFF) | ((uint32_t) rng() << 24); break; // mmmx
+                case 3: v = (v & 0x0000FFFF) | ((uint32_t) rng() << 16); break; // mmxx
+                case 4: v = rng(); break;
+                default: break;                                                 // mmmm
+            }
+            memcpy(line + 4*w, &v, 4);
+        }
+        check_line(line);
+    }
+
+    // incompressible lines
+    for (int i = 0; i < 10000; i++) {
+        for (int w = 0; w < 16; w++) {
+            uint32_t v = rng();
+            memcpy(line + 4*w, &v, 4);
+        }
+        check_line(line);
+    }
+
+    std::cout << lines_checked << " lines, sizes:";
+    for (int i = 0; i <= 68; i++)
+        if (size_count[i])
+            std::cout << " " << i << ":" << size_count[i];
+    std::cout << std::endl;
+
+    std::cout << "all assertions passed" << std::endl;
+}
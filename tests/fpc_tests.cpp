@@ -0,0 +1,123 @@
+#include "../inc/compression/fpc.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <random>
+
+// Checks fpc::compressed_size against a word-at-a-time reference, that fpc::compress writes
+// that many bytes and that fpc::decompress restores every line. Build with -mavx2 to test the
+// AVX2 pattern match.
+
+// bits of the shortest code for a nonzero word
+static unsigned reference_word_bits(uint32_t w) {
+    int32_t s = (int32_t) w;
+    int16_t lo = (int16_t) (w & 0xFFFF), hi = (int16_t) (w >> 16);
+
+    if (s >= -8 && s < 8)
+        return 3 + 4;
+    if ((s >= -128 && s < 128) || (w == (w & 0xFF) * 0x01010101U))
+        return 3 + 8;
+    if ((s >= -32768 && s < 32768) || ((w & 0xFFFF) == 0) || (lo >= -128 && lo < 128 && hi >= -128 && hi < 128))
+        return 3 + 16;
+    return 3 + 32;
+}
+
+static unsigned reference_size(const uint8_t *line) {
+    uint32_t word[16];
+    memcpy(word, line, 64);
+
+    unsigned bits = 0;
+    for (int i = 0; i < 16; i++) {
+        if (word[i] == 0) {
+            int run = 1;
+            while (run < 8 && i + 1 < 16 && word[i + 1] == 0) {
+                run++;
+                i++;
+            }
+            bits += 3 + 3;
+        } else
+            bits += reference_word_bits(word[i]);
+    }
+    return (bits + 7) / 8;
+}
+
+static uint64_t lines_checked = 0, size_count[FPC_MAX_BYTES + 1];
+
+static void check_line(const uint8_t *line) {
+    uint8_t output[FPC_MAX_BYTES], restored[64];
+    memset(output, 0xAA, sizeof(output));
+
+    unsigned expected = reference_size(line),
+             size = fpc::compress(line, output);
+    assert(size == expected);
+    assert(fpc::compressed_size(line) == expected);
+    assert(size <= FPC_MAX_BYTES);
+
+    fpc::decompress(output, restored);
+    assert(memcmp(restored, line, 64) == 0);
+
+    lines_checked++;
+    size_count[expected]++;
+}
+
+static void fill(uint8_t *line, uint32_t w) {
+    for (int i = 0; i < 16; i++)
+        memcpy(line + 4*i, &w, 4);
+}
+
+int main() {
+    std::cout << "FPC TEST" << std::endl;
+    std::mt19937_64 rng(1);
+    uint8_t line[64];
+
+    // one line per pattern: two zero runs, then 16 words of 7, 11, 19 or 35 bits
+    fill(line, 0);
+    check_line(line);
+    assert(fpc::compressed_size(line) == 2);
+    fill(line, 0xFFFFFFF9);
+    assert(fpc::compressed_size(line) == 14);
+    fill(line, 0x7F);
+    assert(fpc::compressed_size(line) == 22);
+    fill(line, 0xABABABAB);
+    assert(fpc::compressed_size(line) == 22);
+    fill(line, 0xFFFF8000);
+    assert(fpc::compressed_size(line) == 38);
+    fill(line, 0x12340000);
+    assert(fpc::compressed_size(line) == 38);
+    fill(line, 0x007FFF80);
+    assert(fpc::compressed_size(line) == 38);
+    fill(line, 0x12345678);
+    assert(fpc::compressed_size(line) == FPC_MAX_BYTES);
+    check_line(line);
+
+    // words drawn from every pattern and from the edges of the sign-extended ranges
+    const uint32_t edges[] = { 7, 8, 0xFFFFFFF8, 0xFFFFFFF7, 127, 128, 0xFFFFFF80, 0xFFFFFF7F,
+                               32767, 32768, 0xFFFF8000, 0xFFFF7FFF, 0x007F0080, 0x00800000 };
+    for (int i = 0; i < 1000000; i++) {
+        for (int w = 0; w < 16; w++) {
+            uint32_t v = rng();
+            switch (rng() % 10) {
+                case 0: case 1: v = 0; break;
+                case 2: v = (int32_t) (v << 28) >> 28; break;
+                case 3: v = (int32_t) (v << 24) >> 24; break;
+                case 4: v = (int32_t) (v << 16) >> 16; break;
+                case 5: v &= 0xFFFF0000; break;
+                case 6: v = ((uint32_t) ((int32_t) (v << 24) >> 24) & 0xFFFF) | ((uint32_t) ((int32_t) (v << 8) >> 24) << 16); break;
+                case 7: v = (v & 0xFF) * 0x01010101U; break;
+                case 8: v = edges[v % (sizeof(edges) / sizeof(edges[0]))]; break;
+                default: break;
+            }
+            memcpy(line + 4*w, &v, 4);
+        }
+        check_line(line);
+    }
+
+    std::cout << lines_checked << " lines, sizes:";
+    for (int i = 0; i <= FPC_MAX_BYTES; i++)
+        if (size_count[i])
+            std::cout << " " << i << ":" << size_count[i];
+    std::cout << std::endl;
+
+    std::cout << "all assertions passed" << std::endl;
+}
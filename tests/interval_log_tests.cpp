@@ -0,0 +1,67 @@
+#include "../inc/interval_log.h"
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <iostream>
+#include <random>
+
+// Writes random intervals to an interval log from sets taking turns at random, as the dumper
+// does, and checks that every set reads back in order and that an unfinished log is refused.
+
+#define SETS 64
+
+int main() {
+    std::cout << "INTERVAL LOG TEST" << std::endl;
+    std::mt19937_64 rng(1);
+    const char *path = "../test_bin/intervals.log";
+
+    vector<LOG_INTERVAL> expected[SETS];
+    uint32_t now[SETS] = {0};
+    INTERVAL_LOG_WRITER writer;
+    assert(writer.open(path, SETS));
+
+    // set 0 stays empty, set 1 fills exactly one block, the rest get a few blocks each
+    for (int i = 0; i < 200000 + INTERVAL_LOG_BLOCK; i++) {
+        uint32_t set = (i < INTERVAL_LOG_BLOCK) ? 1 : 2 + rng() % (SETS - 2);
+        now[set] += rng() % 5;
+        LOG_INTERVAL interval;
+        interval.end = now[set];
+        interval.start = interval.end - rng() % (interval.end + 1);
+        interval.cf = 1 << (rng() % 3);
+        interval.superblock = (rng() % 2) ? rng() >> 20 : expected[set].empty() ? 0 : expected[set].back().superblock + rng() % 3;
+        writer.add(set, interval);
+        expected[set].push_back(interval);
+    }
+
+    // the log cannot be read until it is closed
+    INTERVAL_LOG_READER reader;
+    assert(!reader.open(path));
+    assert(writer.close());
+
+    assert(reader.open(path));
+    assert(reader.num_sets == SETS);
+    vector<LOG_INTERVAL> interval;
+    for (uint32_t set = 0; set < SETS; set++) {
+        assert(reader.count[set] == expected[set].size());
+        assert(reader.read_set(set, interval));
+        assert(interval.size() == expected[set].size());
+        for (uint32_t i = 0; i < interval.size(); i++) {
+            assert(interval[i].start == expected[set][i].start);
+            assert(interval[i].end == expected[set][i].end);
+            assert(interval[i].cf == expected[set][i].cf);
+            assert(interval[i].superblock == expected[set][i].superblock);
+        }
+    }
+    assert(!reader.read_set(SETS, interval));
+
+    // so is a log cut short
+    FILE *file = fopen(path, "r+b");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    assert(truncate(path, size - 1) == 0);
+    assert(!reader.open(path));
+    std::cout << size << " bytes for " << 200000 + INTERVAL_LOG_BLOCK << " intervals" << std::endl;
+
+    std::cout << "all assertions passed" << std::endl;
+}
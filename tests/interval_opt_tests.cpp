@@ -0,0 +1,105 @@
+#include "../inc/interval_opt.h"
+#include <assert.h>
+#include <stdint.h>
+#include <iostream>
+#include <random>
+
+// Checks INTERVAL_OPT on the cases of scripts/interval2ilp_test.py and against every subset of
+// small random sets, for each model.
+
+static vector<OPT_INTERVAL> make_intervals(const vector<vector<uint64_t>> &rows) {
+    vector<OPT_INTERVAL> interval;
+    for (const vector<uint64_t> &row : rows)
+        interval.push_back({row[0], row[1], (row.size() > 3) ? row[3] : 0, (uint32_t) row[2]});
+    return interval;
+}
+
+static uint64_t solve(uint32_t model, uint32_t ways, const vector<OPT_INTERVAL> &interval) {
+    OPT_RESULT result = INTERVAL_OPT(model, ways).solve(interval);
+    assert(result.exact);
+    assert(result.hits == result.bound);
+    return result.hits;
+}
+
+// quarter ways used at time t by the intervals in mask
+static uint32_t quarters_used(uint32_t model, const vector<OPT_INTERVAL> &interval, uint32_t mask, uint64_t t) {
+    map<pair<uint64_t, uint32_t>, uint32_t> count;
+    uint32_t quarters = 0;
+    for (uint32_t i = 0; i < interval.size(); i++) {
+        if (!(mask & (1 << i)) || (t < interval[i].start) || (t >= interval[i].end))
+            continue;
+        if (model == OPT_HETEROGENOUS)
+            quarters += 4 / interval[i].cf;
+        else
+            count[{(model == OPT_SUPERBLOCK) ? interval[i].superblock : 0, interval[i].cf}]++;
+    }
+    for (const auto &c : count)
+        quarters += 4 * ((c.second + c.first.second - 1) / c.first.second);
+    return quarters;
+}
+
+static uint64_t brute_force(uint32_t model, uint32_t ways, const vector<OPT_INTERVAL> &interval, uint64_t horizon) {
+    uint64_t best = 0;
+    for (uint32_t mask = 0; mask < (1U << interval.size()); mask++) {
+        if ((uint64_t) __builtin_popcount(mask) <= best)
+            continue;
+        bool fits = true;
+        for (uint64_t t = 0; fits && (t < horizon); t++)
+            fits = (quarters_used(model, interval, mask, t) <= 4 * ways);
+        if (fits)
+            best = __builtin_popcount(mask);
+    }
+    return best;
+}
+
+int main() {
+    std::cout << "INTERVAL OPT TEST" << std::endl;
+
+    // test_identity_transform
+    vector<OPT_INTERVAL> identity = make_intervals({{0, 1, 4}});
+    assert(solve(OPT_HOMOGENOUS, 2, identity) == 1);
+    assert(solve(OPT_HOMOGENOUS, 1, identity) == 1);
+    assert(solve(OPT_HOMOGENOUS, 0, identity) == 0);
+
+    // test_enhanced_reordering: the x2 lines share a way, the x4 and x1 lines cannot both join them
+    vector<OPT_INTERVAL> reordering = make_intervals({{0, 3, 4}, {2, 7, 2}, {4, 5, 1}, {1, 6, 2}});
+    assert(solve(OPT_HOMOGENOUS, 1, reordering) == 2);
+    assert(solve(OPT_HETEROGENOUS, 1, reordering) == brute_force(OPT_HETEROGENOUS, 1, reordering, 7));
+
+    // lines of different superblocks do not share a way, however compressible
+    vector<OPT_INTERVAL> superblocks = make_intervals({{0, 4, 4, 0}, {1, 5, 4, 1}, {2, 6, 4, 0}});
+    assert(solve(OPT_HOMOGENOUS, 1, superblocks) == 3);
+    assert(solve(OPT_SUPERBLOCK, 1, superblocks) == 2);
+    assert(solve(OPT_SUPERBLOCK, 2, superblocks) == 3);
+
+    std::mt19937_64 rng(1);
+    uint64_t checked = 0, branched = 0;
+    const uint32_t cfs[] = {1, 2, 4};
+    for (int round = 0; round < 6000; round++) {
+        uint32_t model = round % 3, ways = rng() % 4, n = 1 + rng() % 14;
+        uint64_t horizon = 4 + rng() % 20;
+        vector<OPT_INTERVAL> interval;
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t start = rng() % horizon, end = start + 1 + rng() % (horizon - start);
+            interval.push_back({start, end, rng() % 3, cfs[rng() % 3]});
+        }
+
+        OPT_RESULT result = INTERVAL_OPT(model, ways).solve(interval);
+        uint64_t expected = brute_force(model, ways, interval, horizon);
+        assert(result.exact);
+        assert(result.hits == expected);
+        assert(result.bound == expected);
+
+        // a search cut short still brackets OPT
+        OPT_RESULT cut = INTERVAL_OPT(model, ways, 1).solve(interval);
+        assert(cut.hits <= expected);
+        assert(cut.bound >= expected);
+        assert(cut.exact == (cut.hits == cut.bound));
+
+        checked++;
+        branched += (result.nodes > 1);
+    }
+    std::cout << checked << " random sets, " << branched << " needed branching" << std::endl;
+
+    std::cout << "all assertions passed" << std::endl;
+}
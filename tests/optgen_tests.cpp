@@ -2,6 +2,7 @@
 #include <array>
 #include <assert.h>
 #include <iostream>
+#include <random>
 
 struct Interval {
     uint64_t start_interval;
@@ -21,6 +22,62 @@ constexpr std::array<Interval, 6> reuse_access_stream {
     Interval(3, 11, 'C'),
 };
 
+// Drives both buffers through the same random pushes, extends, adds and queries.
+template<typename T, uint32_t capacity> void compare_buffers(std::mt19937_64& rng, int steps) {
+    OptgenRingBuffer<T, capacity> ring;
+    OptgenSegmentTree<T, capacity> tree;
+
+    for (int i = 0; i < steps; i++) {
+        switch (rng() % 4) {
+            case 0:
+                ring.push(0);
+                tree.push(0);
+                break;
+            case 1: {
+                // mostly short steps, sometimes past the whole buffer
+                uint64_t quanta = ring.end_quanta() + 1 + ((rng() % 16) ? rng() % 4 : rng() % (2*capacity));
+                ring.extend(quanta);
+                tree.extend(quanta);
+                break;
+            }
+            default: {
+                if (ring.after_end(0)) break; // empty
+                uint64_t first = ring.head_quanta() + rng() % (ring.end_quanta() - ring.head_quanta() + 1),
+                         last = first + rng() % (ring.end_quanta() - first + 1);
+                if (rng() % 2) {
+                    ring.add(first, last, 1);
+                    tree.add(first, last, 1);
+                }
+                assert(ring.max(first, last) == tree.max(first, last));
+                break;
+            }
+        }
+
+        assert(ring.head_quanta() == tree.head_quanta());
+        assert(ring.end_quanta() == tree.end_quanta());
+        if (!ring.after_end(0)) {
+            uint64_t quanta = ring.head_quanta() + rng() % (ring.end_quanta() - ring.head_quanta() + 1);
+            assert(ring[quanta] == tree[quanta]);
+        }
+    }
+}
+
+// Feeds the same random usage intervals to a cache model over either buffer.
+template<typename RING, typename TREE> void compare_cachegens(std::mt19937_64& rng, RING ring, TREE tree, int accesses) {
+    std::vector<uint64_t> last_access(64, UINT64_MAX);
+
+    for (uint64_t now = 0; now < uint64_t(accesses); now++) {
+        uint64_t line = (rng() % 4) ? rng() % 16 : rng() % 64;
+        if (last_access[line] != UINT64_MAX) {
+            uint32_t cf = 1 << (line % 3);
+            assert(ring.can_cache(last_access[line], now, line / 4, cf) == tree.can_cache(last_access[line], now, line / 4, cf));
+            assert(ring.try_cache(last_access[line], now, line / 4, cf) == tree.try_cache(last_access[line], now, line / 4, cf));
+        }
+        last_access[line] = now;
+    }
+    assert(ring.num_hits() == tree.num_hits());
+}
+
 int main() {
     std::cout << "OPTGEN TEST" << std::endl;
     OPTgen<1024> test_optgen(2);
@@ -58,5 +115,22 @@ int main() {
 
     // off-by-one-errors.
     assert(!yaccgen.try_cache(80, 81, 3, 1));
+    std::cout << std::endl;
+
+    std::cout << "SEGMENT TREE TEST" << std::endl;
+    OPTgen<1024, OptgenSegmentTree> tree_optgen(2);
+    hits = 0;
+    for (const auto& current_interval : reuse_access_stream)
+        if (tree_optgen.try_cache(current_interval.start_interval, current_interval.end_interval, current_interval.address, 1))
+            hits++;
+    assert(hits == 4);
+
+    std::mt19937_64 rng(1);
+    compare_buffers<uint32_t, 64>(rng, 200000);
+    compare_buffers<uint8_t, 100>(rng, 200000);
+    compare_buffers<uint32_t, 1>(rng, 1000);
+    compare_cachegens(rng, OPTgen<256>(6), OPTgen<256, OptgenSegmentTree>(6), 200000);
+    compare_cachegens(rng, OPTgen<16384>(24), OPTgen<16384, OptgenSegmentTree>(24), 200000);
+    compare_cachegens(rng, YACCgen<128>(4), YACCgen<128, OptgenSegmentTree>(4), 200000);
     std::cout << "all assertions passed" << std::endl;
 }
@@ -1,3 +1,15 @@
 #!/bin/bash
+set -e
 mkdir -p ../test_bin
 g++ -std=c++17 -I ../inc/ -o ../test_bin/optgen_test optgen_tests.cpp && ../test_bin/optgen_test
+g++ -std=c++17 -O2 -I ../inc/ -o ../test_bin/bdi_test bdi_tests.cpp && ../test_bin/bdi_test
+g++ -std=c++17 -O2 -I ../inc/ -o ../test_bin/cpack_test cpack_tests.cpp ../src/compression/cpack.cc && ../test_bin/cpack_test
+g++ -std=c++17 -O2 -I ../inc/ -o ../test_bin/fpc_test fpc_tests.cpp && ../test_bin/fpc_test
+g++ -std=c++17 -O2 -I ../inc/ -o ../test_bin/interval_opt_test interval_opt_tests.cpp && ../test_bin/interval_opt_test
+g++ -std=c++17 -O2 -I ../inc/ -o ../test_bin/interval_log_test interval_log_tests.cpp ../src/interval_log.cc -lz && ../test_bin/interval_log_test
+# the AVX2 kernels, where the machine has them
+if grep -q avx2 /proc/cpuinfo 2>/dev/null; then
+    g++ -std=c++17 -O2 -mavx2 -I ../inc/ -o ../test_bin/bdi_test_avx2 bdi_tests.cpp && ../test_bin/bdi_test_avx2
+    g++ -std=c++17 -O2 -mavx2 -I ../inc/ -o ../test_bin/cpack_test_avx2 cpack_tests.cpp ../src/compression/cpack.cc && ../test_bin/cpack_test_avx2
+    g++ -std=c++17 -O2 -mavx2 -I ../inc/ -o ../test_bin/fpc_test_avx2 fpc_tests.cpp && ../test_bin/fpc_test_avx2
+fi
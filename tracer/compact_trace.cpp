@@ -0,0 +1,131 @@
+/*
+ * Converts data-augmented (DATA_TRACE) ChampSim traces to and from the compact,
+ * value-deduplicated format described in inc/compact_trace.h.
+ *
+ * Both directions read an uncompressed trace on stdin and write one to stdout, so
+ * the tool sits between the usual compressors:
+ *
+ *   xz -dc old.champsimtrace.xz | ./compact_trace | xz -T0 > new.champsimtrace.xz
+ *   xz -dc new.champsimtrace.xz | ./compact_trace -d | cmp - <(xz -dc old.champsimtrace.xz)
+ *
+ * Every encoded instruction is decoded again and compared against the input, so a
+ * converted trace is guaranteed to reproduce the original records.
+ */
+
+#include "compact_trace.h"
+
+#define READ_CHUNK (1 << 20)
+
+// zeroes a line value, returns 1 if it was not zero already
+static int clear_value(uint8_t *value)
+{
+    int nonzero = 0;
+    for (int i = 0; i < CACHE_LINE_BYTES; i++)
+        nonzero |= value[i];
+
+    memset(value, 0, CACHE_LINE_BYTES);
+    return nonzero != 0;
+}
+
+static int encode_trace()
+{
+    COMPACT_TRACE encoder, checker;
+    input_instr instr, original, decoded;
+    std::vector<uint8_t> out;
+    uint64_t dropped_values = 0;
+
+    uint64_t magic = COMPACT_TRACE_MAGIC;
+    fwrite(&magic, sizeof(magic), 1, stdout);
+
+    while (fread(&instr, sizeof(instr), 1, stdin) == 1) {
+        // line values of operands without an address are never simulated, so they are not stored
+        for (int i = 0; i < NUM_INSTR_DESTINATIONS; i++) {
+            if (instr.destination_memory[i] == 0)
+                dropped_values += clear_value(instr.destination_cache_line_value[i]);
+        }
+        for (int i = 0; i < NUM_INSTR_SOURCES; i++) {
+            if (instr.source_memory[i] == 0)
+                dropped_values += clear_value(instr.source_cache_line_value[i]);
+        }
+        original = instr;
+
+        out.clear();
+        encoder.encode(&instr, out);
+
+        const uint8_t *end = checker.decode(out.data(), out.data() + out.size(), &decoded);
+        if ((end != out.data() + out.size()) || memcmp(&decoded, &original, sizeof(input_instr))) {
+            cerr << "compact_trace: instruction " << encoder.num_instr - 1 << " does not round-trip";
+            cerr << " (ip: " << hex << original.ip << dec << ", is_branch: " << +original.is_branch;
+            cerr << ", branch_taken: " << +original.branch_taken << ")" << endl;
+            return 1;
+        }
+
+        fwrite(out.data(), 1, out.size(), stdout);
+    }
+
+    uint64_t values = encoder.num_literal + encoder.num_delta + encoder.num_dictionary;
+    cerr << "compact_trace: " << encoder.num_instr << " instructions, " << values << " line values";
+    cerr << " (literal: " << encoder.num_literal << " delta: " << encoder.num_delta << " dictionary: " << encoder.num_dictionary << ")" << endl;
+    if (dropped_values)
+        cerr << "compact_trace: dropped " << dropped_values << " non-zero line values of operands without an address" << endl;
+
+    return 0;
+}
+
+static int decode_trace()
+{
+    COMPACT_TRACE decoder;
+    input_instr instr;
+
+    uint64_t magic = 0;
+    if ((fread(&magic, sizeof(magic), 1, stdin) != 1) || (magic != COMPACT_TRACE_MAGIC)) {
+        cerr << "compact_trace: input is not a compact trace" << endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> buffer(READ_CHUNK + COMPACT_TRACE_MAX_RECORD);
+    size_t begin = 0, end = 0;
+    int input_done = 0;
+
+    while (1) {
+        // keep at least one full record buffered
+        if (!input_done && (end - begin < COMPACT_TRACE_MAX_RECORD)) {
+            memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+
+            size_t bytes = fread(buffer.data() + end, 1, buffer.size() - end, stdin);
+            if (bytes == 0)
+                input_done = 1;
+            end += bytes;
+        }
+
+        if (begin == end)
+            break;
+
+        const uint8_t *next = decoder.decode(buffer.data() + begin, buffer.data() + end, &instr);
+        if (next == NULL) {
+            if (input_done) {
+                cerr << "compact_trace: truncated record after " << decoder.num_instr << " instructions" << endl;
+                return 1;
+            }
+            continue;
+        }
+
+        begin = next - buffer.data();
+        fwrite(&instr, sizeof(instr), 1, stdout);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "-d") == 0))
+        return decode_trace();
+    else if (argc == 1)
+        return encode_trace();
+
+    cerr << "usage: " << argv[0] << " [-d] < input > output" << endl;
+    return 1;
+}
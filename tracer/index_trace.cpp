@@ -0,0 +1,59 @@
+/*
+ * Builds the sidecar index (<trace>.idx) that lets ChampSim's -skip_instructions
+ * seek into a gzip or xz trace instead of decoding everything before the region
+ * of interest. See inc/trace_index.h for what is stored.
+ *
+ *   ./index_trace [-s span_in_MB] trace.champsimtrace.xz
+ *
+ * xz traces are indexed at their block boundaries, so they should be compressed
+ * with more than one block (e.g. `xz -T0` or `xz --block-size=64MiB`). For gzip
+ * traces an access point is stored every span megabytes of decoded trace
+ * (default 256), each costing 32KB in the index.
+ */
+
+#include "trace_reader.h"
+
+int main(int argc, char **argv)
+{
+    uint64_t span = TRACE_INDEX_DEFAULT_SPAN;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's')
+            span = strtoull(optarg, NULL, 10) << 20;
+        else {
+            cerr << "usage: " << argv[0] << " [-s span_in_MB] trace" << endl;
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-s span_in_MB] trace" << endl;
+        return 1;
+    }
+
+    const char *trace_path = argv[optind];
+    int format = TRACE_READER::detect_format(trace_path);
+    if ((format != TRACE_FORMAT_GZIP) && (format != TRACE_FORMAT_XZ)) {
+        cerr << "index_trace: only gz and xz traces can be indexed" << endl;
+        return 1;
+    }
+
+    TRACE_INDEX index;
+    if (!index.build(trace_path, format, span)) {
+        cerr << "index_trace: cannot index " << trace_path << endl;
+        return 1;
+    }
+
+    char index_path[1100];
+    snprintf(index_path, sizeof(index_path), "%s.idx", trace_path);
+    if (!index.save(index_path)) {
+        cerr << "index_trace: cannot write " << index_path << endl;
+        return 1;
+    }
+
+    cout << index_path << ": " << index.point.size() << " points" << endl;
+    if ((format == TRACE_FORMAT_XZ) && (index.point.size() <= 1))
+        cout << "warning: the trace has a single xz block, recompress it with xz -T0 to make it seekable" << endl;
+
+    return 0;
+}
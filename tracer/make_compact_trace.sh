@@ -0,0 +1 @@
+g++ -std=c++14 -O2 -DDATA_TRACE -I../inc/ -o compact_trace compact_trace.cpp ../src/compact_trace.cc
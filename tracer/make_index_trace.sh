@@ -0,0 +1 @@
+g++ -std=c++14 -O2 -I../inc/ -o index_trace index_trace.cpp ../src/trace_index.cc ../src/trace_reader.cc ../src/compact_trace.cc -lz -llzma -pthread